@@ -0,0 +1,664 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+#include <cxxopts.hpp>
+
+#include "base/macros.h"
+#include "core/connection.h"
+#include "core/net_address.h"
+#include "core/poller.h"
+#include "core/socket.h"
+#include "log/logger.h"
+
+namespace longlp {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// poll timeout when no request is due
+constexpr int kIdlePollTimeoutMs = 100;
+// before connecting again to a server which refused
+constexpr std::chrono::milliseconds kReconnectDelay{100};
+constexpr std::string_view kHeadEnd   = "\r\n\r\n";
+constexpr std::string_view kLineEnd   = "\r\n";
+constexpr double kNanosecondsPerMicro = 1e3;
+constexpr double kBytesPerMebibyte    = 1024.0 * 1024.0;
+
+auto CeilToMilliseconds(Clock::duration duration)
+  -> std::chrono::milliseconds {
+  return std::chrono::ceil<std::chrono::milliseconds>(duration);
+}
+
+struct Options {
+  NetAddress server_address;
+  size_t threads     = 1;
+  size_t connections = 1;
+  // requests in flight per connection
+  size_t pipeline = 1;
+  bool keep_alive = true;
+  // requests per second of all the connections together, 0 for a closed
+  // loop where every response triggers the next request
+  double rate = 0;
+  Clock::duration warmup{};
+  Clock::duration duration{};
+};
+
+// The urls to request and their weights, given as 'url' or 'url=weight'.
+// Requests are serialized once
+class UrlMix {
+ public:
+  UrlMix(
+    const std::vector<std::string>& specs,
+    std::string_view host,
+    bool keep_alive) {
+    uint32_t total_weight = 0;
+    for (const auto& spec : specs) {
+      std::string_view url = spec;
+      uint32_t weight      = 1;
+      if (const auto equal = url.rfind('='); equal != std::string_view::npos) {
+        const auto weight_str = url.substr(equal + 1);
+        const auto [end, error] = std::from_chars(
+          weight_str.data(),
+          weight_str.data() + weight_str.size(),
+          weight);
+        if (
+          error == std::errc{} &&
+          end == weight_str.data() + weight_str.size()) {
+          url = url.substr(0, equal);
+        }
+        else {
+          weight = 1;
+        }
+      }
+      total_weight += weight;
+      requests_.push_back(fmt::format(
+        "GET {} HTTP/1.1\r\nHost: {}\r\nConnection: {}\r\n\r\n",
+        url,
+        host,
+        keep_alive ? "keep-alive" : "close"));
+      cumulative_weights_.push_back(total_weight);
+    }
+  }
+
+  [[nodiscard]] auto Pick(std::mt19937& rng) const -> const std::string& {
+    std::uniform_int_distribution<uint32_t> distribution(
+      0,
+      cumulative_weights_.back() - 1);
+    const auto point = distribution(rng);
+    const auto found = std::upper_bound(
+      cumulative_weights_.begin(),
+      cumulative_weights_.end(),
+      point);
+    return requests_[static_cast<size_t>(found - cumulative_weights_.begin())];
+  }
+
+ private:
+  std::vector<std::string> requests_;
+  std::vector<uint32_t> cumulative_weights_;
+};
+
+struct ParsedResponse {
+  // bytes taken by the whole response
+  size_t size = 0;
+  // 0 if the response is malformed
+  int status        = 0;
+  bool should_close = false;
+};
+
+auto EqualsIgnoreCase(std::string_view lhs, std::string_view rhs) -> bool {
+  return lhs.size() == rhs.size() &&
+         std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char l, char r) {
+           return std::tolower(static_cast<unsigned char>(l)) ==
+                  std::tolower(static_cast<unsigned char>(r));
+         });
+}
+
+// the trimmed value of the first |key| header of |head|
+auto FindHeader(std::string_view head, std::string_view key)
+  -> std::optional<std::string_view> {
+  for (auto line_begin = head.find(kLineEnd);
+       line_begin != std::string_view::npos;) {
+    line_begin += kLineEnd.size();
+    const auto line_end = head.find(kLineEnd, line_begin);
+    const auto line     = head.substr(line_begin, line_end - line_begin);
+    const auto colon    = line.find(':');
+    if (
+      colon != std::string_view::npos &&
+      EqualsIgnoreCase(line.substr(0, colon), key)) {
+      auto value = line.substr(colon + 1);
+      while (!value.empty() && value.front() == ' ') {
+        value.remove_prefix(1);
+      }
+      return value;
+    }
+    line_begin = line_end;
+  }
+  return std::nullopt;
+}
+
+// the size of a chunked content, std::nullopt until it is complete
+auto ParseChunkedContent(std::string_view content) -> std::optional<size_t> {
+  size_t pos = 0;
+  while (true) {
+    const auto line_end = content.find(kLineEnd, pos);
+    if (line_end == std::string_view::npos) {
+      return std::nullopt;
+    }
+    size_t chunk_size = 0;
+    std::from_chars(
+      content.data() + pos,
+      content.data() + line_end,
+      chunk_size,
+      16);
+    // the last chunk is followed by an empty trailer
+    const auto chunk_end =
+      line_end + kLineEnd.size() + chunk_size + kLineEnd.size();
+    if (content.size() < chunk_end) {
+      return std::nullopt;
+    }
+    if (chunk_size == 0) {
+      return chunk_end;
+    }
+    pos = chunk_end;
+  }
+}
+
+// The response at the front of |data|, std::nullopt if more bytes are needed
+auto ParseResponse(std::string_view data) -> std::optional<ParsedResponse> {
+  const auto head_end = data.find(kHeadEnd);
+  if (head_end == std::string_view::npos) {
+    return std::nullopt;
+  }
+  const auto head = data.substr(0, head_end);
+  ParsedResponse response{};
+  // HTTP/1.1 200 OK
+  constexpr size_t kStatusBegin = 9;
+  if (head.size() >= kStatusBegin + 3) {
+    std::from_chars(
+      head.data() + kStatusBegin,
+      head.data() + kStatusBegin + 3,
+      response.status);
+  }
+  if (const auto connection = FindHeader(head, "Connection");
+      connection.has_value()) {
+    response.should_close = EqualsIgnoreCase(*connection, "close");
+  }
+
+  const auto content_begin = head_end + kHeadEnd.size();
+  size_t content_size      = 0;
+  if (const auto encoding = FindHeader(head, "Transfer-Encoding");
+      encoding.has_value() && EqualsIgnoreCase(*encoding, "chunked")) {
+    const auto chunked_size = ParseChunkedContent(data.substr(content_begin));
+    if (!chunked_size.has_value()) {
+      return std::nullopt;
+    }
+    content_size = *chunked_size;
+  }
+  // a 304 response describes the content without carrying it
+  else if (const auto length = FindHeader(head, "Content-Length");
+           length.has_value() && response.status != 304) {
+    std::from_chars(
+      length->data(),
+      length->data() + length->size(),
+      content_size);
+  }
+  if (data.size() < content_begin + content_size) {
+    return std::nullopt;
+  }
+  response.size = content_begin + content_size;
+  return response;
+}
+
+struct WorkerResult {
+  // of the responses received after the warm-up
+  std::vector<int64_t> latencies_ns;
+  uint64_t non_2xx = 0;
+  uint64_t bytes   = 0;
+  // malformed responses, requests lost with their connection and failed
+  // connects
+  uint64_t errors = 0;
+  // requests due but never sent, the server could not keep up
+  uint64_t backlog = 0;
+};
+
+// Drive |connections| connections from a single thread with its own Poller.
+// In open loop, requests are due at a constant rate whatever the server
+// answers, and latencies are measured from when a request was due rather
+// than from when it could be sent, so that a stalled server is not hidden by
+// the requests it kept from being sent (coordinated omission)
+class Worker {
+ public:
+  Worker(
+    const Options& options,
+    const UrlMix& urls,
+    size_t connections,
+    uint32_t seed) :
+    options_(options),
+    urls_(urls),
+    poller_(Poller::kDefaultListenedEvents),
+    clients_(connections),
+    rng_(seed) {}
+
+  DISALLOW_COPY_AND_MOVE(Worker);
+
+  void Run(Clock::time_point start) {
+    record_from_       = start + options_.warmup;
+    const auto end     = record_from_ + options_.duration;
+    const bool is_open = options_.rate > 0;
+    // each worker takes its share of the rate
+    const auto interval =
+      std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+        static_cast<double>(options_.threads) / options_.rate));
+    auto next_due = start;
+
+    while (true) {
+      const auto now = Clock::now();
+      if (now >= end) {
+        break;
+      }
+      if (is_open) {
+        for (; next_due <= now; next_due += interval) {
+          due_.push_back(next_due);
+        }
+      }
+      Dispatch(now);
+
+      auto timeout = std::chrono::milliseconds(kIdlePollTimeoutMs);
+      if (is_open) {
+        timeout = std::min(timeout, CeilToMilliseconds(next_due - now));
+      }
+      timeout = std::min(timeout, CeilToMilliseconds(end - now));
+      for (auto* connection : poller_.Poll(static_cast<int>(timeout.count()))) {
+        connection->Start();
+      }
+      // out of the callbacks, one of them may have disconnected its client
+      retired_.clear();
+    }
+    result_.backlog = due_.size();
+  }
+
+  [[nodiscard]] auto GetResult() noexcept -> WorkerResult& { return result_; }
+
+ private:
+  struct Client {
+    std::unique_ptr<Connection> connection;
+    std::string received;
+    // when the requests waiting for their response were due
+    std::deque<Clock::time_point> in_flight;
+    Clock::time_point reconnect_at;
+  };
+
+  // send the due requests, or keep every connection busy in closed loop
+  void Dispatch(Clock::time_point now) {
+    const bool is_open = options_.rate > 0;
+    for (auto& client : clients_) {
+      if (is_open && due_.empty()) {
+        return;
+      }
+      if (
+        client.connection == nullptr &&
+        (now < client.reconnect_at || !Connect(client))) {
+        continue;
+      }
+      bool has_written = false;
+      while (client.in_flight.size() < options_.pipeline &&
+             (!is_open || !due_.empty())) {
+        client.connection->Write(urls_.Pick(rng_));
+        client.in_flight.push_back(is_open ? due_.front() : now);
+        if (is_open) {
+          due_.pop_front();
+        }
+        has_written = true;
+      }
+      // the pipelined requests leave together
+      if (has_written) {
+        client.connection->Send();
+      }
+    }
+  }
+
+  auto Connect(Client& client) -> bool {
+    auto socket = std::make_unique<Socket>();
+    try {
+      socket->ConnectToServer(options_.server_address);
+    }
+    catch (const std::logic_error&) {
+      ++result_.errors;
+      client.reconnect_at = Clock::now() + kReconnectDelay;
+      return false;
+    }
+    socket->SetNonBlocking();
+    int yes = 1;
+    setsockopt(socket->GetFd(), IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+    client.connection = std::make_unique<Connection>(std::move(socket));
+    client.connection->SetEvents(Poller::Event::kRead | Poller::Event::kET);
+    client.connection->SetCallback([this, &client](Connection*) {
+      OnReadable(client);
+    });
+    poller_.AddConnection(client.connection.get());
+    return true;
+  }
+
+  // the requests still in flight are lost
+  void Disconnect(Client& client) {
+    if (Clock::now() >= record_from_) {
+      result_.errors += client.in_flight.size();
+    }
+    client.in_flight.clear();
+    client.received.clear();
+    retired_.push_back(std::move(client.connection));
+  }
+
+  void OnReadable(Client& client) {
+    auto& connection    = *client.connection;
+    auto [read, closed] = connection.Receive();
+    if (connection.GetReadSize() > 0) {
+      client.received.append(
+        bit_cast<const char*>(connection.ReadData()),
+        connection.GetReadSize());
+      connection.ClearReadBuffer();
+    }
+
+    size_t consumed   = 0;
+    bool should_close = closed;
+    while (!client.in_flight.empty()) {
+      const auto response =
+        ParseResponse(std::string_view(client.received).substr(consumed));
+      if (!response.has_value()) {
+        break;
+      }
+      consumed += response->size;
+      Record(client.in_flight.front(), *response);
+      client.in_flight.pop_front();
+      if (response->should_close || response->status == 0) {
+        should_close = true;
+        break;
+      }
+    }
+    client.received.erase(0, consumed);
+    if (should_close) {
+      Disconnect(client);
+    }
+  }
+
+  void Record(Clock::time_point due, const ParsedResponse& response) {
+    const auto now = Clock::now();
+    if (now < record_from_) {
+      return;
+    }
+    if (response.status == 0) {
+      ++result_.errors;
+      return;
+    }
+    result_.latencies_ns.push_back(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count());
+    result_.bytes += response.size;
+    if (response.status < 200 || response.status >= 300) {
+      ++result_.non_2xx;
+    }
+  }
+
+  const Options& options_;
+  const UrlMix& urls_;
+  Poller poller_;
+  // never resized, the connection callbacks refer to their client
+  std::vector<Client> clients_;
+  std::vector<std::unique_ptr<Connection>> retired_;
+  // open loop, requests due but not sent yet
+  std::deque<Clock::time_point> due_;
+  std::mt19937 rng_;
+  Clock::time_point record_from_;
+  WorkerResult result_;
+};
+
+struct Report {
+  uint64_t requests           = 0;
+  uint64_t non_2xx            = 0;
+  uint64_t errors             = 0;
+  uint64_t backlog            = 0;
+  double seconds              = 0;
+  double throughput           = 0;
+  double mebibytes_per_second = 0;
+  // in microseconds
+  double mean = 0;
+  double p50  = 0;
+  double p90  = 0;
+  double p99  = 0;
+  double p999 = 0;
+  double max  = 0;
+};
+
+// nearest rank, |sorted| is not empty
+auto GetPercentile(const std::vector<int64_t>& sorted, double percentile)
+  -> double {
+  const auto rank = static_cast<size_t>(
+    std::ceil(percentile * static_cast<double>(sorted.size())));
+  return static_cast<double>(sorted[std::max<size_t>(rank, 1) - 1]) /
+         kNanosecondsPerMicro;
+}
+
+auto MakeReport(
+  std::vector<std::unique_ptr<Worker>>& workers,
+  const Options& options) -> Report {
+  Report report{};
+  std::vector<int64_t> latencies;
+  uint64_t bytes = 0;
+  for (auto& worker : workers) {
+    auto& result = worker->GetResult();
+    latencies.insert(
+      latencies.end(),
+      result.latencies_ns.begin(),
+      result.latencies_ns.end());
+    report.non_2xx += result.non_2xx;
+    report.errors += result.errors;
+    report.backlog += result.backlog;
+    bytes += result.bytes;
+  }
+  report.requests   = latencies.size();
+  report.seconds    = std::chrono::duration<double>(options.duration).count();
+  report.throughput = static_cast<double>(report.requests) / report.seconds;
+  report.mebibytes_per_second =
+    static_cast<double>(bytes) / report.seconds / kBytesPerMebibyte;
+  if (latencies.empty()) {
+    return report;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  const auto total =
+    std::accumulate(latencies.begin(), latencies.end(), int64_t{0});
+  report.mean = static_cast<double>(total) /
+                static_cast<double>(latencies.size()) / kNanosecondsPerMicro;
+  report.p50  = GetPercentile(latencies, 0.5);
+  report.p90  = GetPercentile(latencies, 0.9);
+  report.p99  = GetPercentile(latencies, 0.99);
+  report.p999 = GetPercentile(latencies, 0.999);
+  report.max  = static_cast<double>(latencies.back()) / kNanosecondsPerMicro;
+  return report;
+}
+
+void PrintReport(const Report& report) {
+  fmt::print(
+    "{} requests in {:.2f}s, {:.1f} req/s, {:.2f} MiB/s\n"
+    "non-2xx: {}, errors: {}, backlog: {}\n"
+    "latency (us): mean {:.1f}, p50 {:.1f}, p90 {:.1f}, p99 {:.1f}, "
+    "p99.9 {:.1f}, max {:.1f}\n",
+    report.requests,
+    report.seconds,
+    report.throughput,
+    report.mebibytes_per_second,
+    report.non_2xx,
+    report.errors,
+    report.backlog,
+    report.mean,
+    report.p50,
+    report.p90,
+    report.p99,
+    report.p999,
+    report.max);
+}
+
+void PrintJsonReport(const Report& report) {
+  fmt::print(
+    "{{\"requests\":{},\"seconds\":{},\"throughput\":{},"
+    "\"mebibytes_per_second\":{},\"non_2xx\":{},\"errors\":{},"
+    "\"backlog\":{},\"latency_us\":{{\"mean\":{},\"p50\":{},\"p90\":{},"
+    "\"p99\":{},\"p999\":{},\"max\":{}}}}}\n",
+    report.requests,
+    report.seconds,
+    report.throughput,
+    report.mebibytes_per_second,
+    report.non_2xx,
+    report.errors,
+    report.backlog,
+    report.mean,
+    report.p50,
+    report.p90,
+    report.p99,
+    report.p999,
+    report.max);
+}
+}    // namespace
+}    // namespace longlp
+
+// An HTTP/1.1 load generator with keep-alive, pipelining and latency
+// percentiles, in closed loop or at a constant rate
+auto main(int argc, char* argv[]) -> int {
+  cxxopts::Options options(
+    "longlp-load-generator",
+    "Load an http server and report its latency");
+
+  // clang-format off
+  options.add_options()
+    (
+      "address",
+      "server address",
+      cxxopts::value<std::string>()->default_value("127.0.0.1")
+    )
+    ("port", "server port", cxxopts::value<uint16_t>()->default_value("8080"))
+    (
+      "url",
+      "url to request, 'url=weight' for a weighted mix, may be repeated",
+      cxxopts::value<std::vector<std::string>>()
+    )
+    ("threads", "worker threads", cxxopts::value<size_t>()->default_value("1"))
+    (
+      "connections",
+      "connections of all the threads together",
+      cxxopts::value<size_t>()->default_value("16")
+    )
+    (
+      "pipeline",
+      "requests in flight per connection",
+      cxxopts::value<size_t>()->default_value("1")
+    )
+    ("no-keep-alive", "a new connection per request")
+    (
+      "rate",
+      "requests per second at a constant rate, 0 for a closed loop",
+      cxxopts::value<double>()->default_value("0")
+    )
+    (
+      "duration",
+      "seconds measured",
+      cxxopts::value<double>()->default_value("10")
+    )
+    (
+      "warmup",
+      "seconds of load before measuring",
+      cxxopts::value<double>()->default_value("2")
+    )
+    ("json", "print the report as JSON")
+    ("h,help", "Print usage")
+  ;
+  // clang-format on
+
+  auto result = options.parse(argc, argv);
+  if (result.count("help") != 0U) {
+    fmt::print("{}\n", options.help());
+    return 0;
+  }
+
+  const auto address = result["address"].as<std::string>();
+  const auto port    = result["port"].as<uint16_t>();
+  longlp::Options load_options{};
+  load_options.server_address =
+    longlp::NetAddress{address, port, longlp::Protocol::Ipv4};
+  load_options.threads = std::max<size_t>(result["threads"].as<size_t>(), 1);
+  load_options.connections =
+    std::max(result["connections"].as<size_t>(), load_options.threads);
+  load_options.keep_alive = result.count("no-keep-alive") == 0U;
+  // the server closes after the response without keep-alive
+  load_options.pipeline =
+    load_options.keep_alive
+      ? std::max<size_t>(result["pipeline"].as<size_t>(), 1)
+      : 1;
+  load_options.rate = result["rate"].as<double>();
+  load_options.warmup = std::chrono::duration_cast<longlp::Clock::duration>(
+    std::chrono::duration<double>(result["warmup"].as<double>()));
+  load_options.duration = std::chrono::duration_cast<longlp::Clock::duration>(
+    std::chrono::duration<double>(result["duration"].as<double>()));
+
+  std::vector<std::string> url_specs{"/"};
+  if (result.count("url") != 0U) {
+    url_specs = result["url"].as<std::vector<std::string>>();
+  }
+  const longlp::UrlMix urls{
+    url_specs,
+    fmt::format("{}:{}", address, port),
+    load_options.keep_alive};
+
+  // only the errors of the load generator itself are of interest
+  longlp::Logger::SetMinLevel(longlp::LogLevel::kError);
+
+  std::vector<std::unique_ptr<longlp::Worker>> workers;
+  for (size_t i = 0; i < load_options.threads; ++i) {
+    // spread the remaining connections over the first workers
+    const auto connections =
+      load_options.connections / load_options.threads +
+      (i < load_options.connections % load_options.threads ? 1 : 0);
+    workers.push_back(std::make_unique<longlp::Worker>(
+      load_options,
+      urls,
+      connections,
+      static_cast<uint32_t>(i + 1)));
+  }
+  const auto start = longlp::Clock::now();
+  std::vector<std::thread> threads;
+  for (auto& worker : workers) {
+    threads.emplace_back([&worker, start]() { worker->Run(start); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  const auto report = longlp::MakeReport(workers, load_options);
+  if (result.count("json") != 0U) {
+    longlp::PrintJsonReport(report);
+  }
+  else {
+    longlp::PrintReport(report);
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "core/buffer.h"
+
+namespace {
+using longlp::Buffer;
+
+const std::string kRequest =
+  "GET /index.html HTTP/1.1\r\n"
+  "Host: 127.0.0.1:8080\r\n"
+  "User-Agent: micro-benchmark\r\n"
+  "Accept: */*\r\n"
+  "Connection: keep-alive\r\n\r\n";
+
+// |state.range(0)| pipelined requests read at once, then split one by one
+void BM_BufferFindAndPopTill(benchmark::State& state) {
+  const auto pipelined = state.range(0);
+  Buffer buffer;
+  for (auto _ : state) {
+    for (auto i = 0; i < pipelined; ++i) {
+      buffer.PushBack(kRequest);
+    }
+    for (auto i = 0; i < pipelined; ++i) {
+      benchmark::DoNotOptimize(buffer.FindAndPopTill("\r\n\r\n"));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * pipelined);
+  state.SetBytesProcessed(
+    state.iterations() * pipelined * static_cast<int64_t>(kRequest.size()));
+}
+BENCHMARK(BM_BufferFindAndPopTill)->Arg(1)->Arg(16)->Arg(128);
+
+// the delimiter is not there yet, e.g. a partial request
+void BM_BufferFindAndPopTillMiss(benchmark::State& state) {
+  Buffer buffer;
+  buffer.PushBack(std::string(static_cast<size_t>(state.range(0)), 'a'));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.FindAndPopTill("\r\n\r\n"));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BufferFindAndPopTillMiss)->Arg(1024)->Arg(64 * 1024);
+}    // namespace
@@ -0,0 +1,86 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "core/cache.h"
+#include "core/typedefs.h"
+
+namespace {
+using longlp::Cache;
+using longlp::DynamicByteArray;
+
+constexpr size_t kResourceCount = 256;
+constexpr size_t kResourceSize  = 4096;
+
+auto GetResourceUrls() -> const std::vector<std::string>& {
+  static const auto urls = [] {
+    std::vector<std::string> result;
+    for (size_t i = 0; i < kResourceCount; ++i) {
+      result.push_back("/resources/page_" + std::to_string(i) + ".html");
+    }
+    return result;
+  }();
+  return urls;
+}
+
+// shared by the threads of a run, every resource fits in
+auto GetSharedCache() -> Cache& {
+  static Cache cache{kResourceCount * kResourceSize * 2};
+  return cache;
+}
+
+void BM_CacheTryLoad(benchmark::State& state) {
+  auto& cache       = GetSharedCache();
+  const auto& urls  = GetResourceUrls();
+  const DynamicByteArray content(kResourceSize, 'a');
+  if (state.thread_index() == 0) {
+    for (const auto& url : urls) {
+      std::ignore = cache.TryInsert(url, content);
+    }
+  }
+  DynamicByteArray destination;
+  destination.reserve(kResourceSize);
+  size_t next = static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    destination.clear();
+    benchmark::DoNotOptimize(
+      cache.TryLoad(urls[next++ % kResourceCount], destination));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CacheTryLoad)->ThreadRange(1, 8)->UseRealTime();
+
+// a lookup mix with one insert every |state.range(0)| loads, the expired
+// entries are replaced
+void BM_CacheTryLoadTryInsert(benchmark::State& state) {
+  auto& cache      = GetSharedCache();
+  const auto& urls = GetResourceUrls();
+  const DynamicByteArray content(kResourceSize, 'a');
+  const auto insert_every = static_cast<size_t>(state.range(0));
+  DynamicByteArray destination;
+  destination.reserve(kResourceSize);
+  size_t next = static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    const auto& url = urls[next % kResourceCount];
+    if (next++ % insert_every == 0) {
+      benchmark::DoNotOptimize(
+        cache.TryInsert(url, content, longlp::milliseconds{1}));
+    }
+    else {
+      destination.clear();
+      benchmark::DoNotOptimize(cache.TryLoad(url, destination));
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CacheTryLoadTryInsert)
+  ->Arg(10)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+}    // namespace
@@ -0,0 +1,85 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+#include "core/typedefs.h"
+#include "http/header.h"
+#include "http/request.h"
+#include "http/request_arena.h"
+#include "http/response.h"
+
+namespace {
+using longlp::DynamicByteArray;
+using longlp::http::Header;
+using longlp::http::Request;
+using longlp::http::RequestArena;
+using longlp::http::Response;
+
+constexpr std::string_view kRequest =
+  "GET /index.html HTTP/1.1\r\n"
+  "Host: 127.0.0.1:8080\r\n"
+  "User-Agent: micro-benchmark\r\n"
+  "Accept: text/html,application/xhtml+xml\r\n"
+  "Accept-Encoding: gzip, br\r\n"
+  "If-None-Match: \"5f-1a2b3c\"\r\n"
+  "Connection: keep-alive\r\n\r\n";
+
+void BM_RequestParse(benchmark::State& state) {
+  for (auto _ : state) {
+    Request request{kRequest};
+    benchmark::DoNotOptimize(request.IsValid());
+  }
+  state.SetBytesProcessed(
+    state.iterations() * static_cast<int64_t>(kRequest.size()));
+}
+BENCHMARK(BM_RequestParse);
+
+// as the server does, from the arena of the reactor released per request
+void BM_RequestParseArena(benchmark::State& state) {
+  for (auto _ : state) {
+    const RequestArena::Scope arena{};
+    Request request{kRequest, arena.GetResource()};
+    benchmark::DoNotOptimize(request.IsValid());
+  }
+  state.SetBytesProcessed(
+    state.iterations() * static_cast<int64_t>(kRequest.size()));
+}
+BENCHMARK(BM_RequestParseArena);
+
+void BM_HeaderFromLine(benchmark::State& state) {
+  for (auto _ : state) {
+    Header header{std::string_view("Accept-Encoding: gzip, br")};
+    benchmark::DoNotOptimize(header.IsValid());
+  }
+}
+BENCHMARK(BM_HeaderFromLine);
+
+void BM_HeaderFromKeyValue(benchmark::State& state) {
+  for (auto _ : state) {
+    Header header{"Content-Type", "text/html"};
+    benchmark::DoNotOptimize(header.IsValid());
+  }
+}
+BENCHMARK(BM_HeaderFromKeyValue);
+
+void BM_ResponseSerialize(benchmark::State& state) {
+  auto response = Response::Make200Response(false, std::nullopt);
+  response.AddHeader("Content-Type", "text/html");
+  response.AddHeader("Content-Length", "4096");
+  response.AddHeader("ETag", "\"5f-1a2b3c\"");
+  response.AddHeader("Vary", "Accept-Encoding");
+  DynamicByteArray response_buf;
+  for (auto _ : state) {
+    response_buf.clear();
+    response.Serialize(response_buf);
+    benchmark::DoNotOptimize(response_buf.data());
+  }
+}
+BENCHMARK(BM_ResponseSerialize);
+}    // namespace
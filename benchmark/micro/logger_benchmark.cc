@@ -0,0 +1,124 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "log/log_file.h"
+#include "log/logger.h"
+
+namespace {
+using longlp::LogLevel;
+using longlp::Logger;
+
+// heap allocations of the whole process, the backend worker included
+std::atomic<uint64_t> allocation_count = 0;
+
+// allocations per log made while |state| was running, the backend worker
+// allocates only once per batch of logs. The count is global, reported by a
+// single thread and averaged over the iterations of all of them
+void ReportAllocations(benchmark::State& state, uint64_t allocations_before) {
+  if (state.thread_index() != 0) {
+    return;
+  }
+  state.counters["allocs_per_log"] = benchmark::Counter(
+    static_cast<double>(
+      allocation_count.load(std::memory_order_relaxed) - allocations_before),
+    benchmark::Counter::kAvgIterations);
+}
+
+// the logs go to a single temporary file
+void SetUpLogFile() {
+  static const bool done = [] {
+    longlp::LogFile::Options options{};
+    options.directory = std::filesystem::temp_directory_path().string();
+    options.max_files = 1;
+    Logger::GetInstance().SetFileOptions(std::move(options));
+    return true;
+  }();
+  benchmark::DoNotOptimize(done);
+}
+
+// the cost paid by the logging thread, the backend formats and writes
+void BM_LoggerLogMsg(benchmark::State& state) {
+  SetUpLogFile();
+  const auto dropped_before = Logger::GetInstance().GetDroppedCount();
+  const auto allocations_before =
+    allocation_count.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    Logger::LogMsg(LogLevel::kInfo, "client fd=42 has exited.");
+  }
+  state.SetItemsProcessed(state.iterations());
+  ReportAllocations(state, allocations_before);
+  state.counters["dropped"] = static_cast<double>(
+    Logger::GetInstance().GetDroppedCount() - dropped_before);
+}
+BENCHMARK(BM_LoggerLogMsg)->ThreadRange(1, 4)->UseRealTime();
+
+// formatting deferred to the backend, the arguments packed in the ring
+void BM_LoggerLogDeferred(benchmark::State& state) {
+  SetUpLogFile();
+  const auto allocations_before =
+    allocation_count.load(std::memory_order_relaxed);
+  int fd = 0;
+  for (auto _ : state) {
+    longlp::Log<LogLevel::kInfo>(
+      "new client fd={} maps to reactor={}",
+      ++fd,
+      3);
+  }
+  state.SetItemsProcessed(state.iterations());
+  ReportAllocations(state, allocations_before);
+}
+BENCHMARK(BM_LoggerLogDeferred)->ThreadRange(1, 4)->UseRealTime();
+
+// string arguments are copied in the ring as well, only the ones over the
+// inline capacity of a slot go to the heap
+void BM_LoggerLogDeferredString(benchmark::State& state) {
+  SetUpLogFile();
+  const std::string path(static_cast<size_t>(state.range(0)), 'a');
+  const auto allocations_before =
+    allocation_count.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    longlp::Log<LogLevel::kInfo>("{} not exist, fd={}", path, 42);
+  }
+  state.SetItemsProcessed(state.iterations());
+  ReportAllocations(state, allocations_before);
+}
+BENCHMARK(BM_LoggerLogDeferredString)
+  ->Arg(16)
+  ->Arg(
+    static_cast<int64_t>(longlp::log_internal::PackedArgs::kInlineCapacity) *
+    2)
+  ->ThreadRange(1, 4)
+  ->UseRealTime();
+
+// below the runtime minimum level, nothing but the level check
+void BM_LoggerLogFiltered(benchmark::State& state) {
+  Logger::SetMinLevel(LogLevel::kWarning);
+  for (auto _ : state) {
+    longlp::Log<LogLevel::kInfo>("new client fd={} maps to reactor={}", 42, 3);
+  }
+  Logger::SetMinLevel(LogLevel::kInfo);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoggerLogFiltered);
+}    // namespace
+
+auto operator new(size_t size) -> void* {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size); ptr != nullptr) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t /* size */) noexcept { std::free(ptr); }
@@ -0,0 +1,36 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <future>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "core/thread_pool.h"
+
+namespace {
+using longlp::ThreadPool;
+
+constexpr size_t kBatchSize = 64;
+
+// submit a batch of empty tasks to |state.range(0)| workers and wait for
+// them, the cost is the queueing and the hand-off
+void BM_ThreadPoolSubmitTask(benchmark::State& state) {
+  ThreadPool pool(static_cast<size_t>(state.range(0)));
+  std::vector<std::future<void>> futures;
+  futures.reserve(kBatchSize);
+  for (auto _ : state) {
+    for (size_t i = 0; i < kBatchSize; ++i) {
+      futures.push_back(pool.SubmitTask([]() {}));
+    }
+    for (auto& future : futures) {
+      future.wait();
+    }
+    futures.clear();
+  }
+  state.SetItemsProcessed(
+    state.iterations() * static_cast<int64_t>(kBatchSize));
+}
+BENCHMARK(BM_ThreadPoolSubmitTask)->RangeMultiplier(2)->Range(1, 8);
+}    // namespace
@@ -0,0 +1,618 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <cxxopts.hpp>
+
+#include "base/macros.h"
+
+namespace longlp {
+
+namespace {
+constexpr std::chrono::seconds kServerStartTimeout{5};
+constexpr std::chrono::milliseconds kServerStartPollInterval{50};
+constexpr double kTwoSidedNormal95 = 1.96;
+constexpr auto kMaxCpus           = static_cast<size_t>(CPU_SETSIZE);
+// Student's t quantiles of a two-sided 95% interval, by degrees of freedom
+constexpr std::array<double, 30> kStudentT95{
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+// a load run against the server, compared on its own against the baseline
+struct Scenario {
+  std::string name;
+  // 'url=weight' specs of the load generator
+  std::vector<std::string> urls;
+  size_t connections;
+  size_t pipeline;
+};
+
+// the demo pages: index_tiny.html is 730 bytes, index.html about 1 MiB
+auto GetScenarios() -> std::vector<Scenario> {
+  return {
+    {"small-keep-alive", {"/index_tiny.html"}, 64, 1},
+    {"small-pipelined", {"/index_tiny.html"}, 16, 8},
+    {"large", {"/index.html"}, 16, 1},
+    {"mixed", {"/index_tiny.html=9", "/index.html=1"}, 64, 1},
+  };
+}
+
+struct Options {
+  std::string server_path;
+  std::string load_generator_path;
+  std::string directory;
+  std::string log_directory;
+  uint16_t port = 0;
+  size_t trials = 0;
+  double warmup = 0;
+  double duration = 0;
+  size_t client_threads = 0;
+  std::optional<cpu_set_t> server_cpus;
+  std::optional<cpu_set_t> client_cpus;
+};
+
+// a 95% confidence interval of the mean of the trials
+struct Estimate {
+  double mean       = 0;
+  double half_width = 0;
+
+  [[nodiscard]] auto GetLower() const noexcept -> double {
+    return mean - half_width;
+  }
+
+  [[nodiscard]] auto GetUpper() const noexcept -> double {
+    return mean + half_width;
+  }
+};
+
+auto Estimate95(const std::vector<double>& samples) -> Estimate {
+  Estimate estimate{};
+  if (samples.empty()) {
+    return estimate;
+  }
+  const auto count = static_cast<double>(samples.size());
+  estimate.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / count;
+  if (samples.size() < 2) {
+    return estimate;
+  }
+  double squares = 0;
+  for (const auto sample : samples) {
+    squares += (sample - estimate.mean) * (sample - estimate.mean);
+  }
+  const auto degrees = samples.size() - 1;
+  const auto quantile =
+    degrees <= kStudentT95.size() ? kStudentT95[degrees - 1]
+                                  : kTwoSidedNormal95;
+  estimate.half_width =
+    quantile * std::sqrt(squares / (count - 1)) / std::sqrt(count);
+  return estimate;
+}
+
+// "0-3,6" as in taskset
+auto ParseCpuList(const std::string& cpu_list) -> cpu_set_t {
+  std::string_view list = cpu_list;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  while (!list.empty()) {
+    const auto comma = list.find(',');
+    auto range       = list.substr(0, comma);
+    list.remove_prefix(comma == std::string_view::npos ? list.size()
+                                                       : comma + 1);
+    const auto dash = range.find('-');
+    const auto first_str = range.substr(0, dash);
+    const auto last_str =
+      dash == std::string_view::npos ? first_str : range.substr(dash + 1);
+    size_t first = 0;
+    size_t last  = 0;
+    if (
+      std::from_chars(first_str.begin(), first_str.end(), first).ec !=
+        std::errc{} ||
+      std::from_chars(last_str.begin(), last_str.end(), last).ec !=
+        std::errc{} ||
+      last < first || last >= kMaxCpus) {
+      throw std::invalid_argument(fmt::format("invalid cpu list {}", cpu_list));
+    }
+    for (auto cpu = first; cpu <= last; ++cpu) {
+      CPU_SET(cpu, &cpus);
+    }
+  }
+  return cpus;
+}
+
+auto FormatCpuList(const cpu_set_t& cpus) -> std::string {
+  std::string list;
+  for (size_t cpu = 0; cpu < kMaxCpus; ++cpu) {
+    if (CPU_ISSET(cpu, &cpus)) {
+      list += list.empty() ? fmt::format("{}", cpu) : fmt::format(",{}", cpu);
+    }
+  }
+  return list;
+}
+
+// Without an explicit choice the CPUs we may run on are split in two
+// halves, the server gets the first one and the load generator the other,
+// so that they do not compete for the same cores
+void SplitCpus(Options& options) {
+  cpu_set_t available;
+  if (sched_getaffinity(0, sizeof(available), &available) != 0) {
+    return;
+  }
+  std::vector<size_t> cpus;
+  for (size_t cpu = 0; cpu < kMaxCpus; ++cpu) {
+    if (CPU_ISSET(cpu, &available)) {
+      cpus.push_back(cpu);
+    }
+  }
+  if (cpus.size() < 2) {
+    fmt::print("a single cpu, the server and the load share it\n");
+    return;
+  }
+  cpu_set_t server;
+  cpu_set_t client;
+  CPU_ZERO(&server);
+  CPU_ZERO(&client);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    CPU_SET(cpus[i], i < cpus.size() / 2 ? &server : &client);
+  }
+  if (!options.server_cpus.has_value()) {
+    options.server_cpus = server;
+  }
+  if (!options.client_cpus.has_value()) {
+    options.client_cpus = client;
+  }
+}
+
+// A child process running |args|, pinned to |cpus| if any, killed if it is
+// still running when destroyed
+class ChildProcess {
+ public:
+  ChildProcess(
+    const std::vector<std::string>& args,
+    const std::optional<cpu_set_t>& cpus,
+    int stdout_fd) {
+    std::vector<char*> argv;
+    argv.reserve(args.size() + 1);
+    for (const auto& arg : args) {
+      argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_ = fork();
+    if (pid_ < 0) {
+      throw std::runtime_error(fmt::format("fail to fork for {}", args[0]));
+    }
+    if (pid_ == 0) {
+      if (cpus.has_value()) {
+        sched_setaffinity(0, sizeof(*cpus), &*cpus);
+      }
+      if (stdout_fd >= 0) {
+        dup2(stdout_fd, STDOUT_FILENO);
+      }
+      execv(argv[0], argv.data());
+      _exit(127);
+    }
+  }
+
+  ~ChildProcess() {
+    if (pid_ > 0) {
+      kill(pid_, SIGKILL);
+      waitpid(pid_, nullptr, 0);
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(ChildProcess);
+
+  // whether it exited with 0
+  [[nodiscard]] auto Wait() -> bool {
+    int status = 0;
+    waitpid(pid_, &status, 0);
+    pid_ = -1;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+
+  void Terminate() {
+    kill(pid_, SIGTERM);
+    std::ignore = Wait();
+  }
+
+ private:
+  pid_t pid_ = -1;
+};
+
+auto IsAcceptingConnections(uint16_t port) -> bool {
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  sockaddr_in addr{};
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  const bool connected =
+    connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+  close(fd);
+  return connected;
+}
+
+// the value of the first "key": after |json|, flat objects only
+auto FindNumber(std::string_view json, std::string_view key)
+  -> std::optional<double> {
+  const auto quoted = fmt::format("\"{}\":", key);
+  const auto found  = json.find(quoted);
+  if (found == std::string_view::npos) {
+    return std::nullopt;
+  }
+  json.remove_prefix(found + quoted.size());
+  while (!json.empty() && json.front() == ' ') {
+    json.remove_prefix(1);
+  }
+  double value = 0;
+  if (std::from_chars(json.begin(), json.end(), value).ec != std::errc{}) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// the flat object of "key", empty if there is none
+auto FindObject(std::string_view json, std::string_view key)
+  -> std::string_view {
+  const auto quoted = fmt::format("\"{}\":", key);
+  const auto found  = json.find(quoted);
+  if (found == std::string_view::npos) {
+    return {};
+  }
+  const auto begin = json.find('{', found);
+  const auto end   = json.find('}', begin);
+  if (begin == std::string_view::npos || end == std::string_view::npos) {
+    return {};
+  }
+  return json.substr(begin, end - begin + 1);
+}
+
+auto ReadFile(const std::string& path) -> std::string {
+  std::ifstream file(path);
+  if (!file) {
+    return {};
+  }
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+struct TrialResult {
+  double throughput = 0;
+  double p99        = 0;
+};
+
+auto RunTrial(const Options& options, const Scenario& scenario)
+  -> std::optional<TrialResult> {
+  std::vector<std::string> args{
+    options.load_generator_path,
+    fmt::format("--port={}", options.port),
+    fmt::format("--threads={}", options.client_threads),
+    fmt::format("--connections={}", scenario.connections),
+    fmt::format("--pipeline={}", scenario.pipeline),
+    fmt::format("--warmup={}", options.warmup),
+    fmt::format("--duration={}", options.duration)};
+  // a single comma separated list, as cxxopts splits vector values
+  args.push_back(fmt::format("--url={}", fmt::join(scenario.urls, ",")));
+  // last, a flag never takes the next argument as its value
+  args.emplace_back("--json");
+
+  std::array<int, 2> pipe_fds{};
+  if (pipe2(pipe_fds.data(), O_CLOEXEC) != 0) {
+    return std::nullopt;
+  }
+  ChildProcess load_generator{args, options.client_cpus, pipe_fds[1]};
+  close(pipe_fds[1]);
+  std::string output;
+  std::array<char, 4096> chunk{};
+  ssize_t read_bytes = 0;
+  while ((read_bytes = read(pipe_fds[0], chunk.data(), chunk.size())) > 0) {
+    output.append(chunk.data(), static_cast<size_t>(read_bytes));
+  }
+  close(pipe_fds[0]);
+  if (!load_generator.Wait()) {
+    return std::nullopt;
+  }
+
+  const auto throughput = FindNumber(output, "throughput");
+  const auto p99        = FindNumber(FindObject(output, "latency_us"), "p99");
+  const auto errors     = FindNumber(output, "errors");
+  if (!throughput.has_value() || !p99.has_value()) {
+    return std::nullopt;
+  }
+  if (errors.value_or(0) > 0) {
+    fmt::print("  {} errors in the trial\n", *errors);
+  }
+  return TrialResult{*throughput, *p99};
+}
+
+struct ScenarioResult {
+  std::string name;
+  Estimate throughput;
+  Estimate p99;
+};
+
+struct Tolerance {
+  // relative, 0.1 allows a 10% change
+  double throughput = 0.1;
+  double p99        = 0.2;
+};
+
+// A scenario only regresses when the whole confidence interval is past the
+// tolerance, a noisy run widens the interval instead of failing the check
+auto Compare(
+  const ScenarioResult& result,
+  std::string_view baseline,
+  const Tolerance& tolerance) -> bool {
+  const auto expected = FindObject(baseline, result.name);
+  const auto throughput = FindNumber(expected, "throughput");
+  const auto p99 = FindNumber(expected, "p99_us");
+  if (!throughput.has_value() || !p99.has_value()) {
+    fmt::print(
+      "{:<18} {:>10.0f} ±{:<8.0f} req/s, {:.0f} ±{:.0f} us p99, "
+      "no baseline\n",
+      result.name,
+      result.throughput.mean,
+      result.throughput.half_width,
+      result.p99.mean,
+      result.p99.half_width);
+    return true;
+  }
+  const auto throughput_floor = *throughput * (1 - tolerance.throughput);
+  const auto p99_ceiling      = *p99 * (1 + tolerance.p99);
+  const bool throughput_ok = result.throughput.GetUpper() >= throughput_floor;
+  const bool p99_ok        = result.p99.GetLower() <= p99_ceiling;
+  fmt::print(
+    "{:<18} {:>10.0f} ±{:<8.0f} req/s (baseline {:>8.0f}, min {:>8.0f}) {}\n",
+    result.name,
+    result.throughput.mean,
+    result.throughput.half_width,
+    *throughput,
+    throughput_floor,
+    throughput_ok ? "ok" : "REGRESSION");
+  fmt::print(
+    "{:<18} {:>10.0f} ±{:<8.0f} us p99 (baseline {:>8.0f}, max {:>8.0f}) {}\n",
+    "",
+    result.p99.mean,
+    result.p99.half_width,
+    *p99,
+    p99_ceiling,
+    p99_ok ? "ok" : "REGRESSION");
+  return throughput_ok && p99_ok;
+}
+
+auto FormatBaseline(
+  const std::vector<ScenarioResult>& results,
+  const Tolerance& tolerance) -> std::string {
+  std::string json = fmt::format(
+    "{{\n  \"tolerance\": {{\"throughput\": {}, \"p99\": {}}},\n"
+    "  \"scenarios\": {{\n",
+    tolerance.throughput,
+    tolerance.p99);
+  for (size_t i = 0; i < results.size(); ++i) {
+    json += fmt::format(
+      "    \"{}\": {{\"throughput\": {:.0f}, \"p99_us\": {:.0f}, "
+      "\"throughput_ci\": {:.0f}, \"p99_ci\": {:.0f}}}{}\n",
+      results[i].name,
+      results[i].throughput.mean,
+      results[i].p99.mean,
+      results[i].throughput.half_width,
+      results[i].p99.half_width,
+      i + 1 < results.size() ? "," : "");
+  }
+  json += "  }\n}\n";
+  return json;
+}
+}    // namespace
+}    // namespace longlp
+
+// Runs the http server on loopback against fixed load scenarios and compares
+// throughput and p99 latency with a baseline, exits with 1 on a regression
+auto main(int argc, char* argv[]) -> int {
+  cxxopts::Options options(
+    "longlp-perf-check",
+    "Check the http server against a performance baseline");
+
+  // clang-format off
+  options.add_options()
+    ("server", "http_server executable", cxxopts::value<std::string>())
+    (
+      "load-generator",
+      "load_generator executable",
+      cxxopts::value<std::string>()
+    )
+    ("directory", "pages served", cxxopts::value<std::string>())
+    ("baseline", "baseline to compare with", cxxopts::value<std::string>())
+    (
+      "write-baseline",
+      "write the results as a new baseline to this path",
+      cxxopts::value<std::string>()
+    )
+    (
+      "log-dir",
+      "directory of the server log files",
+      cxxopts::value<std::string>()->default_value(".")
+    )
+    ("port", "server port", cxxopts::value<uint16_t>()->default_value("18080"))
+    (
+      "trials",
+      "runs per scenario",
+      cxxopts::value<size_t>()->default_value("5")
+    )
+    (
+      "warmup",
+      "seconds of load before each trial is measured",
+      cxxopts::value<double>()->default_value("1")
+    )
+    (
+      "duration",
+      "seconds measured per trial",
+      cxxopts::value<double>()->default_value("3")
+    )
+    (
+      "server-cpus",
+      "cpus of the server, e.g. 0-3, half of them by default",
+      cxxopts::value<std::string>()
+    )
+    (
+      "client-cpus",
+      "cpus of the load generator, the other half by default",
+      cxxopts::value<std::string>()
+    )
+    (
+      "scenario",
+      "only run these scenarios, may be repeated",
+      cxxopts::value<std::vector<std::string>>()
+    )
+    ("h,help", "Print usage")
+  ;
+  // clang-format on
+
+  auto result = options.parse(argc, argv);
+  if (
+    result.count("help") != 0U || result.count("server") == 0U ||
+    result.count("load-generator") == 0U || result.count("directory") == 0U) {
+    fmt::print("{}\n", options.help());
+    return result.count("help") != 0U ? 0 : 2;
+  }
+
+  longlp::Options check_options{};
+  check_options.server_path         = result["server"].as<std::string>();
+  check_options.load_generator_path =
+    result["load-generator"].as<std::string>();
+  check_options.directory           = result["directory"].as<std::string>();
+  check_options.log_directory       = result["log-dir"].as<std::string>();
+  check_options.port                = result["port"].as<uint16_t>();
+  check_options.trials   = std::max<size_t>(result["trials"].as<size_t>(), 1);
+  check_options.warmup   = result["warmup"].as<double>();
+  check_options.duration = result["duration"].as<double>();
+  if (result.count("server-cpus") != 0U) {
+    check_options.server_cpus =
+      longlp::ParseCpuList(result["server-cpus"].as<std::string>());
+  }
+  if (result.count("client-cpus") != 0U) {
+    check_options.client_cpus =
+      longlp::ParseCpuList(result["client-cpus"].as<std::string>());
+  }
+  longlp::SplitCpus(check_options);
+  check_options.client_threads =
+    check_options.client_cpus.has_value()
+      ? static_cast<size_t>(CPU_COUNT(&*check_options.client_cpus))
+      : 1;
+
+  auto scenarios = longlp::GetScenarios();
+  if (result.count("scenario") != 0U) {
+    const auto names = result["scenario"].as<std::vector<std::string>>();
+    std::erase_if(scenarios, [&](const longlp::Scenario& scenario) {
+      return std::find(names.begin(), names.end(), scenario.name) ==
+             names.end();
+    });
+  }
+
+  std::string baseline;
+  if (result.count("baseline") != 0U) {
+    baseline = longlp::ReadFile(result["baseline"].as<std::string>());
+  }
+  longlp::Tolerance tolerance{};
+  const auto baseline_tolerance = longlp::FindObject(baseline, "tolerance");
+  tolerance.throughput = longlp::FindNumber(baseline_tolerance, "throughput")
+                           .value_or(tolerance.throughput);
+  tolerance.p99 =
+    longlp::FindNumber(baseline_tolerance, "p99").value_or(tolerance.p99);
+
+  fmt::print(
+    "server cpus [{}], load generator cpus [{}], {} trials of {}s after {}s "
+    "of warm-up\n",
+    check_options.server_cpus.has_value()
+      ? longlp::FormatCpuList(*check_options.server_cpus)
+      : "any",
+    check_options.client_cpus.has_value()
+      ? longlp::FormatCpuList(*check_options.client_cpus)
+      : "any",
+    check_options.trials,
+    check_options.duration,
+    check_options.warmup);
+
+  const int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  longlp::ChildProcess server{
+    {check_options.server_path,
+     fmt::format("--directory={}", check_options.directory),
+     fmt::format("--port={}", check_options.port),
+     "--log-level=error",
+     fmt::format("--log-dir={}", check_options.log_directory)},
+    check_options.server_cpus,
+    null_fd};
+  close(null_fd);
+  const auto deadline = std::chrono::steady_clock::now() +
+                        longlp::kServerStartTimeout;
+  while (!longlp::IsAcceptingConnections(check_options.port)) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      fmt::print("the server did not start on port {}\n", check_options.port);
+      return 2;
+    }
+    std::this_thread::sleep_for(longlp::kServerStartPollInterval);
+  }
+
+  std::vector<longlp::ScenarioResult> scenario_results;
+  for (const auto& scenario : scenarios) {
+    std::vector<double> throughputs;
+    std::vector<double> p99s;
+    for (size_t trial = 0; trial < check_options.trials; ++trial) {
+      const auto trial_result = longlp::RunTrial(check_options, scenario);
+      if (!trial_result.has_value()) {
+        fmt::print("{}: the load generator failed\n", scenario.name);
+        return 2;
+      }
+      throughputs.push_back(trial_result->throughput);
+      p99s.push_back(trial_result->p99);
+    }
+    scenario_results.push_back(
+      {scenario.name,
+       longlp::Estimate95(throughputs),
+       longlp::Estimate95(p99s)});
+  }
+  server.Terminate();
+
+  bool passed = true;
+  for (const auto& scenario_result : scenario_results) {
+    passed = longlp::Compare(scenario_result, baseline, tolerance) && passed;
+  }
+
+  if (result.count("write-baseline") != 0U) {
+    const auto path = result["write-baseline"].as<std::string>();
+    std::ofstream(path) << longlp::FormatBaseline(scenario_results, tolerance);
+    fmt::print("baseline written to {}\n", path);
+    return 0;
+  }
+  return passed ? 0 : 1;
+}
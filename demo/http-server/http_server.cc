@@ -2,96 +2,813 @@
 // Use of this source code is governed by a MIT license that can be
 // found in the LICENSE file.
 
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <optional>
 #include <string_view>
 #include <system_error>
 #include <thread>
+#include <vector>
 
 #include <fmt/format.h>
 #include <cxxopts.hpp>
 
+#include "base/macros.h"
 #include "base/pointers.h"
 #include "core/cache.h"
 #include "core/connection.h"
 #include "core/looper.h"
+#include "core/metrics.h"
 #include "core/net_address.h"
 #include "core/server.h"
+#include "core/stall_detector.h"
+#include "core/task.h"
+#include "core/thread_pool.h"
+#include "core/trace.h"
+#include "http/cgi_cache.h"
+#include "http/cgi_limiter.h"
 #include "http/cgi_runner.h"
+#include "http/cgi_worker_pool.h"
 #include "http/constants.h"
+#include "http/content_encoding.h"
 #include "http/header.h"
 #include "http/http_utils.h"
+#include "http/plugin_registry.h"
 #include "http/request.h"
+#include "http/request_arena.h"
 #include "http/response.h"
 #include "log/logger.h"
 
 namespace longlp::http {
 
 namespace {
+void SerializeCGIResponse(
+  bool should_close,
+  const DynamicByteArray& cgi_result,
+  DynamicByteArray& response_buf) {
+  auto response = Response::Make200Response(should_close, std::nullopt);
+  std::ignore   = response.ChangeHeader(
+    kHeaderContentLength,
+    std::to_string(cgi_result.size()));
+  response.Serialize(response_buf);
+  response_buf.insert(response_buf.end(), cgi_result.begin(), cgi_result.end());
+}
+
+void SerializeOverloadResponse(
+  std::chrono::seconds retry_after,
+  DynamicByteArray& response_buf) {
+  auto response = Response::Make503Response();
+  response.AddHeader(kHeaderRetryAfter, std::to_string(retry_after.count()));
+  response.Serialize(response_buf);
+}
+
+auto HandleCGIRequest(
+  const Request& request,
+  const std::string& resource_full_path,
+  DynamicByteArray& response_buf) -> bool /* should_finish */ {
+  // dynamic CGI request
+  CGIRunner cgi_runner = CGIRunner::ParseCGIRunner(resource_full_path);
+  if (!cgi_runner.IsValid()) {
+    auto response = Response::Make400Response();
+    response.Serialize(response_buf);
+    return true;
+  }
+
+  auto cgi_program_path = cgi_runner.GetPath();
+  if (!IsFileExists(cgi_program_path)) {
+    auto response = Response::Make404Response();
+    response.Serialize(response_buf);
+    return true;
+  }
+
+  auto cgi_result = cgi_runner.Run();
+  SerializeCGIResponse(request.ShouldClose(), cgi_result, response_buf);
+  return request.ShouldClose();
+}
+
+struct RequestMetrics {
+  Counter& requests;
+  Histogram& duration;
+};
+
+auto GetRequestMetrics() -> RequestMetrics& {
+  auto& registry = MetricsRegistry::GetInstance();
+  static RequestMetrics metrics{
+    registry.GetCounter("longlp_http_requests_total", "Http requests served"),
+    registry.GetHistogram(
+      "longlp_http_request_duration_seconds",
+      "Time from the parsing of a request to its response sent")};
+  return metrics;
+}
+
+// Times a request for the metrics and the access log, both are updated once
+// the response is sent. |handle| lasts until the first byte of the response
+// is ready and |send| until the last one is sent
+class AccessRecord {
+ public:
+  // the request is about to be parsed
+  explicit AccessRecord(not_null<Connection*> client) :
+    enabled_(Logger::IsAccessLogEnabled()),
+    mark_(std::chrono::steady_clock::now()) {
+    if (!enabled_) {
+      return;
+    }
+    entry_.time = system_clock::now();
+    const auto& peer = client->GetPeerAddress();
+    entry_.client.Format("{}:{}", peer.GetIp(), peer.GetPort());
+    entry_.reactor_id = client->GetLooper()->GetId();
+  }
+
+  void OnParsed(const Request& request) {
+    entry_.parse = Lap();
+    if (!enabled_) {
+      return;
+    }
+    if (!request.IsValid()) {
+      entry_.method.Assign("-");
+      return;
+    }
+    entry_.method.Assign(
+      request.GetMethod() == Method::kHEAD ? std::string_view("HEAD")
+                                           : std::string_view("GET"));
+    entry_.url.Assign(request.GetResourceUrl());
+  }
+
+  // a piece of the response is about to be sent, the first one starts with
+  // the status line
+  void OnResponse(const DynamicByteArray& response_buf) {
+    if (entry_.status == 0) {
+      entry_.handle = Lap();
+      entry_.status = ParseStatus(response_buf);
+    }
+    entry_.bytes_sent += response_buf.size();
+  }
+
+  void Commit() {
+    entry_.send   = Lap();
+    auto& metrics = GetRequestMetrics();
+    metrics.requests.Increment();
+    metrics.duration.Observe(entry_.parse + entry_.handle + entry_.send);
+    if (enabled_) {
+      Logger::LogAccess(entry_);
+    }
+  }
+
+ private:
+  // "HTTP/1.1 200 OK", 0 if it cannot be read
+  static auto ParseStatus(const DynamicByteArray& response_buf) -> uint16_t {
+    constexpr size_t kStatusBegin = std::string_view("HTTP/1.1 ").size();
+    constexpr size_t kStatusSize  = 3;
+    uint16_t status               = 0;
+    if (response_buf.size() < kStatusBegin + kStatusSize) {
+      return status;
+    }
+    for (size_t i = kStatusBegin; i < kStatusBegin + kStatusSize; ++i) {
+      if (response_buf[i] < '0' || response_buf[i] > '9') {
+        return 0;
+      }
+      status = static_cast<uint16_t>(status * 10 + (response_buf[i] - '0'));
+    }
+    return status;
+  }
+
+  auto Lap() -> microseconds {
+    const auto now = std::chrono::steady_clock::now();
+    const auto lap = duration_cast<microseconds>(now - mark_);
+    mark_          = now;
+    return lap;
+  }
+
+  bool enabled_;
+  std::chrono::steady_clock::time_point mark_;
+  AccessLogEntry entry_;
+};
+
+// Forward a running cgi program output to the client as a chunked response,
+// as soon as it is produced
+class CGIStream {
+ public:
+  CGIStream(
+    not_null<Connection*> client,
+    bool should_close,
+    const AccessRecord& access) :
+    client_(client),
+    lifetime_(client->GetLifetime()),
+    should_close_(should_close),
+    access_(access) {}
+
+  void Forward(const Byte* data, size_t size) {
+    // the client is gone while the program was running
+    if (lifetime_.expired()) {
+      return;
+    }
+    DynamicByteArray response_buf;
+    SerializeHeadOnce(response_buf);
+    Response::AppendChunk(data, size, response_buf);
+    access_.OnResponse(response_buf);
+    client_->Write(std::move(response_buf));
+    client_->Send();
+  }
+
+  [[nodiscard]] auto IsClientGone() const -> bool {
+    return lifetime_.expired();
+  }
+
+  // the program could not be started after the client was suspended
+  void Abort(std::chrono::seconds retry_after) {
+    if (lifetime_.expired() || head_sent_) {
+      return;
+    }
+    DynamicByteArray response_buf;
+    SerializeOverloadResponse(retry_after, response_buf);
+    access_.OnResponse(response_buf);
+    client_->Write(std::move(response_buf));
+    client_->Send();
+    access_.Commit();
+    std::ignore = client_->GetLooper()->DeleteConnection(client_->GetFd());
+  }
+
+  void Finish() {
+    if (lifetime_.expired()) {
+      return;
+    }
+    DynamicByteArray response_buf;
+    SerializeHeadOnce(response_buf);
+    Response::AppendLastChunk(response_buf);
+    access_.OnResponse(response_buf);
+    client_->Write(std::move(response_buf));
+    client_->Send();
+    Complete();
+  }
+
+  // the whole output at once, from the cache
+  void Deliver(const DynamicByteArray& cgi_result) {
+    if (lifetime_.expired()) {
+      return;
+    }
+    DynamicByteArray response_buf;
+    SerializeCGIResponse(should_close_, cgi_result, response_buf);
+    access_.OnResponse(response_buf);
+    client_->Write(std::move(response_buf));
+    client_->Send();
+    Complete();
+  }
+
+ private:
+  void Complete() {
+    access_.Commit();
+    if (should_close_) {
+      std::ignore = client_->GetLooper()->DeleteConnection(client_->GetFd());
+      return;
+    }
+    // catch up with the requests pipelined in the meantime
+    client_->Resume();
+  }
+
+  void SerializeHeadOnce(DynamicByteArray& response_buf) {
+    if (head_sent_) {
+      return;
+    }
+    auto response = Response::MakeChunkedResponse(should_close_);
+    response.Serialize(response_buf);
+    head_sent_ = true;
+  }
+
+  not_null<Connection*> client_;
+  std::weak_ptr<void> lifetime_;
+  bool should_close_;
+  bool head_sent_{false};
+  AccessRecord access_;
+};
+
+enum class CGIDispatch {
+  // to be answered by HandleCGIRequest()
+  kSynchronous,
+  // answered from the cache
+  kAnswered,
+  // running, queued or waiting for an identical request, streamed from the
+  // event loop
+  kStarted,
+  // overloaded, to be answered with 503
+  kRejected,
+};
+
+// Run the cgi program without blocking the reactor once the limiter grants a
+// slot, on a persistent worker if one is free or a spawned process otherwise.
+// The output is streamed to the client, and recorded if the request leads a
+// cache flight
+auto DispatchCGI(
+  const CGIRunner& cgi_runner,
+  CGIWorkerPool* cgi_workers,
+  const std::shared_ptr<CGIStream>& stream,
+  const std::shared_ptr<CGICache::Flight>& flight,
+  not_null<Looper*> looper,
+  CGILimiter& cgi_limiter) -> CGILimiter::Admission {
+  auto run_spawned = [cgi_runner, stream, flight, looper, &cgi_limiter]() {
+    const auto program = cgi_runner.GetPath();
+    const auto started = cgi_runner.RunAsync(
+      looper,
+      [stream, flight](const Byte* data, size_t size) {
+        if (flight != nullptr) {
+          flight->Append(data, size);
+        }
+        stream->Forward(data, size);
+      },
+      [stream, flight, program, &cgi_limiter](int status) {
+        cgi_limiter.Release(program);
+        // only a successful output is worth caching
+        if (
+          flight != nullptr && WIFEXITED(status) &&
+          WEXITSTATUS(status) == 0) {
+          flight->Commit();
+        }
+        stream->Finish();
+      });
+    if (!started) {
+      cgi_limiter.Release(program);
+      stream->Abort(cgi_limiter.GetRetryAfter());
+    }
+  };
+  auto launch = [cgi_runner,
+                 cgi_workers,
+                 stream,
+                 flight,
+                 looper,
+                 &cgi_limiter,
+                 run_spawned]() {
+    const auto program = cgi_runner.GetPath();
+    // the client left while waiting in the queue
+    if (stream->IsClientGone() && flight == nullptr) {
+      cgi_limiter.Release(program);
+      return;
+    }
+    if (cgi_workers == nullptr) {
+      run_spawned();
+      return;
+    }
+    auto on_done = [stream, flight, program, &cgi_limiter, run_spawned](
+                     std::optional<DynamicByteArray> output) {
+      // the worker was recycled, run the request on a fresh process
+      if (!output.has_value()) {
+        run_spawned();
+        return;
+      }
+      cgi_limiter.Release(program);
+      if (flight != nullptr) {
+        flight->Append(output->data(), output->size());
+        flight->Commit();
+      }
+      stream->Deliver(*output);
+    };
+    if (!cgi_workers->RunAsync(cgi_runner, looper, std::move(on_done))) {
+      run_spawned();
+    }
+  };
+
+  // a queued request is launched from its own looper thread
+  const auto admission = cgi_limiter.TryAcquire(
+    cgi_runner.GetPath(),
+    [looper, launch]() { looper->Post(launch); });
+  if (admission == CGILimiter::Admission::kAdmitted) {
+    launch();
+  }
+  return admission;
+}
+
+auto StartCGIRequest(
+  const Request& request,
+  const std::string& resource_full_path,
+  CGIWorkerPool* cgi_workers,
+  CGILimiter& cgi_limiter,
+  CGICache* cgi_cache,
+  not_null<Connection*> client_connection,
+  const AccessRecord& access,
+  DynamicByteArray& response_buf) -> CGIDispatch {
+  CGIRunner cgi_runner = CGIRunner::ParseCGIRunner(resource_full_path);
+  if (!cgi_runner.IsValid() || !IsFileExists(cgi_runner.GetPath())) {
+    return CGIDispatch::kSynchronous;
+  }
+
+  auto* looper = client_connection->GetLooper();
+  auto stream = std::make_shared<CGIStream>(
+    client_connection,
+    request.ShouldClose(),
+    access);
+  std::shared_ptr<CGICache::Flight> flight = nullptr;
+  if (cgi_cache != nullptr) {
+    DynamicByteArray cgi_result;
+    auto ticket = cgi_cache->Join(
+      cgi_runner,
+      cgi_result,
+      [cgi_runner, cgi_workers, stream, looper, &cgi_limiter](
+        CGICache::Output output) {
+        looper->Post([cgi_runner,
+                      cgi_workers,
+                      stream,
+                      looper,
+                      &cgi_limiter,
+                      output]() {
+          if (output != nullptr) {
+            stream->Deliver(*output);
+            return;
+          }
+          // the identical request failed, run the program on our own
+          const auto admission = DispatchCGI(
+            cgi_runner,
+            cgi_workers,
+            stream,
+            nullptr,
+            looper,
+            cgi_limiter);
+          if (admission == CGILimiter::Admission::kRejected) {
+            stream->Abort(cgi_limiter.GetRetryAfter());
+          }
+        });
+      });
+    switch (ticket.outcome) {
+      case CGICache::Outcome::kHit:
+        SerializeCGIResponse(request.ShouldClose(), cgi_result, response_buf);
+        return CGIDispatch::kAnswered;
+      case CGICache::Outcome::kFollower:
+        return CGIDispatch::kStarted;
+      case CGICache::Outcome::kLeader:
+        flight = std::move(ticket.flight);
+        break;
+      case CGICache::Outcome::kBypass:
+        break;
+    }
+  }
+
+  const auto admission = DispatchCGI(
+    cgi_runner,
+    cgi_workers,
+    stream,
+    flight,
+    looper,
+    cgi_limiter);
+  return admission == CGILimiter::Admission::kRejected ? CGIDispatch::kRejected
+                                                       : CGIDispatch::kStarted;
+}
+
+// Tell the coding of a 200/304 response of a static resource
+void DescribeContentEncoding(
+  Response& response,
+  bool has_variants,
+  ContentEncoding encoding,
+  std::string_view etag) {
+  if (has_variants) {
+    response.AddHeader(kHeaderVary, kHeaderAcceptEncoding);
+  }
+  if (encoding != ContentEncoding::kIdentity) {
+    response.AddHeader(kHeaderContentEncoding, ToString(encoding));
+    std::ignore =
+      response.ChangeHeader(kHeaderETag, MakeVariantETag(etag, encoding));
+  }
+}
+
+// A static resource whose content is read off the reactor
+struct OffReactorResource {
+  std::string path;
+  std::string etag;
+  FileInfo file_info;
+  // the negotiated coding, identity is sent if it cannot be produced
+  ContentEncoding encoding;
+  bool has_variants;
+  // false for HEAD, the content is only read for the length of a variant
+  bool send_content;
+  bool should_close;
+};
+
+BEGIN_SUPPRESS_COROUTINE_WARNINGS
+
+// Read |resource| on |file_pool|, compressing it if need be, and fill the
+// cache with it, then answer from the looper owning the client. The content
+// length is the one of the bytes read, the file may have changed since it was
+// looked up
+auto ServeFileOffReactor(
+  OffReactorResource resource,
+  std::shared_ptr<Cache> cache,
+  ThreadPool& file_pool,
+  Connection* client,
+  AccessRecord access) -> Task<> {
+  const auto lifetime = client->GetLifetime();
+  auto load           = [&resource, &cache]() {
+    DynamicByteArray content;
+    // queued behind a read of the same file which filled the cache already
+    const auto encoding = LoadContent(
+      resource.path,
+      resource.encoding,
+      *cache,
+      content,
+      resource.etag);
+    return std::make_pair(std::move(content), encoding);
+  };
+  auto [content, encoding] = co_await file_pool.Offload(std::move(load));
+  if (lifetime.expired()) {
+    co_return;
+  }
+  // out of the arena of the reactor, the request is long gone
+  auto response = Response::Make200Response(
+    resource.should_close,
+    resource.path,
+    resource.file_info);
+  DescribeContentEncoding(
+    response,
+    resource.has_variants,
+    encoding,
+    resource.etag);
+  std::ignore = response.ChangeHeader(
+    kHeaderContentLength,
+    std::to_string(content.size()));
+  if (!resource.send_content) {
+    content.clear();
+  }
+  DynamicByteArray response_head;
+  response.Serialize(response_head);
+  access.OnResponse(response_head);
+  access.OnResponse(content);
+  client->Write(std::move(response_head));
+  client->Write(std::move(content));
+  client->Send();
+  access.Commit();
+  if (resource.should_close) {
+    std::ignore = client->GetLooper()->DeleteConnection(client->GetFd());
+    co_return;
+  }
+  client->Resume();
+}
+
+END_SUPPRESS_COROUTINE_WARNINGS
+
+// Read the content of a cache miss on |file_pool| unless it is nullptr, a
+// compressed variant included.
+// Return std::nullopt if the response is sent later from the event loop
 auto HandleStaticResourceRequest(
   const Request& request,
   const std::string& resource_full_path,
   std::shared_ptr<Cache>& cache,
-  DynamicByteArray& response_buf) -> bool /* should_finish */ {
-  if (!IsFileExists(resource_full_path)) {
-    Log<LogLevel::kInfo>(fmt::format("{} not exist.", resource_full_path));
+  ThreadPool* file_pool,
+  not_null<Connection*> client_connection,
+  const AccessRecord& access,
+  DynamicByteArray& response_buf) -> std::optional<bool> /* should_finish */ {
+  // the single stat() of the file for this request
+  const auto file_info = StatFile(resource_full_path);
+  if (!file_info.has_value()) {
+    Log<LogLevel::kInfo>("{} not exist.", resource_full_path);
     auto response = Response::Make404Response();
     response.Serialize(response_buf);
     return true;
   }
 
-  auto response =
-    Response::Make200Response(request.ShouldClose(), resource_full_path);
-  response.Serialize(response_buf);
+  auto encoding =
+    NegotiateContentEncoding(request.GetAcceptEncoding(), resource_full_path);
+  const auto etag         = MakeETag(file_info.value());
+  const auto has_variants = HasEncodedVariants(resource_full_path);
+
+  // conditional GET, the client copy is still fresh, no need of content
+  if (request.IsNotModified(
+        MakeVariantETag(etag, encoding),
+        file_info->last_modified)) {
+    auto response = Response::Make304Response(
+      request.ShouldClose(),
+      resource_full_path,
+      file_info.value(),
+      request.get_allocator());
+    DescribeContentEncoding(response, has_variants, encoding, etag);
+    response.Serialize(response_buf);
+    return request.ShouldClose();
+  }
 
+  // only concern about carrying content when GET request, but the encoded
+  // length is only known from the variant itself, so it is loaded for HEAD
+  // request as well
+  const auto send_content = request.GetMethod() == Method::kGET;
   DynamicByteArray cache_buf;
-  if (request.GetMethod() == Method::kGET) {
-    // only concern about carrying content when GET request
-    bool resource_cached = cache->TryLoad(resource_full_path, cache_buf);
-    if (!resource_cached) {
+  if (encoding != ContentEncoding::kIdentity || send_content) {
+    const auto cached =
+      encoding == ContentEncoding::kIdentity
+        ? cache->TryLoad(resource_full_path, cache_buf, etag)
+        : LoadCachedVariant(
+            resource_full_path,
+            encoding,
+            *cache,
+            cache_buf,
+            etag);
+    if (!cached && file_pool != nullptr) {
+      // neither a cold disk nor compression must stall the other clients of
+      // the reactor
+      ServeFileOffReactor(
+        OffReactorResource{
+          resource_full_path,
+          etag,
+          file_info.value(),
+          encoding,
+          has_variants,
+          send_content,
+          request.ShouldClose()},
+        cache,
+        *file_pool,
+        client_connection,
+        access)
+        .Detach();
+      return std::nullopt;
+    }
+    if (!cached) {
       // if content directly from cache, not disk file I/O
       // otherwise content not in cache, load from disk and try cache
-      // it
-      LoadFile(resource_full_path, cache_buf);
-      std::ignore = cache->TryInsert(resource_full_path, cache_buf);
+      // it. Fall back to identity if the variant cannot be produced
+      encoding =
+        LoadContent(resource_full_path, encoding, *cache, cache_buf, etag);
     }
   }
+
+  auto response = Response::Make200Response(
+    request.ShouldClose(),
+    resource_full_path,
+    file_info.value(),
+    request.get_allocator());
+  DescribeContentEncoding(response, has_variants, encoding, etag);
+  if (encoding != ContentEncoding::kIdentity) {
+    std::ignore = response.ChangeHeader(
+      kHeaderContentLength,
+      std::to_string(cache_buf.size()));
+  }
+  if (!send_content) {
+    cache_buf.clear();
+  }
+  response.Serialize(response_buf);
   // now cache_buf contains the file content anyway
   response_buf.insert(response_buf.end(), cache_buf.begin(), cache_buf.end());
   return request.ShouldClose();
 }
 
-auto HandleCGIRequest(
-  const Request& request,
-  const std::string& resource_full_path,
-  DynamicByteArray& response_buf) -> bool /* should_finish */ {
-  // dynamic CGI request
-  CGIRunner cgi_runner = CGIRunner::ParseCGIRunner(resource_full_path);
-  if (!cgi_runner.IsValid()) {
-    auto response = Response::Make400Response();
-    response.Serialize(response_buf);
-    return true;
+BEGIN_SUPPRESS_COROUTINE_WARNINGS
+
+// Serve |request| from a plugin which may block on |blocking_pool|, then
+// answer it back on the looper owning the client
+auto ServeBlockingPlugin(
+  const longlp_plugin* plugin,
+  std::shared_ptr<const Request> request,
+  ThreadPool& blocking_pool,
+  Connection* client,
+  AccessRecord access) -> Task<> {
+  const auto lifetime = client->GetLifetime();
+  auto serve          = [plugin, request]() {
+    DynamicByteArray plugin_response;
+    const auto should_close =
+      PluginRegistry::Serve(*plugin, *request, plugin_response);
+    return std::make_pair(std::move(plugin_response), should_close);
+  };
+  auto [plugin_response, should_close] =
+    co_await blocking_pool.Offload(std::move(serve));
+  if (lifetime.expired()) {
+    co_return;
   }
+  access.OnResponse(plugin_response);
+  client->Write(std::move(plugin_response));
+  client->Send();
+  access.Commit();
+  if (should_close) {
+    std::ignore = client->GetLooper()->DeleteConnection(client->GetFd());
+    co_return;
+  }
+  client->Resume();
+}
 
-  auto cgi_program_path = cgi_runner.GetPath();
-  if (!IsFileExists(cgi_program_path)) {
+END_SUPPRESS_COROUTINE_WARNINGS
+
+// Serve the request from an in-process plugin, on the reactor unless the
+// plugin may block.
+// Return std::nullopt if the response is sent later from the event loop
+auto HandlePluginRequest(
+  Request request,
+  const PluginRegistry& plugins,
+  ThreadPool* blocking_pool,
+  not_null<Connection*> client_connection,
+  const AccessRecord& access,
+  DynamicByteArray& response_buf) -> std::optional<bool> /* should_finish */ {
+  const auto resource_url = request.GetResourceUrl();
+  const auto route        = PluginRegistry::ParseRoute(resource_url);
+  const auto* plugin =
+    route.has_value() ? plugins.Find(route->first) : nullptr;
+  if (plugin == nullptr) {
     auto response = Response::Make404Response();
     response.Serialize(response_buf);
     return true;
   }
 
-  auto cgi_result = cgi_runner.Run();
-  auto response =
-    Response::Make200Response(request.ShouldClose(), std::nullopt);
-  std::ignore = response.ChangeHeader(
-    kHeaderContentLength,
-    std::to_string(cgi_result.size()));
+  const auto may_block = (plugin->flags & LONGLP_PLUGIN_BLOCKING) != 0U;
+  if (!may_block || blocking_pool == nullptr) {
+    return PluginRegistry::Serve(*plugin, request, response_buf);
+  }
+
+  // out of the arena of the reactor, which is reused once this returns
+  ServeBlockingPlugin(
+    plugin,
+    std::make_shared<const Request>(request, Request::allocator_type{}),
+    *blocking_pool,
+    client_connection,
+    access)
+    .Detach();
+  return std::nullopt;
+}
+
+// the metrics of the server, e.g. to be scraped by Prometheus
+auto HandleMetricsRequest(
+  const Request& request,
+  DynamicByteArray& response_buf) -> bool /* should_finish */ {
+  std::string content;
+  MetricsRegistry::GetInstance().WriteText(content);
+  Response response{
+    kResponseStatusOK,
+    request.ShouldClose(),
+    std::nullopt,
+    request.get_allocator()};
+  std::ignore =
+    response.ChangeHeader(kHeaderContentLength, std::to_string(content.size()));
+  response.AddHeader(kHeaderContentType, kMimeTypeMetrics);
   response.Serialize(response_buf);
-  response_buf.insert(response_buf.end(), cgi_result.begin(), cgi_result.end());
+  if (request.GetMethod() == Method::kGET) {
+    response_buf.insert(response_buf.end(), content.begin(), content.end());
+  }
+  return request.ShouldClose();
+}
+
+// the spans recorded so far, to be opened in chrome://tracing or Perfetto
+auto HandleTraceRequest(
+  const Request& request,
+  DynamicByteArray& response_buf) -> bool /* should_finish */ {
+  std::string content;
+  Tracer::GetInstance().WriteChromeTrace(content);
+  Response response{
+    kResponseStatusOK,
+    request.ShouldClose(),
+    std::nullopt,
+    request.get_allocator()};
+  std::ignore =
+    response.ChangeHeader(kHeaderContentLength, std::to_string(content.size()));
+  response.AddHeader(kHeaderContentType, kMimeTypeJSON);
+  response.Serialize(response_buf);
+  if (request.GetMethod() == Method::kGET) {
+    response_buf.insert(response_buf.end(), content.begin(), content.end());
+  }
   return request.ShouldClose();
 }
 
+// write end of the pipe waking up the trace writer, see DumpTraceOnSignal()
+int trace_signal_fd = -1;
+
+void OnTraceSignal(int /* signal */) {
+  const char wakeup = 1;
+  std::ignore       = write(trace_signal_fd, &wakeup, sizeof(wakeup));
+}
+
+// Write the spans to longlp_trace_PID.N.json in |directory| on every SIGUSR2,
+// from a thread of its own since a signal handler cannot do it
+void DumpTraceOnSignal(std::string directory) {
+  std::array<int, 2> pipe_fds{};
+  if (pipe2(pipe_fds.data(), O_CLOEXEC) == -1) {
+    Log<LogLevel::kError>("fail to create the trace signal pipe");
+    return;
+  }
+  trace_signal_fd = pipe_fds[1];
+  std::thread([read_fd = pipe_fds[0], directory = std::move(directory)]() {
+    char wakeup{};
+    for (size_t count = 0; read(read_fd, &wakeup, sizeof(wakeup)) > 0;
+         ++count) {
+      std::string content;
+      Tracer::GetInstance().WriteChromeTrace(content);
+      const auto path =
+        fmt::format("{}/longlp_trace_{}.{}.json", directory, getpid(), count);
+      std::ofstream(path) << content;
+      Log<LogLevel::kWarning>("trace written to {}", path);
+    }
+  }).detach();
+
+  struct sigaction action {};
+  action.sa_handler = OnTraceSignal;
+  action.sa_flags   = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR2, &action, nullptr);
+}
+
 void ProcessHttpRequest(
   const std::string_view serving_directory,
+  const std::string_view metrics_path,
+  const std::string_view trace_path,
   std::shared_ptr<Cache>& cache,
+  CGIWorkerPool* cgi_workers,
+  CGILimiter& cgi_limiter,
+  CGICache* cgi_cache,
+  const PluginRegistry& plugins,
+  ThreadPool* plugin_pool,
+  ThreadPool* file_pool,
   not_null<Connection*> client_connection) {
   Log<LogLevel::kInfo>("detect request");
 
@@ -101,7 +818,7 @@ void ProcessHttpRequest(
   if (exit) {
     std::ignore = client_connection->GetLooper()->DeleteConnection(from_fd);
 
-    Log<LogLevel::kInfo>(fmt::format("client fd={} has exited.", from_fd));
+    Log<LogLevel::kInfo>("client fd={} has exited.", from_fd);
 
     // client_connection ptr is invalid below here, do not touch it again
     return;
@@ -114,7 +831,14 @@ void ProcessHttpRequest(
     auto request_op = client_connection->FindAndPopTill("\r\n\r\n");
     request_op != std::nullopt;
     request_op = client_connection->FindAndPopTill("\r\n\r\n")) {
-    Request request{request_op.value()};
+    // the request and its response head are released together
+    const RequestArena::Scope arena{};
+    AccessRecord access{client_connection};
+    Request request = [&request_op, &arena, from_fd]() {
+      const TraceSpan span{"Parse", "fd", from_fd};
+      return Request{request_op.value(), arena.GetResource()};
+    }();
+    access.OnParsed(request);
     DynamicByteArray response_buf;
     if (!request.IsValid()) {
       auto response   = Response::Make400Response();
@@ -126,22 +850,78 @@ void ProcessHttpRequest(
         fmt::format("{}{}", serving_directory, request.GetResourceUrl());
 
       Log<LogLevel::kInfo>(resource_full_path);
-      if (IsCGIRequest(resource_full_path)) {
-        finished_handle =
-          HandleCGIRequest(request, resource_full_path, response_buf);
+      if (!metrics_path.empty() && request.GetResourceUrl() == metrics_path) {
+        finished_handle = HandleMetricsRequest(request, response_buf);
+      }
+      else if (!trace_path.empty() && request.GetResourceUrl() == trace_path) {
+        finished_handle = HandleTraceRequest(request, response_buf);
+      }
+      else if (request.GetResourceUrl().starts_with(kPluginRoute)) {
+        const auto should_finish = HandlePluginRequest(
+          std::move(request),
+          plugins,
+          plugin_pool,
+          client_connection,
+          access,
+          response_buf);
+        if (!should_finish.has_value()) {
+          // answered from the event loop, keep the responses in order
+          client_connection->Suspend();
+          return;
+        }
+        finished_handle = should_finish.value();
+      }
+      else if (IsCGIRequest(resource_full_path)) {
+        const auto dispatch = StartCGIRequest(
+          request,
+          resource_full_path,
+          cgi_workers,
+          cgi_limiter,
+          cgi_cache,
+          client_connection,
+          access,
+          response_buf);
+        if (dispatch == CGIDispatch::kStarted) {
+          // answered from the event loop, the requests after this one wait
+          // in the read buffer to keep responses in order
+          client_connection->Suspend();
+          return;
+        }
+        if (dispatch == CGIDispatch::kAnswered) {
+          finished_handle = request.ShouldClose();
+        }
+        else if (dispatch == CGIDispatch::kRejected) {
+          SerializeOverloadResponse(cgi_limiter.GetRetryAfter(), response_buf);
+          finished_handle = true;
+        }
+        else {
+          finished_handle =
+            HandleCGIRequest(request, resource_full_path, response_buf);
+        }
       }
       // normal http request - static resource request
       else {
-        finished_handle = HandleStaticResourceRequest(
+        const auto should_finish = HandleStaticResourceRequest(
           request,
           resource_full_path,
           cache,
+          file_pool,
+          client_connection,
+          access,
           response_buf);
+        if (!should_finish.has_value()) {
+          // answered from the event loop, keep the responses in order
+          client_connection->Suspend();
+          return;
+        }
+        finished_handle = should_finish.value();
       }
     }
     // send out the response
+    access.OnResponse(response_buf);
     client_connection->Write(std::move(response_buf));
     client_connection->Send();
+    access.Commit();
     if (finished_handle) {
       break;
     }
@@ -153,6 +933,43 @@ void ProcessHttpRequest(
     return;
   }
 }
+
+// "/cgi-bin/report=30", std::nullopt unless the ttl is a number of seconds
+auto ParseProgramTtl(std::string_view program_ttl)
+  -> std::optional<std::pair<std::string_view, std::chrono::seconds>> {
+  const auto equal = program_ttl.find('=');
+  if (equal == std::string_view::npos || equal == 0) {
+    return std::nullopt;
+  }
+  const auto ttl_str = program_ttl.substr(equal + 1);
+  uint32_t ttl{};
+  const auto [end, error] =
+    std::from_chars(ttl_str.data(), ttl_str.data() + ttl_str.size(), ttl);
+  if (
+    ttl_str.empty() || error != std::errc{} ||
+    end != ttl_str.data() + ttl_str.size()) {
+    return std::nullopt;
+  }
+  return std::make_pair(
+    program_ttl.substr(0, equal),
+    std::chrono::seconds(ttl));
+}
+
+auto ParseLogLevel(std::string_view name) -> std::optional<LogLevel> {
+  if (name == "info") {
+    return LogLevel::kInfo;
+  }
+  if (name == "warning") {
+    return LogLevel::kWarning;
+  }
+  if (name == "error") {
+    return LogLevel::kError;
+  }
+  if (name == "fatal") {
+    return LogLevel::kFatal;
+  }
+  return std::nullopt;
+}
 }    // namespace
 }    // namespace longlp::http
 
@@ -172,6 +989,113 @@ auto main(int argc, char* argv[]) -> int {
       "directory for resources, it should contains index.html",
       cxxopts::value<std::string>()
     )
+    (
+      "cgi-workers",
+      "persistent workers per cgi program, 0 to fork per request",
+      cxxopts::value<size_t>()->default_value("0")
+    )
+    (
+      "cgi-max-running",
+      "cgi programs running at once, further requests are queued",
+      cxxopts::value<size_t>()->default_value("64")
+    )
+    (
+      "cgi-max-running-per-program",
+      "instances of a single cgi program running at once",
+      cxxopts::value<size_t>()->default_value("16")
+    )
+    (
+      "cgi-max-queued",
+      "cgi requests waiting for a slot, further ones get 503",
+      cxxopts::value<size_t>()->default_value("128")
+    )
+    (
+      "cgi-cache-ttl",
+      "seconds a cgi output is cached for, 0 to disable the cgi cache",
+      cxxopts::value<uint32_t>()->default_value("0")
+    )
+    (
+      "cgi-cache-program-ttl",
+      "per program cgi cache ttl, e.g. /cgi-bin/report=30",
+      cxxopts::value<std::vector<std::string>>()
+    )
+    (
+      "cgi-max-requests",
+      "requests served by a persistent cgi worker before it is recycled",
+      cxxopts::value<size_t>()->default_value("1000")
+    )
+    (
+      "plugin-dir",
+      "directory of the native handler plugins served under /plugin/",
+      cxxopts::value<std::string>()
+    )
+    (
+      "plugin-threads",
+      "threads running the plugins which may block",
+      cxxopts::value<size_t>()->default_value("4")
+    )
+    (
+      "file-threads",
+      "threads reading the files missing from the cache, e.g. from a cold "
+      "disk, 0 to read them on the reactors",
+      cxxopts::value<size_t>()->default_value("0")
+    )
+    (
+      "metrics-path",
+      "url of the metrics in the Prometheus text format, empty to disable",
+      cxxopts::value<std::string>()->default_value("/metrics")
+    )
+    (
+      "trace-path",
+      "url of the recorded spans as Chrome trace JSON, e.g. /trace, not "
+      "served unless set",
+      cxxopts::value<std::string>()
+    )
+    (
+      "trace-sample-rate",
+      "fraction of the reactor iterations traced, 0 to disable tracing",
+      cxxopts::value<double>()->default_value("0")
+    )
+    (
+      "stall-threshold-ms",
+      "report the callbacks blocking a reactor for longer, 0 to disable",
+      cxxopts::value<uint32_t>()->default_value("100")
+    )
+    (
+      "log-level",
+      "minimum level logged: info, warning, error or fatal",
+      cxxopts::value<std::string>()->default_value("info")
+    )
+    (
+      "log-format",
+      "text, or binary to be read with log_decoder",
+      cxxopts::value<std::string>()->default_value("text")
+    )
+    (
+      "access-log",
+      "write every request to longlp_access_log_DD-MM-YYYY.N",
+      cxxopts::value<bool>()->default_value("false")
+    )
+    (
+      "log-dir",
+      "directory of the log files",
+      cxxopts::value<std::string>()->default_value(".")
+    )
+    (
+      "log-max-file-size",
+      "MiB written to a log file before a new one is started, 0 for no limit",
+      cxxopts::value<size_t>()->default_value("64")
+    )
+    (
+      "log-max-files",
+      "log files kept, the oldest are removed, 0 to keep all",
+      cxxopts::value<size_t>()->default_value("16")
+    )
+    (
+      "log-fsync",
+      "when log files are synced to disk: none, rotate or flush",
+      cxxopts::value<std::string>()->default_value("rotate")
+    )
     ("h,help", "Print usage")
   ;
   // clang-format on
@@ -193,6 +1117,32 @@ auto main(int argc, char* argv[]) -> int {
     port = result["port"].as<uint16_t>();
   }
 
+  const auto log_level = result["log-level"].as<std::string>();
+  if (const auto level = longlp::http::ParseLogLevel(log_level);
+      level.has_value()) {
+    longlp::Logger::SetMinLevel(*level);
+  }
+  else {
+    fmt::print("ignored log level {}\n", log_level);
+  }
+  if (result["log-format"].as<std::string>() == "binary") {
+    longlp::Logger::SetOutputFormat(longlp::Logger::OutputFormat::kBinary);
+  }
+  longlp::Logger::SetAccessLogEnabled(result["access-log"].as<bool>());
+  longlp::LogFile::Options log_file_options{};
+  log_file_options.directory     = result["log-dir"].as<std::string>();
+  log_file_options.max_files     = result["log-max-files"].as<size_t>();
+  log_file_options.max_file_size =
+    result["log-max-file-size"].as<size_t>() * 1024U * 1024U;
+  if (const auto log_fsync = result["log-fsync"].as<std::string>();
+      log_fsync == "none") {
+    log_file_options.fsync_policy = longlp::LogFile::FsyncPolicy::kNone;
+  }
+  else if (log_fsync == "flush") {
+    log_file_options.fsync_policy = longlp::LogFile::FsyncPolicy::kOnFlush;
+  }
+  longlp::Logger::GetInstance().SetFileOptions(std::move(log_file_options));
+
   std::string directory = result["directory"].as<std::string>();
   if (!longlp::http::IsDirectoryExists(directory)) {
     fmt::print("not found directory {}\n", directory);
@@ -206,12 +1156,134 @@ auto main(int argc, char* argv[]) -> int {
     directory,
     thread_num);
 
-  longlp::Server http_server(net_address, thread_num);
+  // persistent cgi workers, the programs should speak the frame protocol
+  std::unique_ptr<longlp::http::CGIWorkerPool> cgi_workers = nullptr;
+  if (const auto workers = result["cgi-workers"].as<size_t>(); workers > 0) {
+    longlp::http::CGIWorkerPool::Options cgi_options{};
+    cgi_options.max_workers  = workers;
+    cgi_options.max_requests = result["cgi-max-requests"].as<size_t>();
+    cgi_workers = std::make_unique<longlp::http::CGIWorkerPool>(cgi_options);
+  }
+
+  longlp::http::CGILimiter::Options limiter_options{};
+  limiter_options.max_running = result["cgi-max-running"].as<size_t>();
+  limiter_options.max_running_per_program =
+    result["cgi-max-running-per-program"].as<size_t>();
+  limiter_options.max_queued = result["cgi-max-queued"].as<size_t>();
+  longlp::http::CGILimiter cgi_limiter{limiter_options};
+
   auto cache =
     std::make_shared<longlp::Cache>(longlp::Cache::kDefaultCapacity * 10U);
+
+  // opt-in cache of the deterministic cgi programs output
+  longlp::http::CGICache::Options cgi_cache_options{};
+  cgi_cache_options.default_ttl =
+    std::chrono::seconds(result["cgi-cache-ttl"].as<uint32_t>());
+  if (result.count("cgi-cache-program-ttl") != 0U) {
+    for (const auto& program_ttl :
+         result["cgi-cache-program-ttl"].as<std::vector<std::string>>()) {
+      const auto parsed = longlp::http::ParseProgramTtl(program_ttl);
+      if (!parsed.has_value()) {
+        fmt::print(
+          "invalid --cgi-cache-program-ttl {}, expected "
+          "<program>=<seconds>\n{}\n",
+          program_ttl,
+          options.help());
+        return 1;
+      }
+      cgi_cache_options.program_ttls.emplace(
+        fmt::format("{}{}", directory, parsed->first),
+        parsed->second);
+    }
+  }
+  std::unique_ptr<longlp::http::CGICache> cgi_cache = nullptr;
+  if (
+    cgi_cache_options.default_ttl.count() > 0 ||
+    !cgi_cache_options.program_ttls.empty()) {
+    cgi_cache =
+      std::make_unique<longlp::http::CGICache>(cache, cgi_cache_options);
+  }
+
+  // in-process handlers, the blocking ones run off the reactors
+  longlp::http::PluginRegistry plugins;
+  std::unique_ptr<longlp::ThreadPool> plugin_pool = nullptr;
+  if (result.count("plugin-dir") != 0U) {
+    const auto plugin_dir = result["plugin-dir"].as<std::string>();
+    fmt::print(
+      "Loaded {} plugins from {}\n",
+      plugins.LoadDirectory(plugin_dir),
+      plugin_dir);
+  }
+  if (plugins.GetSize() > 0) {
+    plugin_pool = std::make_unique<longlp::ThreadPool>(
+      result["plugin-threads"].as<size_t>());
+  }
+
+  // cache misses are read off the reactors
+  std::unique_ptr<longlp::ThreadPool> file_pool = nullptr;
+  if (result["file-threads"].as<size_t>() > 0) {
+    file_pool = std::make_unique<longlp::ThreadPool>(
+      result["file-threads"].as<size_t>());
+  }
+
+  // exposed along the metrics of the server components
+  auto& metrics = longlp::MetricsRegistry::GetInstance();
+  metrics.AddCallback(
+    "longlp_cgi_running",
+    "Cgi programs running",
+    longlp::MetricsRegistry::Type::kGauge,
+    [&cgi_limiter] {
+      return static_cast<double>(cgi_limiter.GetStats().running);
+    });
+  metrics.AddCallback(
+    "longlp_cgi_queued",
+    "Cgi requests waiting for a slot",
+    longlp::MetricsRegistry::Type::kGauge,
+    [&cgi_limiter] {
+      return static_cast<double>(cgi_limiter.GetStats().queued);
+    });
+  metrics.AddCallback(
+    "longlp_cgi_rejected_total",
+    "Cgi requests rejected with 503",
+    longlp::MetricsRegistry::Type::kCounter,
+    [&cgi_limiter] {
+      return static_cast<double>(cgi_limiter.GetStats().rejected_total);
+    });
+  metrics.AddCallback(
+    "longlp_cgi_queue_wait_max_seconds",
+    "Longest time a queued cgi request waited for a slot",
+    longlp::MetricsRegistry::Type::kGauge,
+    [&cgi_limiter] {
+      return std::chrono::duration<double>(cgi_limiter.GetStats().wait_max)
+        .count();
+    });
+  const auto metrics_path = result["metrics-path"].as<std::string>();
+
+  // spans dumped on SIGUSR2 as well, e.g. when the endpoint is unreachable
+  const auto trace_path = result.count("trace-path") != 0U
+                          ? result["trace-path"].as<std::string>()
+                          : std::string{};
+  longlp::Tracer::GetInstance().SetSampleRate(
+    result["trace-sample-rate"].as<double>());
+  longlp::http::DumpTraceOnSignal(result["log-dir"].as<std::string>());
+  longlp::StallDetector::GetInstance().SetThreshold(
+    longlp::milliseconds{result["stall-threshold-ms"].as<uint32_t>()});
+
+  longlp::Server http_server(net_address, thread_num);
   http_server
     .OnHandle([&](longlp::Connection* client_connection) {
-      longlp::http::ProcessHttpRequest(directory, cache, client_connection);
+      longlp::http::ProcessHttpRequest(
+        directory,
+        metrics_path,
+        trace_path,
+        cache,
+        cgi_workers.get(),
+        cgi_limiter,
+        cgi_cache.get(),
+        plugins,
+        plugin_pool.get(),
+        file_pool.get(),
+        client_connection);
     })
     .Begin();
   return 0;
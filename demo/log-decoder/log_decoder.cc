@@ -0,0 +1,60 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <fmt/format.h>
+#include <cxxopts.hpp>
+
+#include "log/binary_log.h"
+
+// Turn a binary log file written with Logger::OutputFormat::kBinary back into
+// the text log, or into JSON lines
+auto main(int argc, char* argv[]) -> int {
+  cxxopts::Options options("longlp-log-decoder", "Decode a binary log file");
+
+  // clang-format off
+  options.add_options()
+    ("file", "binary log file", cxxopts::value<std::string>())
+    ("json", "print one JSON object per log")
+    ("h,help", "Print usage")
+  ;
+  // clang-format on
+  options.parse_positional({"file"});
+
+  auto result = options.parse(argc, argv);
+  if (result.count("help") != 0U || result.count("file") == 0U) {
+    fmt::print("{}\n", options.help());
+    return result.count("help") != 0U ? 0 : 1;
+  }
+
+  const auto file_path = result["file"].as<std::string>();
+  std::ifstream file(file_path, std::ios::binary);
+  if (!file.is_open()) {
+    fmt::print(stderr, "cannot open {}\n", file_path);
+    return 1;
+  }
+
+  longlp::binary_log::Decoder decoder{file};
+  if (!decoder.IsValid()) {
+    fmt::print(stderr, "{} is not a binary log\n", file_path);
+    return 1;
+  }
+
+  const bool json = result.count("json") != 0U;
+  for (auto record = decoder.Next(); record.has_value();
+       record      = decoder.Next()) {
+    std::cout << (json ? longlp::binary_log::ToJson(*record)
+                       : longlp::binary_log::ToText(*record))
+              << '\n';
+  }
+  // a truncated record is expected at the end of the file of a running server
+  if (!file.eof()) {
+    fmt::print(stderr, "{}: stopped at a corrupted record\n", file_path);
+    return 1;
+  }
+  return 0;
+}
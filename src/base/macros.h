@@ -25,4 +25,13 @@
   DISALLOW_COPY(class_name);               \
   DISALLOW_MOVE(class_name)
 
+// Around coroutine definitions, GCC reports false positives on the code it
+// generates for them
+#define BEGIN_SUPPRESS_COROUTINE_WARNINGS                                 \
+  _Pragma("GCC diagnostic push")                                          \
+    _Pragma("GCC diagnostic ignored \"-Wzero-as-null-pointer-constant\"") \
+      _Pragma("GCC diagnostic ignored \"-Wswitch-default\"")
+
+#define END_SUPPRESS_COROUTINE_WARNINGS _Pragma("GCC diagnostic pop")
+
 #endif    // SRC_BASE_MACROS_H_
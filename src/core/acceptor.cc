@@ -11,6 +11,7 @@
 #include "core/connection.h"
 #include "core/distribution_agent.h"
 #include "core/looper.h"
+#include "core/metrics.h"
 #include "core/net_address.h"
 #include "core/poller.h"
 #include "core/socket.h"
@@ -18,6 +19,22 @@
 
 namespace longlp {
 
+namespace {
+auto GetAcceptedCounter() -> Counter& {
+  static Counter& accepted = MetricsRegistry::GetInstance().GetCounter(
+    "longlp_acceptor_accepted_total",
+    "Client connections accepted");
+  return accepted;
+}
+
+auto GetAcceptErrorCounter() -> Counter& {
+  static Counter& errors = MetricsRegistry::GetInstance().GetCounter(
+    "longlp_acceptor_errors_total",
+    "accept() calls which failed");
+  return errors;
+}
+}    // namespace
+
 Acceptor::Acceptor(
   not_null<Looper*> listener,
   not_null<DistributionAgent*> agent,
@@ -47,23 +64,27 @@ void Acceptor::SetOnAccept(ConnectionCallback on_accept_callback) {
     const auto accept_fd =
       connection->GetSocket()->AcceptClientAddress(client_address);
     if (accept_fd == -1) {
+      GetAcceptErrorCounter().Increment();
       return;
     }
-    auto client_socket = std::make_unique<Socket>(accept_fd);
-    client_socket->SetNonBlocking();
-    auto client_connection =
-      std::make_unique<Connection>(std::move(client_socket));
+    GetAcceptedCounter().Increment();
+    auto [looper, idx] = agent_->SelectCandidate();
+
+    auto client_connection = looper->AcquireConnection(accept_fd);
+    client_connection->GetSocket()->SetNonBlocking();
+    client_connection->SetPeerAddress(client_address);
     client_connection
       ->SetEvents(Poller::Event::kRead | Poller::Event::kET);    // edge-trigger
                                                                  // for client
-    client_connection->SetCallback(on_handle_cb_);
-
-    auto [looper, idx] = agent_->SelectCandidate();
+    // shared by the connections of the reactor, nothing is copied
+    client_connection->SetHandler(
+      on_handle_,
+      handlers_.size() == 1 ? handlers_.front() : handlers_.at(idx));
 
-    Log<LogLevel::kInfo>(fmt::format(
-      "new client fd={client} maps to reactor={reactor}",
-      fmt::arg("client", client_connection->GetFd()),
-      fmt::arg("reactor", idx)));
+    Log<LogLevel::kInfo>(
+      "new client fd={} maps to reactor={}",
+      client_connection->GetFd(),
+      idx);
 
     client_connection->SetLooper(looper);
     looper->AddConnection(std::move(client_connection));
@@ -73,6 +94,14 @@ void Acceptor::SetOnAccept(ConnectionCallback on_accept_callback) {
 
 void Acceptor::SetOnHandle(ConnectionCallback on_handle_callback) {
   on_handle_cb_ = std::move(on_handle_callback);
+  SetOnHandle(&InvokeHandler<ConnectionCallback>, {&on_handle_cb_});
+}
+
+void Acceptor::SetOnHandle(
+  ConnectionHandlerFn invoke,
+  std::vector<void*> handlers) {
+  on_handle_ = invoke;
+  handlers_  = std::move(handlers);
 }
 
 auto Acceptor::GetAcceptorConnection() noexcept -> Connection* {
@@ -7,6 +7,7 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "base/macros.h"
 #include "base/pointers.h"
@@ -37,8 +38,13 @@ class Acceptor {
 
   void SetOnAccept(ConnectionCallback on_accept_callback);
 
+  // type-erased, one callback called for the connections of every reactor
   void SetOnHandle(ConnectionCallback on_handle_callback);
 
+  // |handlers|[i] is called for the connections of reactor i through
+  // |invoke|, without type erasure. The handlers must outlive the acceptor
+  void SetOnHandle(ConnectionHandlerFn invoke, std::vector<void*> handlers);
+
   [[nodiscard]] auto GetAcceptorConnection() noexcept -> Connection*;
 
  private:
@@ -46,6 +52,8 @@ class Acceptor {
   not_null<DistributionAgent*> agent_;
   ConnectionCallback on_accept_cb_{};
   ConnectionCallback on_handle_cb_{};
+  ConnectionHandlerFn on_handle_{nullptr};
+  std::vector<void*> handlers_;
 };
 
 }    // namespace longlp
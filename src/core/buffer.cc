@@ -16,6 +16,15 @@ Buffer::Buffer(size_t initial_capacity) {
 
 Buffer::~Buffer() = default;
 
+void Buffer::Reset(size_t max_capacity) {
+  if (buf_.capacity() <= max_capacity) {
+    buf_.clear();
+    return;
+  }
+  DynamicByteArray{}.swap(buf_);
+  buf_.reserve(kDefaultCapacity);
+}
+
 void Buffer::PushBackUnsafe(const Byte* data, size_t size) {
   buf_.insert(buf_.end(), data, data + size);
 }
@@ -46,6 +55,15 @@ void Buffer::PushFront(const std::string& str) {
   PushFrontUnsafe(bit_cast<const Byte*>(str.c_str()), str.size());
 }
 
+void Buffer::PopFront(size_t size) {
+  buf_.erase(
+    buf_.begin(),
+    std::next(
+      buf_.begin(),
+      narrow_cast<decltype(buf_)::difference_type>(
+        std::min(size, buf_.size()))));
+}
+
 auto Buffer::FindAndPopTill(const std::string& target)
   -> std::optional<std::string> {
   std::optional<std::string> res = std::nullopt;
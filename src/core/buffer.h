@@ -54,6 +54,12 @@ class Buffer {
 
   void Clear() noexcept { buf_.clear(); }
 
+  // drop the first |size| bytes, all of them if there are fewer
+  void PopFront(size_t size);
+
+  // Clear, and give the memory back if the capacity grew over |max_capacity|
+  void Reset(size_t max_capacity);
+
   [[nodiscard]] auto ToStringView() const noexcept -> std::string_view;
 
  private:
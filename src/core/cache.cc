@@ -8,9 +8,31 @@
 #include <utility>
 
 #include "base/chrono.h"
+#include "core/metrics.h"
+#include "core/trace.h"
 
 namespace longlp {
 
+namespace {
+// shared by every cache of the process
+struct CacheMetrics {
+  Counter& hits;
+  Counter& misses;
+  Gauge& occupancy;
+};
+
+auto GetCacheMetrics() -> CacheMetrics& {
+  auto& registry = MetricsRegistry::GetInstance();
+  static CacheMetrics metrics{
+    registry.GetCounter("longlp_cache_hits_total", "Cache lookups found"),
+    registry.GetCounter(
+      "longlp_cache_misses_total",
+      "Cache lookups not found or expired"),
+    registry.GetGauge("longlp_cache_occupancy_bytes", "Bytes held in caches")};
+  return metrics;
+}
+}    // namespace
+
 // Helper class inside the Cache
 // It represents a single file cached in the form of an Byte vector
 // and serves as a node in the doubly-linked list data structure
@@ -18,10 +40,18 @@ class Cache::CacheNode {
  public:
   CacheNode() noexcept { UpdateTimestamp(); }
 
-  CacheNode(std::string identifier, const DynamicByteArray& data) :
+  CacheNode(
+    std::string identifier,
+    const DynamicByteArray& data,
+    milliseconds time_to_live,
+    std::string_view validator) :
     identifier_(std::move(identifier)),
+    validator_(validator),
     data_(data) {
     UpdateTimestamp();
+    if (time_to_live != kNeverExpire) {
+      expire_at_ = last_access_ + time_to_live.count();
+    }
   }
 
   void Serialize(DynamicByteArray& destination) {
@@ -39,15 +69,28 @@ class Cache::CacheNode {
 
   void UpdateTimestamp() noexcept { last_access_ = GetCurrentTimeMs().count(); }
 
+  [[nodiscard]] auto IsExpired() const noexcept -> bool {
+    return expire_at_ != 0 && GetCurrentTimeMs().count() >= expire_at_;
+  }
+
+  [[nodiscard]] auto IsStale(std::string_view validator) const noexcept
+    -> bool {
+    return IsExpired() || (!validator.empty() && validator != validator_);
+  }
+
  private:
   friend class Cache;
 
   // the resource identifier for this node
   std::string identifier_;
+  // the version of the resource, empty if not given
+  std::string validator_;
   // may contain binary data
   DynamicByteArray data_;
   // the timestamp of last access in milliseconds
   int64_t last_access_{0};
+  // the expiration timestamp in milliseconds, 0 if never
+  int64_t expire_at_{0};
   CacheNode* prev_{nullptr};
   CacheNode* next_{nullptr};
 };
@@ -60,15 +103,25 @@ Cache::Cache(size_t capacity) noexcept :
   tail_->prev_ = head_.get();
 }
 
-Cache::~Cache() = default;
+Cache::~Cache() {
+  GetCacheMetrics().occupancy.Sub(static_cast<int64_t>(occupancy_));
+}
 
 auto Cache::TryLoad(
   const std::string& resource_url,
-  DynamicByteArray& destination) -> bool {
-  // TODO(longlp): Try to use unique
-  std::shared_lock<std::shared_mutex> lock(mtx_);
+  DynamicByteArray& destination,
+  std::string_view validator) -> bool {
+  const TraceSpan span{"CacheLookup"};
+  // exclusive, a hit reorders the list and a stale entry is evicted
+  std::unique_lock<std::shared_mutex> lock(mtx_);
   auto iter = mapping_.find(resource_url);
+  if (iter != mapping_.end() && iter->second->IsStale(validator)) {
+    Evict(iter);
+    GetCacheMetrics().misses.Increment();
+    return false;
+  }
   if (iter != mapping_.end()) {
+    GetCacheMetrics().hits.Increment();
     iter->second->Serialize(destination);
     // move this node to the tailer as most recently accessed
     iter->second->Detach();
@@ -76,18 +129,23 @@ auto Cache::TryLoad(
     iter->second->UpdateTimestamp();
     return true;
   }
+  GetCacheMetrics().misses.Increment();
   return false;
 }
 
 auto Cache::TryInsert(
   const std::string& resource_url,
-  const DynamicByteArray& source) -> bool {
-  // TODO(longlp): Try to use unique
+  const DynamicByteArray& source,
+  milliseconds time_to_live,
+  std::string_view validator) -> bool {
   std::unique_lock<std::shared_mutex> lock(mtx_);
 
   // already exists
-  if (mapping_.contains(resource_url)) {
-    return false;
+  if (auto iter = mapping_.find(resource_url); iter != mapping_.end()) {
+    if (!iter->second->IsStale(validator)) {
+      return false;
+    }
+    Evict(iter);
   }
 
   // single resource's size exceeds the capacity
@@ -97,19 +155,21 @@ auto Cache::TryInsert(
 
   // try to eliminate older resources to add new one
   while (!mapping_.empty() && (capacity_ - occupancy_) < source.size()) {
-    auto* first_node   = head_->next_;
-    auto resource_size = first_node->data_.size();
-    auto iter          = mapping_.find(first_node->identifier_);
+    auto* first_node = head_->next_;
+    auto iter        = mapping_.find(first_node->identifier_);
     // it should be in the map
     assert(iter != mapping_.end());
-    iter->second->Detach();
-    mapping_.erase(iter);
-    occupancy_ -= resource_size;
+    Evict(iter);
   }
 
-  auto node = std::make_shared<CacheNode>(resource_url, source);
+  auto node = std::make_shared<CacheNode>(
+    resource_url,
+    source,
+    time_to_live,
+    validator);
   AppendToListTail(node);
   occupancy_ += source.size();
+  GetCacheMetrics().occupancy.Add(static_cast<int64_t>(source.size()));
   mapping_.emplace(resource_url, node);
   return true;
 }
@@ -118,9 +178,19 @@ void Cache::Clear() {
   head_->next_ = tail_.get();
   tail_->prev_ = head_.get();
   mapping_.clear();
+  GetCacheMetrics().occupancy.Sub(static_cast<int64_t>(occupancy_));
   occupancy_ = 0;
 }
 
+void Cache::Evict(
+  std::unordered_map<std::string, std::shared_ptr<CacheNode>>::iterator iter) {
+  occupancy_ -= iter->second->data_.size();
+  GetCacheMetrics().occupancy.Sub(
+    static_cast<int64_t>(iter->second->data_.size()));
+  iter->second->Detach();
+  mapping_.erase(iter);
+}
+
 void Cache::AppendToListTail(const std::shared_ptr<CacheNode>& node) noexcept {
   auto* node_ptr   = node.get();
   auto* node_prev  = tail_->prev_;
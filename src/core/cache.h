@@ -9,9 +9,11 @@
 #include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "base/chrono.h"
 #include "base/macros.h"
 #include "core/typedefs.h"
 
@@ -23,10 +25,14 @@ namespace longlp {
 // seek, insert, update nodes that are closer to the header are to be victims to
 // be evicted next time, i.e with older timestamp nodes newly-added or accessed
 // are closer to the tail, i.e. with newer timestamp
+// An entry may also be given a time to live, it is dropped on the first lookup
+// after it has expired, and a validator, e.g. the ETag of the file it holds,
+// it is dropped on the first lookup expecting another one
 class Cache {
  public:
   // default cache size 10 MB
   static constexpr size_t kDefaultCapacity = 10'485'760U;
+  static constexpr milliseconds kNeverExpire{0};
 
   explicit Cache(size_t capacity) noexcept;
   DISALLOW_COPY_AND_MOVE(Cache);
@@ -40,13 +46,19 @@ class Cache {
     return capacity_;
   }
 
-  [[nodiscard]] auto
-  TryLoad(const std::string& resource_url, DynamicByteArray& destination)
-    -> bool;
+  // an empty |validator| accepts the entry whatever its validator
+  [[nodiscard]] auto TryLoad(
+    const std::string& resource_url,
+    DynamicByteArray& destination,
+    std::string_view validator = {}) -> bool;
 
-  [[nodiscard]] auto
-  TryInsert(const std::string& resource_url, const DynamicByteArray& source)
-    -> bool;
+  // an existing entry is only replaced if it has expired or has another
+  // validator
+  [[nodiscard]] auto TryInsert(
+    const std::string& resource_url,
+    const DynamicByteArray& source,
+    milliseconds time_to_live = kNeverExpire,
+    std::string_view validator = {}) -> bool;
 
   void Clear();
 
@@ -55,6 +67,9 @@ class Cache {
 
   void AppendToListTail(const std::shared_ptr<CacheNode>& node) noexcept;
 
+  void Evict(
+    std::unordered_map<std::string, std::shared_ptr<CacheNode>>::iterator iter);
+
   // concurrency
   std::shared_mutex mtx_;
 
@@ -5,6 +5,7 @@
 #include "core/connection.h"
 
 #include <sys/socket.h>
+#include <unistd.h>
 #include <array>
 #include <cstring>
 
@@ -12,28 +13,34 @@
 
 #include "base/utils.h"
 #include "core/buffer.h"
+#include "core/looper.h"
+#include "core/poller.h"
 #include "core/socket.h"
+#include "core/trace.h"
 #include "log/logger.h"
 
 namespace {
 constexpr auto kBufferSize = 2048U;
+// what wakes up a coroutine waiting to write, errors included
+constexpr uint32_t kWritableEvents = EPOLLOUT | EPOLLERR | EPOLLHUP;
 }    // namespace
 
 namespace longlp {
 
 Connection::Connection(std::unique_ptr<Socket> socket) :
-  socket_(std::move(socket)),
+  socket_(std::move(*socket)),
   read_buffer_(std::make_unique<Buffer>()),
-  write_buffer_(std::make_unique<Buffer>()) {}
+  write_buffer_(std::make_unique<Buffer>()),
+  lifetime_(std::make_shared<bool>(true)) {}
 
 Connection::~Connection() = default;
 
 auto Connection::GetFd() const noexcept -> int {
-  return socket_->GetFd();
+  return socket_.GetFd();
 }
 
 auto Connection::GetSocket() noexcept -> Socket* {
-  return socket_.get();
+  return &socket_;
 }
 
 auto Connection::FindAndPopTill(const std::string& target)
@@ -49,6 +56,14 @@ auto Connection::GetWriteSize() const noexcept -> size_t {
   return write_buffer_->Size();
 }
 
+auto Connection::GetReadCapacity() const noexcept -> size_t {
+  return read_buffer_->Capacity();
+}
+
+auto Connection::GetWriteCapacity() const noexcept -> size_t {
+  return write_buffer_->Capacity();
+}
+
 void Connection::ReadUnsafe(const Byte* buf, size_t size) {
   read_buffer_->PushBackUnsafe(buf, size);
 }
@@ -79,13 +94,15 @@ auto Connection::ReadDataAsString() const noexcept -> std::string {
 }
 
 auto Connection::Receive() -> std::pair<ssize_t, bool> {
+  const TraceSpan span{"Receive", "fd", GetFd()};
   // read all available bytes, since Edge-trigger
   ssize_t read = 0;
   FixedByteArray<kBufferSize + 1> buf{};
   buf.fill(0);
 
   while (true) {
-    ssize_t curr_read = recv(GetFd(), buf.data(), kBufferSize, 0);
+    // read() rather than recv(), the descriptor may be a pipe
+    ssize_t curr_read = ::read(GetFd(), buf.data(), kBufferSize);
     if (curr_read > 0) {
       read += curr_read;
       ReadUnsafe(buf.data(), narrow_cast<size_t>(curr_read));
@@ -110,22 +127,23 @@ auto Connection::Receive() -> std::pair<ssize_t, bool> {
       break;
     }
 
-    Log<LogLevel::kError>(
-      fmt::format("HandleConnection: Receive() error code {}", errno));
+    Log<LogLevel::kError>("HandleConnection: Receive() error code {}", errno);
     return {read, true};
   }
   return {read, false};
 }
 
 void Connection::Send() {
+  const TraceSpan span{"Send", "fd", GetFd()};
   const auto to_write = narrow_cast<ssize_t>(GetWriteSize());
   const Byte* buf     = write_buffer_->Data();
   for (ssize_t curr_write = 0; curr_write < to_write;) {
+    // MSG_NOSIGNAL, a peer gone in the meantime must not SIGPIPE the server
     auto write = send(
       GetFd(),
       buf + curr_write,
       narrow_cast<size_t>(to_write - curr_write),
-      0);
+      MSG_NOSIGNAL);
     if (write <= 0) {
       if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
         Log<LogLevel::kError>("Error in Connection::Send()");
@@ -139,6 +157,94 @@ void Connection::Send() {
   ClearWriteBuffer();
 }
 
+auto Connection::ReadAwaiter::await_ready() -> bool {
+  result_ = connection_.Receive();
+  return result_.first > 0 || result_.second;
+}
+
+void Connection::ReadAwaiter::await_suspend(
+  std::coroutine_handle<> handle) noexcept {
+  handle_        = handle;
+  saved_invoke_  = connection_.invoke_;
+  saved_handler_ = connection_.handler_;
+  connection_.SetHandler(&OnReadable, this);
+}
+
+// static
+void Connection::ReadAwaiter::OnReadable(
+  void* awaiter,
+  not_null<Connection*> connection) {
+  auto& self   = *static_cast<ReadAwaiter*>(awaiter);
+  self.result_ = connection->Receive();
+  if (self.result_.first == 0 && !self.result_.second) {
+    return;
+  }
+  connection->SetHandler(self.saved_invoke_, self.saved_handler_);
+  // the awaiter is gone with the frame once resumed
+  self.handle_.resume();
+}
+
+void Connection::WriteAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  handle_        = handle;
+  saved_invoke_  = connection_.invoke_;
+  saved_handler_ = connection_.handler_;
+  connection_.SetHandler(&OnWritable, this);
+  connection_.SetEvents(connection_.GetEvents() | Poller::Event::kWrite);
+  connection_.GetLooper()->ModifyConnection(&connection_);
+}
+
+// static
+void Connection::WriteAwaiter::OnWritable(
+  void* awaiter,
+  not_null<Connection*> connection) {
+  auto& self = *static_cast<WriteAwaiter*>(awaiter);
+  // woken up by the bytes of the peer, left in the socket for the next read
+  if ((connection->GetRevents() & kWritableEvents) == 0U) {
+    return;
+  }
+  if (!self.Flush()) {
+    return;
+  }
+  connection->SetEvents(
+    connection->GetEvents() & ~static_cast<uint32_t>(Poller::Event::kWrite));
+  connection->GetLooper()->ModifyConnection(connection);
+  connection->SetHandler(self.saved_invoke_, self.saved_handler_);
+  self.handle_.resume();
+}
+
+auto Connection::WriteAwaiter::Flush() -> bool {
+  const TraceSpan span{"Send", "fd", connection_.GetFd()};
+  auto& buffer = *connection_.write_buffer_;
+  while (written_ < buffer.Size()) {
+    const auto write = send(
+      connection_.GetFd(),
+      buffer.Data() + written_,
+      buffer.Size() - written_,
+      MSG_NOSIGNAL);
+    if (write > 0) {
+      written_ += narrow_cast<size_t>(write);
+      continue;
+    }
+    if (write == -1 && errno == EINTR) {
+      continue;
+    }
+    if (write == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return false;
+    }
+    Log<LogLevel::kError>("Error in Connection::WriteAwaiter::Flush()");
+    sent_ = false;
+    break;
+  }
+  buffer.Clear();
+  written_ = 0;
+  return true;
+}
+
+auto Connection::AsyncWrite(DynamicByteArray&& bytes) -> WriteAwaiter {
+  Write(std::move(bytes));
+  return WriteAwaiter{*this};
+}
+
 void Connection::ClearReadBuffer() noexcept {
   read_buffer_->Clear();
 }
@@ -147,8 +253,52 @@ void Connection::ClearWriteBuffer() noexcept {
   write_buffer_->Clear();
 }
 
+void Connection::SetCallback(const ConnectionCallback& callback) {
+  if (callback_ == nullptr) {
+    callback_ = std::make_unique<ConnectionCallback>(callback);
+  }
+  else {
+    *callback_ = callback;
+  }
+  SetHandler(callback_.get());
+}
+
 void Connection::Start() {
-  callback_(this);
+  if (suspended_) {
+    return;
+  }
+  invoke_(handler_, this);
+}
+
+void Connection::Resume() {
+  suspended_ = false;
+  invoke_(handler_, this);
+}
+
+void Connection::Recycle(size_t max_buffer_capacity) {
+  {
+    // closed once, here, the move assignment would hand the fd back
+    const Socket closed{std::move(socket_)};
+  }
+  invoke_  = nullptr;
+  handler_ = nullptr;
+  if (callback_ != nullptr) {
+    *callback_ = nullptr;
+  }
+  read_buffer_->Reset(max_buffer_capacity);
+  write_buffer_->Reset(max_buffer_capacity);
+  lifetime_.reset();
+}
+
+void Connection::Reuse(int fd) {
+  // |socket_| is empty since Recycle()
+  socket_       = Socket{fd};
+  events_       = 0;
+  revents_      = 0;
+  suspended_    = false;
+  owner_looper_ = nullptr;
+  lifetime_     = std::make_shared<bool>(true);
+  peer_address_ = NetAddress{};
 }
 
 }    // namespace longlp
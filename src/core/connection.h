@@ -5,6 +5,7 @@
 #ifndef SRC_CORE_CONNECTION_H_
 #define SRC_CORE_CONNECTION_H_
 
+#include <coroutine>
 #include <memory>
 #include <optional>
 #include <string>
@@ -12,19 +13,21 @@
 #include <vector>
 
 #include "base/macros.h"
+#include "core/net_address.h"
+#include "core/socket.h"
 #include "core/typedefs.h"
 
 namespace longlp {
 
 class Looper;
 class Buffer;
-class Socket;
 
 // This Connection class encapsulates a TCP client connection
 // It could be set a custom callback function when new messages arrive and it
 // contains information about the monitoring events and return events so that
-// Poller could manipulate and epoll based on this Connection class
-class Connection {
+// Poller could manipulate and epoll based on this Connection class.
+// What an event touches fits in its first cache line
+class alignas(64) Connection {
  public:
   explicit Connection(std::unique_ptr<Socket> socket);
   ~Connection();
@@ -36,6 +39,15 @@ class Connection {
 
   [[nodiscard]] auto GetSocket() noexcept -> Socket*;
 
+  // the remote end, set by the Acceptor for client connections
+  void SetPeerAddress(const NetAddress& peer_address) {
+    peer_address_ = peer_address;
+  }
+
+  [[nodiscard]] auto GetPeerAddress() const noexcept -> const NetAddress& {
+    return peer_address_;
+  }
+
   // for Poller
 
   void SetEvents(uint32_t events) { events_ = events; }
@@ -48,15 +60,120 @@ class Connection {
     return revents_;
   }
 
-  void SetCallback(const ConnectionCallback& callback) { callback_ = callback; }
+  // type-erased, |callback| is copied into the connection
+  void SetCallback(const ConnectionCallback& callback);
+
+  // |invoke|(|handler|, this) on every event, nothing is copied and
+  // |handler| must outlive the connection
+  void SetHandler(ConnectionHandlerFn invoke, void* handler) noexcept {
+    invoke_  = invoke;
+    handler_ = handler;
+  }
+
+  template <typename Handler>
+  void SetHandler(Handler* handler) noexcept {
+    SetHandler(&InvokeHandler<Handler>, handler);
+  }
 
   void Start();
 
+  // A suspended connection does not run its callback on new events, it is
+  // used while a response is produced asynchronously so that pipelined
+  // requests are answered in order. Resume() runs the callback once to catch
+  // up with what arrived in the meantime
+  void Suspend() noexcept { suspended_ = true; }
+
+  void Resume();
+
+  [[nodiscard]] auto IsSuspended() const noexcept -> bool {
+    return suspended_;
+  }
+
+  // Token expiring as soon as the connection is deleted from its Looper, so
+  // asynchronous work finishing later can tell whether it is still there
+  [[nodiscard]] auto GetLifetime() const noexcept -> std::weak_ptr<void> {
+    return lifetime_;
+  }
+
+  void Expire() noexcept { lifetime_.reset(); }
+
+  [[nodiscard]] auto IsExpired() const noexcept -> bool {
+    return lifetime_ == nullptr;
+  }
+
+  // for coroutines, see core/task.h. The connection must be watched by a
+  // Looper and stay there while a coroutine waits on it, its handler is taken
+  // over in the meantime and given back before the coroutine resumes
+
+  // Resumes with what Receive() returned once bytes were appended to the
+  // read buffer or the peer is gone
+  class ReadAwaiter {
+   public:
+    explicit ReadAwaiter(Connection& connection) noexcept :
+      connection_(connection) {}
+
+    // the bytes available right away do not suspend
+    [[nodiscard]] auto await_ready() -> bool;
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept;
+
+    [[nodiscard]] auto await_resume() const noexcept
+      -> std::pair<ssize_t, bool> {
+      return result_;
+    }
+
+   private:
+    static void OnReadable(void* awaiter, not_null<Connection*> connection);
+
+    Connection& connection_;
+    std::coroutine_handle<> handle_{};
+    ConnectionHandlerFn saved_invoke_{nullptr};
+    void* saved_handler_{nullptr};
+    std::pair<ssize_t, bool> result_{0, false};
+  };
+
+  // Resumes once the write buffer is sent, with false if the peer is gone.
+  // Unlike Send() it waits for the socket to drain rather than spinning
+  class WriteAwaiter {
+   public:
+    explicit WriteAwaiter(Connection& connection) noexcept :
+      connection_(connection) {}
+
+    [[nodiscard]] auto await_ready() -> bool { return Flush(); }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    [[nodiscard]] auto await_resume() const noexcept -> bool { return sent_; }
+
+   private:
+    static void OnWritable(void* awaiter, not_null<Connection*> connection);
+
+    // send what the socket takes, true once there is nothing left to try
+    auto Flush() -> bool;
+
+    Connection& connection_;
+    std::coroutine_handle<> handle_{};
+    ConnectionHandlerFn saved_invoke_{nullptr};
+    void* saved_handler_{nullptr};
+    // bytes of the write buffer already sent, it is only cleared once done
+    size_t written_{0};
+    bool sent_{true};
+  };
+
+  [[nodiscard]] auto AsyncRead() noexcept -> ReadAwaiter {
+    return ReadAwaiter{*this};
+  }
+
+  // |bytes| go after what the write buffer already holds
+  [[nodiscard]] auto AsyncWrite(DynamicByteArray&& bytes) -> WriteAwaiter;
+
   // for Buffer
   [[nodiscard]] auto
   FindAndPopTill(const std::string& target) -> std::optional<std::string>;
   [[nodiscard]] auto GetReadSize() const noexcept -> size_t;
   [[nodiscard]] auto GetWriteSize() const noexcept -> size_t;
+  [[nodiscard]] auto GetReadCapacity() const noexcept -> size_t;
+  [[nodiscard]] auto GetWriteCapacity() const noexcept -> size_t;
   void ReadUnsafe(const Byte* buf, size_t size);
   void WriteUnsafe(const Byte* buf, size_t size);
   void Read(const std::string& str);
@@ -76,14 +193,32 @@ class Connection {
 
   [[nodiscard]] auto GetLooper() noexcept -> Looper* { return owner_looper_; }
 
+  // for ConnectionPool
+
+  // Close the socket, drop the callback and the buffered bytes. A buffer
+  // keeps its memory for the next connection unless it grew over
+  // |max_buffer_capacity|
+  void Recycle(size_t max_buffer_capacity);
+
+  // a new connection of |fd|, once recycled
+  void Reuse(int fd);
+
  private:
-  Looper* owner_looper_{nullptr};
-  std::unique_ptr<Socket> socket_;
-  std::unique_ptr<Buffer> read_buffer_;
-  std::unique_ptr<Buffer> write_buffer_;
+  // hot, read on every event
+  Socket socket_;
   uint32_t events_{0};
   uint32_t revents_{0};
-  ConnectionCallback callback_{};
+  bool suspended_{false};
+  std::unique_ptr<Buffer> read_buffer_;
+  std::unique_ptr<Buffer> write_buffer_;
+  ConnectionHandlerFn invoke_{nullptr};
+  void* handler_{nullptr};
+  // cold
+  // what SetCallback() copied, kept for the next one once recycled
+  std::unique_ptr<ConnectionCallback> callback_;
+  Looper* owner_looper_{nullptr};
+  std::shared_ptr<void> lifetime_;
+  NetAddress peer_address_;
 };
 
 }    // namespace longlp
@@ -0,0 +1,49 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/connection_pool.h"
+
+#include <utility>
+
+#include "core/connection.h"
+#include "core/socket.h"
+
+namespace longlp {
+
+ConnectionPool::ConnectionPool(size_t max_idle) :
+  max_idle_(max_idle) {}
+
+ConnectionPool::~ConnectionPool() = default;
+
+auto ConnectionPool::Acquire(int fd) -> std::unique_ptr<Connection> {
+  std::unique_ptr<Connection> connection = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!idle_.empty()) {
+      connection = std::move(idle_.back());
+      idle_.pop_back();
+    }
+  }
+  if (connection == nullptr) {
+    return std::make_unique<Connection>(std::make_unique<Socket>(fd));
+  }
+  connection->Reuse(fd);
+  return connection;
+}
+
+void ConnectionPool::Release(std::unique_ptr<Connection> connection) {
+  // out of the lock, the callback may own anything
+  connection->Recycle(kMaxIdleBufferCapacity);
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (idle_.size() < max_idle_) {
+    idle_.push_back(std::move(connection));
+  }
+}
+
+auto ConnectionPool::GetIdleCount() const -> size_t {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return idle_.size();
+}
+
+}    // namespace longlp
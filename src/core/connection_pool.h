@@ -0,0 +1,53 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_CORE_CONNECTION_POOL_H_
+#define SRC_CORE_CONNECTION_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace longlp {
+
+class Connection;
+
+// Keeps the connections of a reactor once closed, with their buffers, to be
+// handed out again to the next accepted clients, so that short-lived
+// connections do not go through malloc. Thread-safe, connections are
+// acquired by the acceptor thread and released by the reactor
+class ConnectionPool {
+ public:
+  // at most 2 MiB of idle buffers per reactor
+  static constexpr size_t kDefaultMaxIdle = 256;
+  // a buffer which grew over it shrinks back to Buffer::kDefaultCapacity when
+  // its connection is released
+  static constexpr size_t kMaxIdleBufferCapacity = 4 * 1024;
+
+  explicit ConnectionPool(size_t max_idle = kDefaultMaxIdle);
+
+  ~ConnectionPool();
+
+  DISALLOW_COPY_AND_MOVE(ConnectionPool);
+
+  // a connection of |fd|, recycled if any is idle
+  [[nodiscard]] auto Acquire(int fd) -> std::unique_ptr<Connection>;
+
+  // closes the connection, it is kept for a later Acquire() unless the pool
+  // is full
+  void Release(std::unique_ptr<Connection> connection);
+
+  [[nodiscard]] auto GetIdleCount() const -> size_t;
+
+ private:
+  size_t max_idle_;
+  mutable std::mutex mtx_;
+  std::vector<std::unique_ptr<Connection>> idle_;
+};
+
+}    // namespace longlp
+
+#endif    // SRC_CORE_CONNECTION_POOL_H_
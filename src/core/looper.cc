@@ -4,32 +4,136 @@
 
 #include "core/looper.h"
 
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
 #include <fmt/format.h>
 #include "core/acceptor.h"
 #include "core/connection.h"
+#include "core/metrics.h"
 #include "core/poller.h"
+#include "core/socket.h"
 #include "core/thread_pool.h"
+#include "core/trace.h"
+#include "log/logger.h"
 
 namespace longlp {
 
 namespace {
 // the epoll_wait time in milliseconds
 constexpr int kTimeoutMs = 3000;
+
+auto GetReactorName(size_t id) -> std::string {
+  return id == Looper::kListenerId ? "listener" : std::to_string(id);
+}
+
+auto MakeReactorLabels(size_t id) -> MetricLabels {
+  return {{"reactor", GetReactorName(id)}};
+}
+
+auto ToMicroseconds(std::chrono::steady_clock::duration duration)
+  -> microseconds {
+  return duration_cast<microseconds>(duration);
+}
+
+thread_local Looper* current_looper = nullptr;
 }    // namespace
 
-Looper::Looper() :
-  poller_(std::make_unique<Poller>(Poller::kDefaultListenedEvents)) {}
+// static
+auto Looper::GetCurrent() noexcept -> Looper* {
+  return current_looper;
+}
+
+Looper::Looper(size_t id) :
+  id_(id),
+  poller_(std::make_unique<Poller>(Poller::kDefaultListenedEvents)),
+  wakeup_(std::make_unique<Connection>(
+    std::make_unique<Socket>(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)))),
+  connections_metric_(MetricsRegistry::GetInstance().GetGauge(
+    "longlp_looper_connections",
+    "Connections watched by the reactor, cgi pipes included",
+    MakeReactorLabels(id))),
+  events_metric_(MetricsRegistry::GetInstance().GetCounter(
+    "longlp_looper_events_total",
+    "Ready events dispatched by the reactor",
+    MakeReactorLabels(id))),
+  dispatch_metric_(MetricsRegistry::GetInstance().GetHistogram(
+    "longlp_looper_dispatch_duration_seconds",
+    "Time the reactor took to run the callbacks of a poll",
+    MakeReactorLabels(id))),
+  callback_delay_metric_(MetricsRegistry::GetInstance().GetHistogram(
+    "longlp_looper_callback_delay_seconds",
+    "Time a ready event waited for its callback after the poll",
+    MakeReactorLabels(id))),
+  stalls_metric_(MetricsRegistry::GetInstance().GetCounter(
+    "longlp_looper_stalls_total",
+    "Callbacks which blocked the reactor over the stall threshold",
+    MakeReactorLabels(id))) {
+  StallDetector::GetInstance().Register(
+    GetReactorName(id),
+    &probe_,
+    stalls_metric_);
+  if (wakeup_->GetFd() == -1) {
+    Log<LogLevel::kError>("Looper: eventfd() error, Post() is unavailable");
+    return;
+  }
+  wakeup_->SetEvents(Poller::Event::kRead);
+  wakeup_->SetCallback([this](Connection*) { RunPostedTasks(); });
+  poller_->AddConnection(wakeup_.get());
+}
 
-Looper::~Looper() = default;
+Looper::~Looper() {
+  StallDetector::GetInstance().Unregister(&probe_);
+  connections_metric_.Sub(static_cast<int64_t>(connections_.size()));
+}
 
 void Looper::StartLoop() {
+  Tracer::GetInstance().SetThreadName(
+    id_ == kListenerId ? "listener" : fmt::format("reactor {}", id_));
+  // the spans of this thread name the stage of a stalled callback
+  trace_internal::stage = &probe_.stage;
+  current_looper        = this;
   while (!exit_) {
+    // an iteration is traced as a whole, from the poll to the last callback
+    const TraceSample sample{};
     auto ready_connections = poller_->Poll(kTimeoutMs);
     // fmt::print("ready connection size: {}\n", ready_connections.size());
+    events_metric_.Increment(ready_connections.size());
+    const auto woken = std::chrono::steady_clock::now();
     for (auto& connection : ready_connections) {
-      connection->Start();
+      // deleted by an earlier callback of this batch
+      if (connection->IsExpired()) {
+        continue;
+      }
+      const auto started = std::chrono::steady_clock::now();
+      callback_delay_metric_.Observe(ToMicroseconds(started - woken));
+      probe_.Begin(connection->GetFd(), started);
+      {
+        const TraceSpan span{"Dispatch", "fd", connection->GetFd()};
+        connection->Start();
+      }
+      probe_.End();
+    }
+    if (!ready_connections.empty()) {
+      dispatch_metric_.Observe(
+        ToMicroseconds(std::chrono::steady_clock::now() - woken));
+    }
+    // recycled out of the lock, their callbacks may post tasks
+    std::vector<std::unique_ptr<Connection>> retired;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      retired.swap(retired_);
+    }
+    for (auto& connection : retired) {
+      pool_.Release(std::move(connection));
     }
   }
+  trace_internal::stage = nullptr;
+  current_looper        = nullptr;
 }
 
 void Looper::AddAcceptor(Connection* acceptor_conn) {
@@ -42,6 +146,16 @@ void Looper::AddConnection(std::unique_ptr<Connection> new_conn) {
   poller_->AddConnection(new_conn.get());
   int fd = new_conn->GetFd();
   connections_.insert({fd, std::move(new_conn)});
+  connections_metric_.Add(1);
+}
+
+void Looper::ModifyConnection(Connection* conn) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  poller_->ModifyConnection(conn);
+}
+
+auto Looper::AcquireConnection(int fd) -> std::unique_ptr<Connection> {
+  return pool_.Acquire(fd);
 }
 
 auto Looper::DeleteConnection(int fd) -> bool {
@@ -50,8 +164,65 @@ auto Looper::DeleteConnection(int fd) -> bool {
   if (it == connections_.end()) {
     return false;
   }
+  it->second->Expire();
+  retired_.push_back(std::move(it->second));
   connections_.erase(it);
+  connections_metric_.Sub(1);
+  return true;
+}
+
+void Looper::Post(std::function<void()> task) {
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    posted_tasks_.push_back(std::move(task));
+  }
+  const uint64_t one = 1;
+  std::ignore        = write(wakeup_->GetFd(), &one, sizeof(one));
+}
+
+void Looper::RunPostedTasks() {
+  uint64_t count{};
+  std::ignore = read(wakeup_->GetFd(), &count, sizeof(count));
+  std::vector<std::function<void()>> tasks;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    tasks.swap(posted_tasks_);
+  }
+  for (auto& task : tasks) {
+    task();
+  }
+}
+
+auto Looper::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+  -> bool {
+  const int timer_fd =
+    timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd == -1) {
+    Log<LogLevel::kError>("Looper: timerfd_create() error code {}", errno);
+    return false;
+  }
+  const auto seconds = duration_cast<std::chrono::seconds>(duration_);
+  itimerspec expiry{};
+  expiry.it_value.tv_sec  = seconds.count();
+  expiry.it_value.tv_nsec =
+    duration_cast<std::chrono::nanoseconds>(duration_ - seconds).count();
+  std::ignore = timerfd_settime(timer_fd, 0, &expiry, nullptr);
+
+  handle_    = handle;
+  auto timer = looper_.AcquireConnection(timer_fd);
+  timer->SetEvents(Poller::Event::kRead);
+  timer->SetHandler(&OnExpired, this);
+  looper_.AddConnection(std::move(timer));
   return true;
 }
 
+// static
+void Looper::SleepAwaiter::OnExpired(
+  void* awaiter,
+  not_null<Connection*> timer) {
+  auto& self  = *static_cast<SleepAwaiter*>(awaiter);
+  std::ignore = self.looper_.DeleteConnection(timer->GetFd());
+  self.handle_.resume();
+}
+
 }    // namespace longlp
@@ -6,13 +6,20 @@
 #define SRC_CORE_LOOPER_H_
 
 #include <atomic>
+#include <coroutine>
 #include <functional>
 #include <future>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
+#include "base/chrono.h"
 #include "base/macros.h"
+#include "core/connection_pool.h"
+#include "core/stall_detector.h"
+#include "core/typedefs.h"
 
 namespace longlp {
 
@@ -20,30 +27,105 @@ class Poller;
 class ThreadPool;
 class Connection;
 class Acceptor;
+class Counter;
+class Gauge;
+class Histogram;
 
 // This Looper acts as the executor on a single thread adopt the philosophy of
 // 'one looper per thread'
 class Looper {
  public:
-  Looper();
+  // the id of the looper accepting the connections of a server
+  static constexpr size_t kListenerId = std::numeric_limits<size_t>::max();
+
+  // |id| tells the reactors of a server apart
+  explicit Looper(size_t id = 0);
   ~Looper();
   DISALLOW_COPY_AND_MOVE(Looper);
 
+  // Resumes the awaiting coroutine on the looper once |duration| elapsed,
+  // through a timerfd watched like any connection
+  class SleepAwaiter {
+   public:
+    SleepAwaiter(Looper& looper, milliseconds duration) noexcept :
+      looper_(looper),
+      duration_(duration) {}
+
+    [[nodiscard]] auto await_ready() const noexcept -> bool {
+      return duration_.count() <= 0;
+    }
+
+    // does not suspend if the timer cannot be created
+    auto await_suspend(std::coroutine_handle<> handle) -> bool;
+
+    void await_resume() const noexcept {}
+
+   private:
+    static void OnExpired(void* awaiter, not_null<Connection*> timer);
+
+    Looper& looper_;
+    milliseconds duration_;
+    std::coroutine_handle<> handle_{};
+  };
+
+  // the looper running on the calling thread, nullptr if none
+  [[nodiscard]] static auto GetCurrent() noexcept -> Looper*;
+
   void StartLoop();
 
   void AddAcceptor(Connection* acceptor_conn);
 
   void AddConnection(std::unique_ptr<Connection> new_conn);
 
+  // A connection of |fd| to be added to this looper, recycled from one it
+  // deleted before if possible. Callable from any thread
+  [[nodiscard]] auto AcquireConnection(int fd) -> std::unique_ptr<Connection>;
+
+  // The connection expires right away but is only destroyed once the current
+  // batch of events is dispatched, so any callback of that batch may delete
+  // any connection, including its own
   [[nodiscard]] auto DeleteConnection(int fd) -> bool;
 
+  // watch the events |conn| is set to from now on
+  void ModifyConnection(Connection* conn);
+
+  // co_await Sleep() from a coroutine running on the looper thread
+  [[nodiscard]] auto Sleep(milliseconds duration) noexcept -> SleepAwaiter {
+    return SleepAwaiter{*this, duration};
+  }
+
+  // Run the task on the looper thread, callable from any thread. Tasks are
+  // run in posting order
+  void Post(std::function<void()> task);
+
   void Exit() noexcept { exit_ = true; }
 
+  [[nodiscard]] auto GetId() const noexcept -> size_t { return id_; }
+
  private:
+  void RunPostedTasks();
+
+  size_t id_;
   std::unique_ptr<Poller> poller_;
+  // eventfd readable whenever there are posted tasks
+  std::unique_ptr<Connection> wakeup_;
   std::mutex mtx_;
+  std::vector<std::function<void()>> posted_tasks_;
   std::unordered_map<int /* fd */, std::unique_ptr<Connection>> connections_;
+  // deleted during the current batch, recycled after it
+  std::vector<std::unique_ptr<Connection>> retired_;
+  ConnectionPool pool_;
   bool exit_{false};
+  // labeled with |id_|
+  Gauge& connections_metric_;
+  Counter& events_metric_;
+  // from the poll wakeup to the end of the last callback
+  Histogram& dispatch_metric_;
+  // from the poll wakeup to the start of each callback
+  Histogram& callback_delay_metric_;
+  Counter& stalls_metric_;
+  // the running callback, watched by the stall detector
+  DispatchProbe probe_;
 };
 }    // namespace longlp
 #endif    // SRC_CORE_LOOPER_H_
@@ -0,0 +1,337 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <iterator>
+
+#include <fmt/format.h>
+
+#include "base/no_destructor.h"
+#include "log/logger.h"
+
+namespace longlp {
+
+namespace {
+constexpr double kSecondsPerMicrosecond = 1e-6;
+
+auto ToString(MetricsRegistry::Type type) noexcept -> std::string_view {
+  switch (type) {
+    case MetricsRegistry::Type::kCounter:
+      return "counter";
+    case MetricsRegistry::Type::kGauge:
+      return "gauge";
+    case MetricsRegistry::Type::kHistogram:
+      return "histogram";
+    default:
+      return "untyped";
+  }
+}
+
+void AppendEscaped(
+  std::string_view str,
+  bool is_label_value,
+  std::string& out) {
+  for (const auto ch : str) {
+    if (ch == '\\') {
+      out += "\\\\";
+    }
+    else if (ch == '\n') {
+      out += "\\n";
+    }
+    else if (ch == '"' && is_label_value) {
+      out += "\\\"";
+    }
+    else {
+      out += ch;
+    }
+  }
+}
+
+// {a="1",b="2"} with an optional trailing 'le' label, nothing if empty
+void AppendLabels(
+  const MetricLabels& labels,
+  std::string_view le,
+  std::string& out) {
+  if (labels.empty() && le.empty()) {
+    return;
+  }
+  out += '{';
+  for (const auto& [key, value] : labels) {
+    out += key;
+    out += "=\"";
+    AppendEscaped(value, true, out);
+    out += "\",";
+  }
+  if (!le.empty()) {
+    fmt::format_to(std::back_inserter(out), "le=\"{}\"", le);
+  }
+  else {
+    out.pop_back();
+  }
+  out += '}';
+}
+
+void AppendSample(
+  std::string_view name,
+  std::string_view suffix,
+  const MetricLabels& labels,
+  std::string_view le,
+  double value,
+  std::string& out) {
+  out += name;
+  out += suffix;
+  AppendLabels(labels, le, out);
+  fmt::format_to(std::back_inserter(out), " {}\n", value);
+}
+
+void AppendHistogram(
+  std::string_view name,
+  const MetricLabels& labels,
+  const Histogram& histogram,
+  std::string& out) {
+  const auto snapshot = histogram.GetSnapshot();
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i + 1 < Histogram::kBucketCount; ++i) {
+    cumulative += snapshot.counts[i];
+    const auto le = fmt::format(
+      "{}",
+      static_cast<double>(Histogram::GetBucketUpperBound(i)) *
+        kSecondsPerMicrosecond);
+    AppendSample(
+      name,
+      "_bucket",
+      labels,
+      le,
+      static_cast<double>(cumulative),
+      out);
+  }
+  AppendSample(
+    name,
+    "_bucket",
+    labels,
+    "+Inf",
+    static_cast<double>(snapshot.count),
+    out);
+  AppendSample(
+    name,
+    "_sum",
+    labels,
+    {},
+    static_cast<double>(snapshot.sum.count()) * kSecondsPerMicrosecond,
+    out);
+  AppendSample(
+    name,
+    "_count",
+    labels,
+    {},
+    static_cast<double>(snapshot.count),
+    out);
+}
+
+void RegisterLoggerMetrics(MetricsRegistry& registry) {
+  registry.AddCallback(
+    "longlp_log_dropped_total",
+    "Logs dropped because the ring buffer of the thread was full",
+    MetricsRegistry::Type::kCounter,
+    [] {
+      return static_cast<double>(Logger::GetInstance().GetDroppedCount());
+    });
+}
+}    // namespace
+
+namespace metrics_internal {
+auto GetShardIndex() noexcept -> size_t {
+  static std::atomic<size_t> next_index = 0;
+  thread_local const size_t index =
+    next_index.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+  return index;
+}
+
+auto ShardedValue::Sum() const noexcept -> int64_t {
+  int64_t sum = 0;
+  for (const auto& shard : shards_) {
+    sum += shard.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+}    // namespace metrics_internal
+
+void Histogram::Observe(microseconds duration) noexcept {
+  const auto value =
+    static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+  auto& shard = shards_[metrics_internal::GetShardIndex()];
+  shard.counts[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+auto Histogram::GetSnapshot() const noexcept -> Snapshot {
+  Snapshot snapshot{};
+  uint64_t sum = 0;
+  for (const auto& shard : shards_) {
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      const auto count = shard.counts[i].load(std::memory_order_relaxed);
+      snapshot.counts[i] += count;
+      snapshot.count += count;
+    }
+    sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  snapshot.sum = microseconds{static_cast<int64_t>(sum)};
+  return snapshot;
+}
+
+// static
+auto Histogram::GetBucketIndex(uint64_t value) noexcept -> size_t {
+  if (value < kSubBucketCount) {
+    return value;
+  }
+  const auto exponent = std::bit_width(value) - 1;
+  if (exponent >= kMaxExponent) {
+    return kBucketCount - 1;
+  }
+  // the kSubBucketBits bits after the leading one
+  const auto shift = exponent - kSubBucketBits;
+  const auto sub   = (value >> shift) - kSubBucketCount;
+  return kSubBucketCount + shift * kSubBucketCount + sub;
+}
+
+// static
+auto Histogram::GetBucketUpperBound(size_t index) noexcept -> uint64_t {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  const auto shift = (index - kSubBucketCount) / kSubBucketCount;
+  const auto sub   = (index - kSubBucketCount) % kSubBucketCount;
+  const auto lower = (kSubBucketCount + sub) << shift;
+  return lower + (uint64_t{1} << shift) - 1;
+}
+
+// static
+auto MetricsRegistry::GetInstance() noexcept -> MetricsRegistry& {
+  static MetricsRegistry* const registry = [] {
+    static NoDestructor<MetricsRegistry> instance{};
+    RegisterLoggerMetrics(*instance);
+    return instance.get();
+  }();
+  return *registry;
+}
+
+auto MetricsRegistry::GetCounter(
+  std::string_view name,
+  std::string_view help,
+  const MetricLabels& labels) -> Counter& {
+  return GetMetric<Counter>(name, help, Type::kCounter, labels);
+}
+
+auto MetricsRegistry::GetGauge(
+  std::string_view name,
+  std::string_view help,
+  const MetricLabels& labels) -> Gauge& {
+  return GetMetric<Gauge>(name, help, Type::kGauge, labels);
+}
+
+auto MetricsRegistry::GetHistogram(
+  std::string_view name,
+  std::string_view help,
+  const MetricLabels& labels) -> Histogram& {
+  return GetMetric<Histogram>(name, help, Type::kHistogram, labels);
+}
+
+void MetricsRegistry::AddCallback(
+  std::string_view name,
+  std::string_view help,
+  Type type,
+  Callback callback,
+  const MetricLabels& labels) {
+  // a callback has a single value
+  assert(type != Type::kHistogram);
+  std::unique_lock<std::mutex> lock(mtx_);
+  FindOrAddSeries(name, help, type, labels).metric = std::move(callback);
+}
+
+void MetricsRegistry::WriteText(std::string& out) const {
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (const auto& [name, family] : families_) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    AppendEscaped(family.help, false, out);
+    fmt::format_to(
+      std::back_inserter(out),
+      "\n# TYPE {} {}\n",
+      name,
+      ToString(family.type));
+    for (const auto& series : family.series) {
+      if (const auto* counter = std::get_if<0>(&series.metric)) {
+        AppendSample(
+          name,
+          {},
+          series.labels,
+          {},
+          static_cast<double>((*counter)->GetValue()),
+          out);
+      }
+      else if (const auto* gauge = std::get_if<1>(&series.metric)) {
+        AppendSample(
+          name,
+          {},
+          series.labels,
+          {},
+          static_cast<double>((*gauge)->GetValue()),
+          out);
+      }
+      else if (const auto* histogram = std::get_if<2>(&series.metric)) {
+        AppendHistogram(name, series.labels, **histogram, out);
+      }
+      else if (const auto* callback = std::get_if<3>(&series.metric)) {
+        AppendSample(name, {}, series.labels, {}, (*callback)(), out);
+      }
+    }
+  }
+}
+
+auto MetricsRegistry::FindOrAddSeries(
+  std::string_view name,
+  std::string_view help,
+  Type type,
+  const MetricLabels& labels) -> Series& {
+  auto family = families_.find(name);
+  if (family == families_.end()) {
+    family =
+      families_.emplace(std::string(name), Family{std::string(help), type, {}})
+        .first;
+  }
+  // a name is a single type
+  assert(family->second.type == type);
+  auto& series = family->second.series;
+  const auto found =
+    std::find_if(series.begin(), series.end(), [&](const Series& item) {
+      return item.labels == labels;
+    });
+  if (found != series.end()) {
+    return *found;
+  }
+  return series.emplace_back(Series{labels, {}});
+}
+
+template <class Metric>
+auto MetricsRegistry::GetMetric(
+  std::string_view name,
+  std::string_view help,
+  Type type,
+  const MetricLabels& labels) -> Metric& {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto& series = FindOrAddSeries(name, help, type, labels);
+  auto* metric = std::get_if<std::unique_ptr<Metric>>(&series.metric);
+  if (metric == nullptr || *metric == nullptr) {
+    series.metric = std::make_unique<Metric>();
+    metric        = std::get_if<std::unique_ptr<Metric>>(&series.metric);
+  }
+  return **metric;
+}
+
+}    // namespace longlp
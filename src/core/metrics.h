@@ -0,0 +1,218 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_CORE_METRICS_H_
+#define SRC_CORE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "base/chrono.h"
+#include "base/macros.h"
+
+namespace longlp {
+
+// label name and value pairs of a series, e.g. {{"reactor", "0"}}
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+namespace metrics_internal {
+// Every metric is split into shards, a thread only ever updates its own
+// shard so that updates from different threads never touch the same cache
+// line. Shards are only summed up when the metric is read
+inline constexpr size_t kShardCount    = 64;
+inline constexpr size_t kCacheLineSize = 64;
+
+// the shard of the calling thread, threads are spread round robin
+[[nodiscard]] auto GetShardIndex() noexcept -> size_t;
+
+struct alignas(kCacheLineSize) Shard {
+  std::atomic<int64_t> value = 0;
+};
+
+class ShardedValue {
+ public:
+  void Add(int64_t delta) noexcept {
+    shards_[GetShardIndex()].value.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto Sum() const noexcept -> int64_t;
+
+ private:
+  std::array<Shard, kShardCount> shards_{};
+};
+}    // namespace metrics_internal
+
+// A value that only goes up, e.g. the requests served
+class Counter {
+ public:
+  void Increment(uint64_t delta = 1) noexcept {
+    value_.Add(static_cast<int64_t>(delta));
+  }
+
+  [[nodiscard]] auto GetValue() const noexcept -> uint64_t {
+    return static_cast<uint64_t>(value_.Sum());
+  }
+
+ private:
+  metrics_internal::ShardedValue value_;
+};
+
+// A value that goes up and down, e.g. the open connections
+class Gauge {
+ public:
+  void Add(int64_t delta) noexcept { value_.Add(delta); }
+
+  void Sub(int64_t delta) noexcept { value_.Add(-delta); }
+
+  [[nodiscard]] auto GetValue() const noexcept -> int64_t {
+    return value_.Sum();
+  }
+
+ private:
+  metrics_internal::ShardedValue value_;
+};
+
+// A latency distribution with HDR-style log-linear buckets: every power of two
+// range of microseconds is split into kSubBucketCount buckets of equal width,
+// which keeps the relative error under 1 / kSubBucketCount at any scale.
+// Durations over 2^kMaxExponent us only count in the +Inf bucket
+class Histogram {
+ public:
+  static constexpr size_t kSubBucketBits  = 2;
+  static constexpr size_t kSubBucketCount = size_t{1} << kSubBucketBits;
+  // about 67 s
+  static constexpr size_t kMaxExponent = 26;
+  // the last one is the overflow bucket
+  static constexpr size_t kBucketCount =
+    kSubBucketCount * (kMaxExponent - kSubBucketBits + 1) + 1;
+
+  struct Snapshot {
+    // per bucket, not cumulative
+    std::array<uint64_t, kBucketCount> counts{};
+    uint64_t count = 0;
+    microseconds sum{0};
+  };
+
+  void Observe(microseconds duration) noexcept;
+
+  [[nodiscard]] auto GetSnapshot() const noexcept -> Snapshot;
+
+  [[nodiscard]] static auto GetBucketIndex(uint64_t value) noexcept -> size_t;
+
+  // the largest value of the bucket, inclusive, not meaningful for the
+  // overflow bucket
+  [[nodiscard]] static auto GetBucketUpperBound(size_t index) noexcept
+    -> uint64_t;
+
+ private:
+  struct alignas(metrics_internal::kCacheLineSize) Shard {
+    std::array<std::atomic<uint64_t>, kBucketCount> counts{};
+    std::atomic<uint64_t> sum = 0;
+  };
+
+  std::array<Shard, metrics_internal::kShardCount> shards_{};
+};
+
+// The metrics of the process, exposed in the Prometheus text format.
+// Metrics are created once, e.g. when a component is constructed, and then
+// updated through the returned reference without any lock. A metric is never
+// removed, the same name and labels always give back the same metric.
+// Thread-safe
+class MetricsRegistry {
+ public:
+  enum class Type {
+    kCounter,
+    kGauge,
+    kHistogram,
+  };
+
+  // read from the owner of the value when the metrics are exposed
+  using Callback = std::function<double()>;
+
+  MetricsRegistry() = default;
+
+  ~MetricsRegistry() = default;
+
+  DISALLOW_COPY_AND_MOVE(MetricsRegistry);
+
+  // the one of the server, the logger metrics are already registered
+  [[nodiscard]] static auto GetInstance() noexcept -> MetricsRegistry&;
+
+  // a name must always be used with the same type
+  [[nodiscard]] auto GetCounter(
+    std::string_view name,
+    std::string_view help,
+    const MetricLabels& labels = {}) -> Counter&;
+
+  [[nodiscard]] auto GetGauge(
+    std::string_view name,
+    std::string_view help,
+    const MetricLabels& labels = {}) -> Gauge&;
+
+  // exposed in seconds
+  [[nodiscard]] auto GetHistogram(
+    std::string_view name,
+    std::string_view help,
+    const MetricLabels& labels = {}) -> Histogram&;
+
+  // |callback| must stay callable as long as the registry is exposed,
+  // registering the same series again replaces it
+  void AddCallback(
+    std::string_view name,
+    std::string_view help,
+    Type type,
+    Callback callback,
+    const MetricLabels& labels = {});
+
+  // Prometheus text exposition format 0.0.4, families sorted by name
+  void WriteText(std::string& out) const;
+
+ private:
+  struct Series {
+    MetricLabels labels;
+    std::variant<
+      std::unique_ptr<Counter>,
+      std::unique_ptr<Gauge>,
+      std::unique_ptr<Histogram>,
+      Callback>
+      metric;
+  };
+
+  struct Family {
+    std::string help;
+    Type type;
+    std::vector<Series> series;
+  };
+
+  // the series of |name| and |labels|, created empty if needed
+  auto FindOrAddSeries(
+    std::string_view name,
+    std::string_view help,
+    Type type,
+    const MetricLabels& labels) -> Series&;
+
+  template <class Metric>
+  auto GetMetric(
+    std::string_view name,
+    std::string_view help,
+    Type type,
+    const MetricLabels& labels) -> Metric&;
+
+  mutable std::mutex mtx_;
+  std::map<std::string, Family, std::less<>> families_;
+};
+
+}    // namespace longlp
+
+#endif    // SRC_CORE_METRICS_H_
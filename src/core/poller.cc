@@ -5,10 +5,12 @@
 #include "core/poller.h"
 
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 
 #include "base/utils.h"
 #include "core/connection.h"
+#include "core/trace.h"
 #include "log/logger.h"
 
 namespace longlp {
@@ -54,12 +56,32 @@ void Poller::AddConnection(Connection* conn) const {
   }
 }
 
+void Poller::ModifyConnection(Connection* conn) const {
+  auto event     = DefaultPollEvent();
+  event.data.ptr = conn;
+  event.events   = conn->GetEvents();
+
+  const auto ret_val =
+    epoll_ctl(poll_fd_, Poller::Event::kModify, conn->GetFd(), &event);
+  if (ret_val == -1) {
+    Log<LogLevel::kError>(
+      "Poller: epoll_ctl modify error on fd {}, errno {}",
+      conn->GetFd(),
+      errno);
+  }
+}
+
 auto Poller::Poll(int timeout) -> std::vector<Connection*> {
+  const TraceSpan span{"Poll"};
   auto ready = epoll_wait(
     poll_fd_,
     poll_events_.data(),
     narrow_cast<int>(poll_events_.size()),
     timeout);
+  // interrupted by a signal, e.g. a child process exit, nothing is ready
+  if (ready == -1 && errno == EINTR) {
+    return {};
+  }
   if (ready == -1) {
     perror("Poller: Poll() error");
     // TODO(longlp): It is not thread-safe
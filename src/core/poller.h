@@ -25,9 +25,11 @@ class Poller {
   static constexpr auto kBlockForever          = -1;
 
   enum Event {
-    kAdd  = EPOLL_CTL_ADD,
-    kRead = EPOLLIN,
-    kET   = EPOLLET,
+    kAdd    = EPOLL_CTL_ADD,
+    kModify = EPOLL_CTL_MOD,
+    kRead   = EPOLLIN,
+    kWrite  = EPOLLOUT,
+    kET     = EPOLLET,
   };
 
   explicit Poller(uint64_t poll_size);
@@ -37,6 +39,9 @@ class Poller {
 
   void AddConnection(Connection* conn) const;
 
+  // watch the events |conn| is set to from now on
+  void ModifyConnection(Connection* conn) const;
+
   // timeout in milliseconds
   [[nodiscard]] auto Poll(int timeout_ms) -> std::vector<Connection*>;
 
@@ -15,10 +15,10 @@ namespace longlp {
 Server::Server(const NetAddress& server_address, int64_t num_threads) :
   agent_{std::make_unique<DistributionAgent>()},
   pool_(std::make_unique<ThreadPool>(num_threads)),
-  listener_(std::make_unique<Looper>()) {
+  listener_(std::make_unique<Looper>(Looper::kListenerId)) {
   reactors_.reserve(pool_->GetSize());
   for (auto i = 0U; i < pool_->GetSize(); ++i) {
-    auto& reactor = reactors_.emplace_back(std::make_unique<Looper>());
+    auto& reactor = reactors_.emplace_back(std::make_unique<Looper>(i));
     pool_->SubmitTask([&reactor] { reactor->StartLoop(); });
     agent_->AddCandidate(reactor.get());
   }
@@ -40,6 +40,15 @@ auto Server::OnHandle(ConnectionCallback on_handle) -> Server& {
   return *this;
 }
 
+void Server::SetHandlers(
+  ConnectionHandlerFn invoke,
+  std::vector<void*> handlers,
+  std::shared_ptr<void> owner) {
+  acceptor_->SetOnHandle(invoke, std::move(handlers));
+  handlers_      = std::move(owner);
+  on_handle_set_ = true;
+}
+
 void Server::Begin() {
   if (!on_handle_set_) {
     throw std::logic_error(
@@ -47,9 +47,32 @@ class Server {
   // function to achieve the expected behavior
   [[nodiscard]] auto OnHandle(ConnectionCallback on_handle) -> Server&;
 
+  // As above, statically dispatched: each reactor gets its own copy of
+  // |on_handle|, only ever called from the reactor thread, and calls it
+  // without going through std::function
+  template <typename Handler>
+  [[nodiscard]] auto OnHandle(Handler on_handle) -> Server& {
+    auto handlers =
+      std::make_shared<std::vector<Handler>>(reactors_.size(), on_handle);
+    std::vector<void*> erased;
+    erased.reserve(handlers->size());
+    for (auto& handler : *handlers) {
+      erased.push_back(&handler);
+    }
+    SetHandlers(&InvokeHandler<Handler>, std::move(erased), handlers);
+    return *this;
+  }
+
   void Begin();
 
  private:
+  void SetHandlers(
+    ConnectionHandlerFn invoke,
+    std::vector<void*> handlers,
+    std::shared_ptr<void> owner);
+
+  // destroyed last, the reactors may still be calling them
+  std::shared_ptr<void> handlers_;
   bool on_handle_set_{false};
   std::unique_ptr<Acceptor> acceptor_;
   std::vector<std::unique_ptr<Looper>> reactors_;
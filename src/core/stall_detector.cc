@@ -0,0 +1,121 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/stall_detector.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "core/metrics.h"
+#include "log/logger.h"
+
+namespace longlp {
+
+namespace {
+// the threshold is checked this many times over, a stall is reported at most
+// a quarter of the threshold late
+constexpr int64_t kChecksPerThreshold = 4;
+
+auto ToNanoseconds(std::chrono::steady_clock::time_point time) noexcept
+  -> int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           time.time_since_epoch())
+    .count();
+}
+}    // namespace
+
+void DispatchProbe::Begin(
+  int conn_fd,
+  std::chrono::steady_clock::time_point now) noexcept {
+  // orders the End() of the previous callback before the new sequence
+  sequence.fetch_add(1, std::memory_order_release);
+  fd.store(conn_fd, std::memory_order_relaxed);
+  started_ns.store(ToNanoseconds(now), std::memory_order_release);
+}
+
+// static
+auto StallDetector::GetInstance() noexcept -> StallDetector& {
+  static NoDestructor<StallDetector> instance{};
+  return *instance;
+}
+
+void StallDetector::SetThreshold(milliseconds threshold) {
+  threshold_ms_.store(
+    std::max<int64_t>(threshold.count(), 0),
+    std::memory_order_relaxed);
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (threshold.count() > 0 && !watching_) {
+    watching_ = true;
+    // lives as long as the process, as the detector itself
+    std::thread([this]() { Watch(); }).detach();
+  }
+  cv_.notify_all();
+}
+
+void StallDetector::Register(
+  std::string reactor,
+  DispatchProbe* probe,
+  Counter& stalls) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  watched_.push_back({std::move(reactor), probe, &stalls, 0});
+}
+
+void StallDetector::Unregister(DispatchProbe* probe) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  std::erase_if(watched_, [probe](const Watched& watched) {
+    return watched.probe == probe;
+  });
+}
+
+void StallDetector::Watch() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (true) {
+    const auto threshold = GetThreshold();
+    if (threshold.count() == 0) {
+      cv_.wait(lock);
+      continue;
+    }
+    cv_.wait_for(
+      lock,
+      std::max(threshold / kChecksPerThreshold, milliseconds{1}));
+    CheckOnce();
+  }
+}
+
+void StallDetector::CheckOnce() {
+  const auto threshold = GetThreshold();
+  if (threshold.count() == 0) {
+    return;
+  }
+  const auto now = ToNanoseconds(std::chrono::steady_clock::now());
+  for (auto& watched : watched_) {
+    // the start time belongs to the sequence only if it did not change in
+    // between, otherwise the next check looks at the new callback
+    const auto sequence =
+      watched.probe->sequence.load(std::memory_order_acquire);
+    const auto started =
+      watched.probe->started_ns.load(std::memory_order_acquire);
+    const auto fd = watched.probe->fd.load(std::memory_order_relaxed);
+    if (
+      started == 0 || sequence == watched.reported_sequence ||
+      sequence != watched.probe->sequence.load(std::memory_order_relaxed) ||
+      now - started <
+        std::chrono::duration_cast<std::chrono::nanoseconds>(threshold)
+          .count()) {
+      continue;
+    }
+    watched.reported_sequence = sequence;
+    watched.stalls->Increment();
+    const auto* stage = watched.probe->stage.load(std::memory_order_relaxed);
+    Log<LogLevel::kWarning>(
+      "StallDetector: reactor {} blocked for {} ms by fd {} in {}",
+      watched.reactor,
+      (now - started) / 1'000'000,
+      fd,
+      stage != nullptr ? stage : "an untraced stage");
+  }
+}
+
+}    // namespace longlp
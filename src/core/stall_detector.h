@@ -0,0 +1,91 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_CORE_STALL_DETECTOR_H_
+#define SRC_CORE_STALL_DETECTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/chrono.h"
+#include "base/macros.h"
+#include "base/no_destructor.h"
+
+namespace longlp {
+
+class Counter;
+
+// The callback a reactor is running, published for the stall detector
+struct DispatchProbe {
+  // steady clock time since epoch in ns when the callback started, 0 when
+  // the reactor is not running any
+  std::atomic<int64_t> started_ns = 0;
+  std::atomic<int> fd             = -1;
+  // the innermost TraceSpan in progress, nullptr if none
+  std::atomic<const char*> stage = nullptr;
+  // one per callback, a stall is only reported once
+  std::atomic<uint64_t> sequence = 0;
+
+  void Begin(int conn_fd, std::chrono::steady_clock::time_point now) noexcept;
+
+  void End() noexcept { started_ns.store(0, std::memory_order_release); }
+};
+
+// Watches the probes of the registered reactors from a thread of its own and
+// reports every callback blocking its reactor for longer than the threshold,
+// with its fd and stage, while it is still running. Thread-safe
+class StallDetector {
+ public:
+  DISALLOW_COPY_AND_MOVE(StallDetector);
+
+  [[nodiscard]] static auto GetInstance() noexcept -> StallDetector&;
+
+  // 0 (the default) disables the detection, the watching thread is started
+  // on the first non-zero threshold
+  void SetThreshold(milliseconds threshold);
+
+  [[nodiscard]] auto GetThreshold() const noexcept -> milliseconds {
+    return milliseconds{threshold_ms_.load(std::memory_order_relaxed)};
+  }
+
+  // |probe| must stay valid until unregistered, |reactor| names it in the
+  // reports
+  void Register(std::string reactor, DispatchProbe* probe, Counter& stalls);
+
+  void Unregister(DispatchProbe* probe);
+
+ private:
+  struct Watched {
+    std::string reactor;
+    DispatchProbe* probe;
+    Counter* stalls;
+    uint64_t reported_sequence;
+  };
+
+  friend class NoDestructor<StallDetector>;
+
+  StallDetector() = default;
+
+  ~StallDetector() = default;
+
+  // the body of the watching thread, which lives as long as the process
+  [[noreturn]] void Watch();
+
+  void CheckOnce();
+
+  std::atomic<int64_t> threshold_ms_ = 0;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool watching_{false};
+  std::vector<Watched> watched_;
+};
+
+}    // namespace longlp
+
+#endif    // SRC_CORE_STALL_DETECTOR_H_
@@ -0,0 +1,176 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_CORE_TASK_H_
+#define SRC_CORE_TASK_H_
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "base/macros.h"
+
+namespace longlp {
+
+template <typename T = void>
+class Task;
+
+namespace task_internal {
+// Resumes the coroutine awaiting the finished task, or frees the frame of a
+// detached one
+struct FinalAwaiter {
+  [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+
+  template <typename Promise>
+  auto await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    -> std::coroutine_handle<> {
+    auto& promise = handle.promise();
+    if (promise.continuation) {
+      return promise.continuation;
+    }
+    if (promise.detached) {
+      // nobody is left to rethrow it to
+      if (promise.exception) {
+        std::terminate();
+      }
+      handle.destroy();
+    }
+    return std::noop_coroutine();
+  }
+
+  void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+  // lazy, runs once awaited or detached
+  auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+
+  auto final_suspend() noexcept -> FinalAwaiter { return {}; }
+
+  void unhandled_exception() noexcept {
+    exception = std::current_exception();
+  }
+
+  void RethrowIfFailed() const {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  std::coroutine_handle<> continuation{};
+  std::exception_ptr exception{};
+  bool detached{false};
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+  auto get_return_object() noexcept -> Task<T>;
+
+  template <typename U>
+  void return_value(U&& result) {
+    value.emplace(std::forward<U>(result));
+  }
+
+  auto TakeResult() -> T {
+    RethrowIfFailed();
+    return std::move(*value);
+  }
+
+  std::optional<T> value{};
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  auto get_return_object() noexcept -> Task<void>;
+
+  void return_void() noexcept {}
+
+  void TakeResult() const { RethrowIfFailed(); }
+};
+}    // namespace task_internal
+
+// A coroutine producing a |T|, started lazily. Either co_await it from
+// another coroutine, which resumes with its result once it finishes, or
+// Detach() it from plain code. Not thread-safe, a task resumes on whatever
+// thread completes what it awaits, see e.g. Connection::AsyncRead()
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = task_internal::Promise<T>;
+  using Handle       = std::coroutine_handle<promise_type>;
+
+  class Awaiter {
+   public:
+    explicit Awaiter(Handle handle) noexcept :
+      handle_(handle) {}
+
+    [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+
+    // symmetric transfer, a long chain of tasks does not grow the stack
+    auto await_suspend(std::coroutine_handle<> awaiting) noexcept
+      -> std::coroutine_handle<> {
+      handle_.promise().continuation = awaiting;
+      return handle_;
+    }
+
+    auto await_resume() -> T { return handle_.promise().TakeResult(); }
+
+   private:
+    Handle handle_;
+  };
+
+  explicit Task(Handle handle) noexcept :
+    handle_(handle) {}
+
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  DISALLOW_COPY(Task);
+
+  Task(Task&& other) noexcept :
+    handle_(std::exchange(other.handle_, {})) {}
+
+  auto operator=(Task&& other) noexcept -> Task& {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  // the task is owned by this object until it finishes
+  auto operator co_await() && noexcept -> Awaiter { return Awaiter{handle_}; }
+
+  // Run the task until it first suspends. It then goes on by itself and frees
+  // itself once finished, an exception escaping it terminates the program
+  void Detach() && {
+    auto handle               = std::exchange(handle_, {});
+    handle.promise().detached = true;
+    handle.resume();
+  }
+
+ private:
+  Handle handle_;
+};
+
+namespace task_internal {
+template <typename T>
+auto Promise<T>::get_return_object() noexcept -> Task<T> {
+  return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+}
+
+inline auto Promise<void>::get_return_object() noexcept -> Task<void> {
+  return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+}
+}    // namespace task_internal
+
+}    // namespace longlp
+
+#endif    // SRC_CORE_TASK_H_
@@ -4,7 +4,24 @@
 
 #include "core/thread_pool.h"
 
+#include "core/looper.h"
+#include "core/trace.h"
+
 namespace longlp {
+namespace thread_pool_internal {
+auto GetCurrentLooper() noexcept -> Looper* {
+  return Looper::GetCurrent();
+}
+
+void ResumeOn(Looper* looper, std::coroutine_handle<> handle) {
+  if (looper == nullptr) {
+    handle.resume();
+    return;
+  }
+  looper->Post([handle]() { handle.resume(); });
+}
+}    // namespace thread_pool_internal
+
 ThreadPool::ThreadPool(const size_t thread_count) :
   stop_(false) {
   static constexpr size_t kMinThreadCount = 2U;
@@ -42,6 +59,7 @@ ThreadPool::ThreadPool(const size_t thread_count) :
         }
 
         // worker do the task
+        const TraceSample sample{};
         incoming_task();
       }
     });
@@ -7,19 +7,35 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <coroutine>
+#include <exception>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <stdexcept>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include "base/macros.h"
 
 namespace longlp {
 
+class Looper;
+
+namespace thread_pool_internal {
+// the looper running on the calling thread, nullptr if none
+auto GetCurrentLooper() noexcept -> Looper*;
+
+// on |looper| through Looper::Post(), right away on the calling thread if
+// |looper| is nullptr
+void ResumeOn(Looper* looper, std::coroutine_handle<> handle);
+}    // namespace thread_pool_internal
+
 class ThreadPool {
  public:
   explicit ThreadPool(size_t thread_count);
@@ -32,6 +48,49 @@ class ThreadPool {
   auto SubmitTask(F&& new_task, Args&&... args)
     -> std::future<std::invoke_result_t<F, Args...>>;
 
+  // Runs |F| on a worker, then resumes the awaiting coroutine with its result
+  // or exception on the looper it was running on, or on the worker if it was
+  // not running on any
+  template <class F>
+  class OffloadAwaiter {
+   public:
+    using result_type = std::invoke_result_t<F&>;
+
+    OffloadAwaiter(ThreadPool& pool, F work) :
+      pool_(pool),
+      work_(std::move(work)) {}
+
+    ~OffloadAwaiter() = default;
+    DISALLOW_COPY_AND_MOVE(OffloadAwaiter);
+
+    [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    auto await_resume() -> result_type;
+
+   private:
+    // the awaiter lives in the coroutine frame until it resumes
+    void Run(Looper* looper, std::coroutine_handle<> handle) noexcept;
+
+    ThreadPool& pool_;
+    F work_;
+    std::conditional_t<
+      std::is_void_v<result_type>,
+      bool,
+      std::optional<result_type>>
+      result_{};
+    std::exception_ptr exception_{};
+  };
+
+  // co_await Offload(work) from a coroutine for what would block its looper,
+  // e.g. disk I/O. Name a capturing lambda before the co_await expression,
+  // GCC 12 miscompiles the copies it captures when written inside of it
+  template <class F>
+  [[nodiscard]] auto Offload(F work) -> OffloadAwaiter<F> {
+    return OffloadAwaiter<F>{*this, std::move(work)};
+  }
+
   auto GetSize() -> size_t { return workers_.size(); }
 
  private:
@@ -74,6 +133,43 @@ auto ThreadPool::SubmitTask(F&& new_task, Args&&... args)
   return res;
 }
 
+template <class F>
+void ThreadPool::OffloadAwaiter<F>::await_suspend(
+  std::coroutine_handle<> handle) {
+  auto* looper = thread_pool_internal::GetCurrentLooper();
+  std::ignore  = pool_.SubmitTask([this, looper, handle]() {
+    Run(looper, handle);
+  });
+}
+
+template <class F>
+void ThreadPool::OffloadAwaiter<F>::Run(
+  Looper* looper,
+  std::coroutine_handle<> handle) noexcept {
+  try {
+    if constexpr (std::is_void_v<result_type>) {
+      work_();
+    }
+    else {
+      result_.emplace(work_());
+    }
+  }
+  catch (...) {
+    exception_ = std::current_exception();
+  }
+  thread_pool_internal::ResumeOn(looper, handle);
+}
+
+template <class F>
+auto ThreadPool::OffloadAwaiter<F>::await_resume() -> result_type {
+  if (exception_) {
+    std::rethrow_exception(exception_);
+  }
+  if constexpr (!std::is_void_v<result_type>) {
+    return std::move(*result_);
+  }
+}
+
 }    // namespace longlp
 
 #endif    // SRC_CORE_THREAD_POOL_H_
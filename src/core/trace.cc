@@ -0,0 +1,176 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/trace.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <iterator>
+
+#include <fmt/format.h>
+
+namespace longlp {
+
+namespace {
+constexpr double kNanosecondsPerMicrosecond = 1e3;
+// 2^-53, turns the 53 high bits of a random number into [0, 1)
+constexpr double kUnitScale = 1.0 / static_cast<double>(uint64_t{1} << 53);
+
+// xorshift64*, the sampling only needs to be cheap and roughly uniform
+auto NextRandom() noexcept -> uint64_t {
+  thread_local uint64_t state =
+    static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count()) |
+    static_cast<uint64_t>(gettid()) << 32U | 1U;
+  state ^= state >> 12U;
+  state ^= state << 25U;
+  state ^= state >> 27U;
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+auto ToMicroseconds(std::chrono::steady_clock::duration duration) -> double {
+  return static_cast<double>(
+           std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+             .count()) /
+         kNanosecondsPerMicrosecond;
+}
+
+void AppendEscaped(std::string_view str, std::string& out) {
+  for (const auto ch : str) {
+    if (ch == '"' || ch == '\\') {
+      out += '\\';
+    }
+    out += ch;
+  }
+}
+}    // namespace
+
+struct Tracer::ThreadBuffer {
+  std::mutex mtx;
+  pid_t tid = gettid();
+  std::string name;
+  // a ring of the last kEventsPerThread spans
+  std::vector<TraceEvent> events;
+  size_t recorded = 0;
+};
+
+// static
+auto Tracer::GetInstance() noexcept -> Tracer& {
+  static NoDestructor<Tracer> instance{};
+  return *instance;
+}
+
+void Tracer::SetSampleRate(double rate) noexcept {
+  sample_rate_.store(std::clamp(rate, 0.0, 1.0), std::memory_order_relaxed);
+}
+
+void Tracer::SetThreadName(std::string name) {
+  auto& buffer = GetThreadBuffer();
+  std::unique_lock<std::mutex> lock(buffer.mtx);
+  buffer.name = std::move(name);
+}
+
+void Tracer::Record(const TraceEvent& event) {
+  auto& buffer = GetThreadBuffer();
+  std::unique_lock<std::mutex> lock(buffer.mtx);
+  if (buffer.events.size() < kEventsPerThread) {
+    buffer.events.push_back(event);
+  }
+  else {
+    buffer.events[buffer.recorded % kEventsPerThread] = event;
+  }
+  ++buffer.recorded;
+}
+
+void Tracer::WriteChromeTrace(std::string& out) const {
+  // the timestamps only need a common origin
+  const auto origin = std::chrono::steady_clock::time_point{};
+  const auto pid    = getpid();
+  out += "{\"traceEvents\":[";
+  bool first = true;
+  auto separate = [&first, &out]() {
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+  };
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (const auto& buffer : buffers_) {
+    std::unique_lock<std::mutex> buffer_lock(buffer->mtx);
+    if (!buffer->name.empty()) {
+      separate();
+      fmt::format_to(
+        std::back_inserter(out),
+        "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},"
+        "\"args\":{{\"name\":\"",
+        pid,
+        buffer->tid);
+      AppendEscaped(buffer->name, out);
+      out += "\"}}";
+    }
+    // the oldest span is the next one to be overwritten
+    const auto size  = buffer->events.size();
+    const auto begin = buffer->recorded > size ? buffer->recorded % size : 0;
+    for (size_t i = 0; i < size; ++i) {
+      const auto& event = buffer->events[(begin + i) % size];
+      separate();
+      fmt::format_to(
+        std::back_inserter(out),
+        "{{\"name\":\"{}\",\"cat\":\"longlp\",\"ph\":\"X\",\"pid\":{},"
+        "\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+        event.name,
+        pid,
+        buffer->tid,
+        ToMicroseconds(event.start - origin),
+        ToMicroseconds(event.duration));
+      if (event.arg_name != nullptr) {
+        fmt::format_to(
+          std::back_inserter(out),
+          ",\"args\":{{\"{}\":{}}}",
+          event.arg_name,
+          event.arg_value);
+      }
+      out += '}';
+    }
+  }
+  out += "],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Tracer::Clear() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (const auto& buffer : buffers_) {
+    std::unique_lock<std::mutex> buffer_lock(buffer->mtx);
+    buffer->events.clear();
+    buffer->recorded = 0;
+  }
+}
+
+auto Tracer::GetThreadBuffer() -> ThreadBuffer& {
+  thread_local std::shared_ptr<ThreadBuffer> buffer = [this] {
+    auto new_buffer = std::make_shared<ThreadBuffer>();
+    // Record() runs in the noexcept TraceSpan::Finish(), it must not allocate
+    new_buffer->events.reserve(kEventsPerThread);
+    std::unique_lock<std::mutex> lock(mtx_);
+    buffers_.push_back(new_buffer);
+    return new_buffer;
+  }();
+  return *buffer;
+}
+
+TraceSample::TraceSample() noexcept :
+  was_sampled_(trace_internal::is_sampled) {
+  const auto rate = Tracer::GetInstance().GetSampleRate();
+  trace_internal::is_sampled =
+    rate > 0 &&
+    static_cast<double>(NextRandom() >> 11U) * kUnitScale < rate;
+}
+
+void TraceSpan::Finish() noexcept {
+  const auto now = std::chrono::steady_clock::now();
+  Tracer::GetInstance().Record(
+    {name_, start_, now - start_, arg_name_, arg_value_});
+}
+
+}    // namespace longlp
@@ -0,0 +1,145 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_CORE_TRACE_H_
+#define SRC_CORE_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/no_destructor.h"
+
+namespace longlp {
+
+namespace trace_internal {
+// whether the unit of work running on this thread is sampled, the only thing
+// a span looks at when tracing is off
+inline thread_local bool is_sampled = false;
+// where the thread publishes its innermost span, see DispatchProbe
+inline thread_local std::atomic<const char*>* stage = nullptr;
+}    // namespace trace_internal
+
+// A complete span, names and argument names must be string literals
+struct TraceEvent {
+  const char* name;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::duration duration;
+  // nullptr if the span has no argument
+  const char* arg_name;
+  int64_t arg_value;
+};
+
+// Records the spans of the sampled units of work, e.g. a reactor iteration,
+// into per-thread buffers and writes them in the Chrome trace event format,
+// to be opened in chrome://tracing or Perfetto. Each thread keeps its last
+// kEventsPerThread spans. Thread-safe
+class Tracer {
+ public:
+  static constexpr size_t kEventsPerThread = 16384;
+
+  DISALLOW_COPY_AND_MOVE(Tracer);
+
+  [[nodiscard]] static auto GetInstance() noexcept -> Tracer&;
+
+  // fraction of the units of work traced, from 0 (off, the default) to 1
+  void SetSampleRate(double rate) noexcept;
+
+  [[nodiscard]] auto GetSampleRate() const noexcept -> double {
+    return sample_rate_.load(std::memory_order_relaxed);
+  }
+
+  // the name of the calling thread in the trace, e.g. "reactor 0"
+  void SetThreadName(std::string name);
+
+  // does not allocate once the calling thread has recorded a span
+  void Record(const TraceEvent& event);
+
+  // {"traceEvents":[...]}, the spans of every thread, oldest first
+  void WriteChromeTrace(std::string& out) const;
+
+  // forget every recorded span
+  void Clear();
+
+ private:
+  struct ThreadBuffer;
+  friend class NoDestructor<Tracer>;
+
+  Tracer() = default;
+
+  ~Tracer() = default;
+
+  // the buffer of the calling thread, registered on its first span
+  auto GetThreadBuffer() -> ThreadBuffer&;
+
+  std::atomic<double> sample_rate_ = 0;
+  mutable std::mutex mtx_;
+  // kept after their thread exits so that its spans can still be written
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+};
+
+// Decides whether the unit of work starting on this thread, for as long as
+// the scope lasts, is traced, at the sample rate of the tracer
+class TraceSample {
+ public:
+  TraceSample() noexcept;
+
+  ~TraceSample() { trace_internal::is_sampled = was_sampled_; }
+
+  DISALLOW_COPY_AND_MOVE(TraceSample);
+
+ private:
+  bool was_sampled_;
+};
+
+// Records the scope as a span when the current unit of work is sampled,
+// a thread-local check otherwise. On a reactor it also names the stage
+// reported by the stall detector
+class TraceSpan {
+ public:
+  explicit TraceSpan(
+    const char* name,
+    const char* arg_name = nullptr,
+    int64_t arg_value    = 0) noexcept :
+    name_(name),
+    arg_name_(arg_name),
+    arg_value_(arg_value) {
+    if (trace_internal::stage != nullptr) {
+      outer_stage_ = trace_internal::stage->load(std::memory_order_relaxed);
+      trace_internal::stage->store(name, std::memory_order_relaxed);
+    }
+    if (trace_internal::is_sampled) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~TraceSpan() {
+    if (trace_internal::stage != nullptr) {
+      trace_internal::stage->store(outer_stage_, std::memory_order_relaxed);
+    }
+    if (start_ != std::chrono::steady_clock::time_point{}) {
+      Finish();
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(TraceSpan);
+
+ private:
+  void Finish() noexcept;
+
+  const char* name_;
+  const char* arg_name_;
+  int64_t arg_value_;
+  const char* outer_stage_{nullptr};
+  std::chrono::steady_clock::time_point start_{};
+};
+
+}    // namespace longlp
+
+#endif    // SRC_CORE_TRACE_H_
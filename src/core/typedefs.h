@@ -15,12 +15,21 @@
 namespace longlp {
 class Connection;
 using ConnectionCallback = std::function<void(not_null<Connection*>)>;
+// A handler called through a plain function pointer instantiated for its
+// type, see InvokeHandler, rather than through std::function
+using ConnectionHandlerFn = void (*)(void* handler, not_null<Connection*>);
 
 using Byte               = uint8_t;
 using DynamicByteArray   = std::vector<uint8_t>;
 
 template <size_t Size>
 using FixedByteArray = std::array<Byte, Size>;
+
+// The call to |handler| is resolved at compile time and can be inlined
+template <typename Handler>
+void InvokeHandler(void* handler, not_null<Connection*> connection) {
+  (*static_cast<Handler*>(handler))(connection);
+}
 }    // namespace longlp
 
 #endif    // SRC_CORE_TYPEDEFS_H_
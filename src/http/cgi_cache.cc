@@ -0,0 +1,122 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/cgi_cache.h"
+
+#include <utility>
+
+#include "core/cache.h"
+#include "http/cgi_runner.h"
+
+namespace longlp::http {
+
+namespace {
+// keeps the cgi outputs apart from the files sharing the cache
+constexpr std::string_view kKeyPrefix = "cgi:";
+}    // namespace
+
+CGICache::Flight::Flight(
+  not_null<CGICache*> owner,
+  std::string key,
+  std::chrono::milliseconds ttl) :
+  owner_(owner),
+  key_(std::move(key)),
+  ttl_(ttl) {}
+
+CGICache::Flight::~Flight() {
+  if (!done_) {
+    owner_->Publish(key_, nullptr);
+  }
+}
+
+void CGICache::Flight::Append(const Byte* data, size_t size) {
+  if (overflow_) {
+    return;
+  }
+  if (output_.size() + size > owner_->cache_->GetCapacity()) {
+    overflow_ = true;
+    output_   = DynamicByteArray();
+    return;
+  }
+  output_.insert(output_.end(), data, data + size);
+}
+
+void CGICache::Flight::Commit() {
+  done_ = true;
+  if (overflow_) {
+    owner_->Publish(key_, nullptr);
+    return;
+  }
+  std::ignore = owner_->cache_->TryInsert(key_, output_, ttl_);
+  owner_->Publish(
+    key_,
+    std::make_shared<const DynamicByteArray>(std::move(output_)));
+}
+
+CGICache::CGICache(std::shared_ptr<Cache> cache, Options options) :
+  cache_(std::move(cache)),
+  options_(std::move(options)) {}
+
+auto CGICache::Join(
+  const CGIRunner& runner,
+  DynamicByteArray& destination,
+  OutputCallback on_output) -> Ticket {
+  const auto ttl = GetTTL(runner.GetPath());
+  if (ttl <= std::chrono::milliseconds::zero()) {
+    return {Outcome::kBypass, nullptr};
+  }
+
+  auto key = MakeKey(runner);
+  // the lookup and the flight check are atomic, a flight is published to the
+  // cache before it is landed, so a program never runs twice concurrently
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (cache_->TryLoad(key, destination)) {
+    return {Outcome::kHit, nullptr};
+  }
+  if (auto flight = flights_.find(key); flight != flights_.end()) {
+    flight->second.push_back(std::move(on_output));
+    return {Outcome::kFollower, nullptr};
+  }
+  flights_.emplace(key, std::vector<OutputCallback>{});
+  return {
+    Outcome::kLeader,
+    std::make_unique<Flight>(this, std::move(key), ttl)};
+}
+
+auto CGICache::GetTTL(const std::string& program_path) const
+  -> std::chrono::milliseconds {
+  if (const auto ttl = options_.program_ttls.find(program_path);
+      ttl != options_.program_ttls.end()) {
+    return ttl->second;
+  }
+  return options_.default_ttl;
+}
+
+// static
+auto CGICache::MakeKey(const CGIRunner& runner) -> std::string {
+  // '\0' cannot appear in the program path nor in the arguments
+  std::string key{kKeyPrefix};
+  key += runner.GetPath();
+  for (const auto& argument : runner.GetArguments()) {
+    key += '\0';
+    key += argument;
+  }
+  return key;
+}
+
+void CGICache::Publish(const std::string& key, Output output) {
+  std::vector<OutputCallback> waiters;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (auto flight = flights_.find(key); flight != flights_.end()) {
+      waiters = std::move(flight->second);
+      flights_.erase(flight);
+    }
+  }
+  for (auto& on_output : waiters) {
+    on_output(output);
+  }
+}
+
+}    // namespace longlp::http
@@ -0,0 +1,122 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_HTTP_CGI_CACHE_H_
+#define SRC_HTTP_CGI_CACHE_H_
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/pointers.h"
+#include "core/typedefs.h"
+
+namespace longlp {
+class Cache;
+}    // namespace longlp
+
+namespace longlp::http {
+
+class CGIRunner;
+
+// Opt-in cache of cgi outputs for deterministic programs, keyed on the program
+// path and its arguments. The outputs live in the shared Cache with a time to
+// live configured per program, so they are bounded by its capacity.
+//
+// Concurrent identical requests are coalesced: the first one leads a flight
+// and runs the program, the others wait for its output instead of running the
+// program again.
+// Thread-safe
+class CGICache {
+ public:
+  struct Options {
+    // time to live of the programs not listed below, zero disables caching
+    std::chrono::milliseconds default_ttl{0};
+    // per program time to live, keyed on the program path
+    std::unordered_map<std::string, std::chrono::milliseconds> program_ttls;
+  };
+
+  // the output of the flight leader, nullptr if it could not be cached
+  using Output         = std::shared_ptr<const DynamicByteArray>;
+  using OutputCallback = std::function<void(Output)>;
+
+  // The program run of a flight leader, its output is recorded then published
+  // to the cache and the waiters by Commit(). A flight destroyed without being
+  // committed is abandoned, the waiters are then told to run the program
+  class Flight {
+   public:
+    Flight(
+      not_null<CGICache*> owner,
+      std::string key,
+      std::chrono::milliseconds ttl);
+
+    ~Flight();
+
+    DISALLOW_COPY_AND_MOVE(Flight);
+
+    void Append(const Byte* data, size_t size);
+
+    void Commit();
+
+   private:
+    not_null<CGICache*> owner_;
+    std::string key_;
+    std::chrono::milliseconds ttl_;
+    DynamicByteArray output_;
+    // the output outgrew the cache, it will not be published
+    bool overflow_{false};
+    bool done_{false};
+  };
+
+  enum class Outcome {
+    // the program is not cached
+    kBypass,
+    // the output is loaded from the cache
+    kHit,
+    // the caller runs the program and records the output in the flight
+    kLeader,
+    // the callback is invoked with the output of the running flight
+    kFollower,
+  };
+
+  struct Ticket {
+    Outcome outcome;
+    // only for kLeader
+    std::unique_ptr<Flight> flight;
+  };
+
+  CGICache(std::shared_ptr<Cache> cache, Options options);
+
+  DISALLOW_COPY_AND_MOVE(CGICache);
+
+  // |on_output| is only kept for kFollower, it is invoked from the thread of
+  // the leader
+  [[nodiscard]] auto Join(
+    const CGIRunner& runner,
+    DynamicByteArray& destination,
+    OutputCallback on_output) -> Ticket;
+
+  [[nodiscard]] auto GetTTL(const std::string& program_path) const
+    -> std::chrono::milliseconds;
+
+  [[nodiscard]] static auto MakeKey(const CGIRunner& runner) -> std::string;
+
+ private:
+  void Publish(const std::string& key, Output output);
+
+  std::shared_ptr<Cache> cache_;
+  Options options_;
+  std::mutex mtx_;
+  // key of the running flights to their waiters
+  std::unordered_map<std::string, std::vector<OutputCallback>> flights_;
+};
+
+}    // namespace longlp::http
+
+#endif    // SRC_HTTP_CGI_CACHE_H_
@@ -0,0 +1,99 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/cgi_limiter.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/chrono.h"
+#include "core/metrics.h"
+
+namespace longlp::http {
+
+CGILimiter::CGILimiter(Options options) :
+  options_(options),
+  wait_metric_(MetricsRegistry::GetInstance().GetHistogram(
+    "longlp_cgi_queue_wait_seconds",
+    "Time a queued cgi request waited for a slot")) {}
+
+auto CGILimiter::TryAcquire(
+  const std::string& program_path,
+  ReadyCallback on_ready) -> Admission {
+  std::unique_lock<std::mutex> lock(mtx_);
+  // Release() hands the slots over to every waiter which fits, so a newcomer
+  // fitting now does not overtake a waiter of its own program
+  if (HasSlot(program_path)) {
+    TakeSlot(program_path);
+    ++stats_.admitted_total;
+    return Admission::kAdmitted;
+  }
+  if (queue_.size() >= options_.max_queued) {
+    ++stats_.rejected_total;
+    return Admission::kRejected;
+  }
+  queue_.push_back(
+    {program_path, std::move(on_ready), std::chrono::steady_clock::now()});
+  ++stats_.queued_total;
+  return Admission::kQueued;
+}
+
+void CGILimiter::Release(const std::string& program_path) {
+  std::vector<ReadyCallback> ready;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    --running_;
+    if (auto it = running_per_program_.find(program_path);
+        it != running_per_program_.end() && --it->second == 0) {
+      running_per_program_.erase(it);
+    }
+
+    // the oldest waiters which fit, a busy program does not block the others
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = queue_.begin();
+         it != queue_.end() && running_ < options_.max_running;) {
+      if (!HasSlot(it->program_path)) {
+        ++it;
+        continue;
+      }
+      TakeSlot(it->program_path);
+      ++stats_.admitted_total;
+      const std::chrono::nanoseconds waited = now - it->since;
+      stats_.wait_total += waited;
+      stats_.wait_max = std::max(stats_.wait_max, waited);
+      wait_metric_.Observe(duration_cast<microseconds>(waited));
+      ready.push_back(std::move(it->on_ready));
+      it = queue_.erase(it);
+    }
+  }
+  // outside the lock, the callback may well acquire again
+  for (auto& on_ready : ready) {
+    on_ready();
+  }
+}
+
+auto CGILimiter::GetStats() -> Stats {
+  std::unique_lock<std::mutex> lock(mtx_);
+  Stats stats   = stats_;
+  stats.running = running_;
+  stats.queued  = queue_.size();
+  return stats;
+}
+
+auto CGILimiter::HasSlot(const std::string& program_path) const -> bool {
+  if (running_ >= options_.max_running) {
+    return false;
+  }
+  const auto it = running_per_program_.find(program_path);
+  return it == running_per_program_.end() ||
+         it->second < options_.max_running_per_program;
+}
+
+void CGILimiter::TakeSlot(const std::string& program_path) {
+  ++running_;
+  ++running_per_program_[program_path];
+}
+
+}    // namespace longlp::http
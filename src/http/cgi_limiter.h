@@ -0,0 +1,113 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_HTTP_CGI_LIMITER_H_
+#define SRC_HTTP_CGI_LIMITER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "base/macros.h"
+
+namespace longlp {
+class Histogram;
+}    // namespace longlp
+
+namespace longlp::http {
+
+// Bound the number of cgi programs running at once, both overall and per
+// program. A request over the limits waits in a bounded FIFO queue and is
+// rejected once the queue is full, so that an overload turns into fast 503
+// responses instead of hundreds of forked processes.
+// Thread-safe
+class CGILimiter {
+ public:
+  static constexpr size_t kDefaultMaxRunning           = 64U;
+  static constexpr size_t kDefaultMaxRunningPerProgram = 16U;
+  static constexpr size_t kDefaultMaxQueued            = 128U;
+  static constexpr std::chrono::seconds kDefaultRetryAfter{1};
+
+  struct Options {
+    // max cgi programs running at once, all programs together
+    size_t max_running = kDefaultMaxRunning;
+    // max instances of a single cgi program running at once
+    size_t max_running_per_program = kDefaultMaxRunningPerProgram;
+    // max requests waiting for a slot, further ones are rejected
+    size_t max_queued = kDefaultMaxQueued;
+    // hint for the rejected clients, see 'Retry-After'
+    std::chrono::seconds retry_after = kDefaultRetryAfter;
+  };
+
+  enum class Admission {
+    // a slot is taken, the program may run now
+    kAdmitted,
+    // the callback is invoked once a slot is taken on behalf of the request
+    kQueued,
+    // over the limits and the queue is full
+    kRejected,
+  };
+
+  struct Stats {
+    size_t running{0};
+    size_t queued{0};
+    uint64_t admitted_total{0};
+    uint64_t queued_total{0};
+    uint64_t rejected_total{0};
+    // time spent in the queue by the requests dispatched from it
+    std::chrono::nanoseconds wait_total{0};
+    std::chrono::nanoseconds wait_max{0};
+  };
+
+  // invoked from the thread calling Release(), with the slot already taken
+  using ReadyCallback = std::function<void()>;
+
+  explicit CGILimiter(Options options);
+
+  DISALLOW_COPY_AND_MOVE(CGILimiter);
+
+  // Take a slot for the program or queue the request. |on_ready| is only kept
+  // when kQueued is returned
+  [[nodiscard]] auto
+  TryAcquire(const std::string& program_path, ReadyCallback on_ready)
+    -> Admission;
+
+  // Give the slot back, the oldest queued request which fits the limits takes
+  // it over
+  void Release(const std::string& program_path);
+
+  [[nodiscard]] auto GetStats() -> Stats;
+
+  [[nodiscard]] auto GetRetryAfter() const noexcept -> std::chrono::seconds {
+    return options_.retry_after;
+  }
+
+ private:
+  struct Waiter {
+    std::string program_path;
+    ReadyCallback on_ready;
+    std::chrono::steady_clock::time_point since;
+  };
+
+  [[nodiscard]] auto HasSlot(const std::string& program_path) const -> bool;
+
+  void TakeSlot(const std::string& program_path);
+
+  Options options_;
+  std::mutex mtx_;
+  size_t running_{0};
+  std::unordered_map<std::string, size_t> running_per_program_;
+  std::deque<Waiter> queue_;
+  Stats stats_;
+  // time spent in the queue, observed when a waiter is admitted
+  Histogram& wait_metric_;
+};
+
+}    // namespace longlp::http
+
+#endif    // SRC_HTTP_CGI_LIMITER_H_
@@ -5,26 +5,62 @@
 #include "http/cgi_runner.h"
 
 #include <fcntl.h>
+#include <spawn.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <unistd.h>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <sstream>
 #include <string_view>
-#include <thread>
 
 #include <fmt/format.h>
-#include <fmt/std.h>
 
+#include "base/macros.h"
 #include "base/pointers.h"
+#include "base/utils.h"
+#include "core/connection.h"
+#include "core/looper.h"
+#include "core/metrics.h"
+#include "core/poller.h"
+#include "core/socket.h"
+#include "core/trace.h"
 #include "http/constants.h"
 #include "http/http_utils.h"
+#include "log/logger.h"
 
 namespace longlp::http {
 
 namespace {
 
+struct CGIMetrics {
+  Counter& spawned;
+  Counter& spawn_failures;
+  Histogram& duration;
+};
+
+auto GetCGIMetrics() -> CGIMetrics& {
+  auto& registry = MetricsRegistry::GetInstance();
+  static CGIMetrics metrics{
+    registry.GetCounter("longlp_cgi_spawned_total", "Cgi programs spawned"),
+    registry.GetCounter(
+      "longlp_cgi_spawn_failures_total",
+      "Cgi programs which could not be spawned"),
+    registry.GetHistogram(
+      "longlp_cgi_duration_seconds",
+      "Time from the spawn of a cgi program to its exit")};
+  return metrics;
+}
+
+void ObserveDuration(std::chrono::steady_clock::time_point started) {
+  GetCGIMetrics().duration.Observe(
+    duration_cast<microseconds>(std::chrono::steady_clock::now() - started));
+}
+
 auto BuildArgv(
   const std::vector<std::string>& cgi_arguments,
   const std::string_view cgi_program_path) -> owner<char**> {
@@ -60,6 +96,131 @@ void DeleteArgv(owner<char**> argv, size_t size) {
   delete argv;
 }
 
+// read size of the synchronous capture loop
+constexpr size_t kPipeChunkSize = 4096;
+
+// Start the program with its stdout redirected to output_fd.
+// Return -1 if it cannot be spawned
+auto SpawnWithOutput(
+  const std::string& cgi_program_path,
+  const std::vector<std::string>& cgi_arguments,
+  int output_fd) -> pid_t {
+  const TraceSpan span{"CGISpawn"};
+  // posix_spawn() vforks, cheap even for a server with a large cache
+  posix_spawn_file_actions_t actions{};
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, output_fd, STDOUT_FILENO);
+  owner<char**> argv = BuildArgv(cgi_arguments, cgi_program_path);
+  std::array<char*, 1> envp{nullptr};
+
+  pid_t pid{};
+  const auto error = posix_spawn(
+    &pid,
+    cgi_program_path.c_str(),
+    &actions,
+    nullptr,
+    argv,
+    envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  DeleteArgv(argv, cgi_arguments.size() + 2U);
+  if (error != 0) {
+    Log<LogLevel::kError>(
+      "CGIRunner: fail to spawn {}: {}",
+      cgi_program_path,
+      std::strerror(error));
+    GetCGIMetrics().spawn_failures.Increment();
+    return -1;
+  }
+  GetCGIMetrics().spawned.Increment();
+  return pid;
+}
+
+auto OpenPidFd(pid_t pid) noexcept -> int {
+  // no glibc wrapper before 2.36
+  return narrow_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+// The state of one asynchronous cgi child, shared by the callbacks of its
+// output pipe and pidfd connections, all running on the same looper thread
+class AsyncCGISession {
+ public:
+  DISALLOW_COPY_AND_MOVE(AsyncCGISession);
+
+  AsyncCGISession(
+    pid_t pid,
+    not_null<Looper*> looper,
+    CGIRunner::OutputCallback on_output,
+    CGIRunner::ExitCallback on_exit) :
+    pid_(pid),
+    looper_(looper),
+    on_output_(std::move(on_output)),
+    on_exit_(std::move(on_exit)) {}
+
+  void SetOutputConnection(Connection* output) noexcept { output_ = output; }
+
+  void SetExitConnection(int fd) noexcept { exit_fd_ = fd; }
+
+  // pipe readable: forward what is available, on EOF stop watching it
+  void OnOutput(not_null<Connection*> output) {
+    const TraceSpan span{"CGIOutput", "pid", pid_};
+    auto [read, closed] = output->Receive();
+    if (output->GetReadSize() > 0) {
+      on_output_(output->ReadData(), output->GetReadSize());
+      output->ClearReadBuffer();
+    }
+    if (!closed) {
+      return;
+    }
+    std::ignore = looper_->DeleteConnection(output->GetFd());
+    output_     = nullptr;
+    // without pidfd, EOF on stdout is the sign of the child exit
+    if (exit_fd_ == -1) {
+      int status{};
+      waitpid(pid_, &status, 0);
+      Finish(status);
+    }
+  }
+
+  // pidfd readable: the child has terminated
+  void OnExit() {
+    int status{};
+    if (waitpid(pid_, &status, WNOHANG) <= 0) {
+      return;
+    }
+    // whatever is left in the pipe was written before the exit, do not wait
+    // for EOF in case a grandchild still holds the write end
+    if (output_ != nullptr) {
+      OnOutput(output_);
+    }
+    if (output_ != nullptr) {
+      std::ignore = looper_->DeleteConnection(output_->GetFd());
+      output_     = nullptr;
+    }
+    std::ignore = looper_->DeleteConnection(exit_fd_);
+    Finish(status);
+  }
+
+ private:
+  void Finish(int status) {
+    ObserveDuration(started_);
+    if (on_exit_) {
+      auto on_exit = std::move(on_exit_);
+      on_exit_     = nullptr;
+      on_exit(status);
+    }
+  }
+
+  pid_t pid_;
+  not_null<Looper*> looper_;
+  // owned by the looper, nullptr once deleted from it
+  Connection* output_{nullptr};
+  int exit_fd_{-1};
+  CGIRunner::OutputCallback on_output_;
+  CGIRunner::ExitCallback on_exit_;
+  std::chrono::steady_clock::time_point started_{
+    std::chrono::steady_clock::now()};
+};
+
 }    // namespace
 
 // static
@@ -92,64 +253,99 @@ CGIRunner::CGIRunner(
 
 auto CGIRunner::Run() -> DynamicByteArray {
   assert(valid_);
-  DynamicByteArray cgi_result;
-  // unique shared filename within one CGIRunner
-  // when communicating between parent and child
-  const auto shared_file_name = fmt::format(
-    "{cgi_prefix}{underscore}{thread_id}.txt",
-    fmt::arg("cgi_prefix", kCGIPrefix),
-    fmt::arg("underscore", kUnderscore),
-    fmt::arg("thread_id", std::this_thread::get_id()));
-
-  int fd = open(
-    shared_file_name.c_str(),
-    O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC,
-    kReadWritePermission);
-  if (fd == -1) {
-    const auto error =
-      fmt::format("fail to create/open the file {}", shared_file_name);
+  const TraceSpan span{"CGI"};
+  // the output is captured in memory, no temporary file involved
+  std::array<int, 2> pipe_fds{};
+  if (pipe2(pipe_fds.data(), O_CLOEXEC) == -1) {
+    constexpr std::string_view error = "fail to create pipe()";
     return {error.begin(), error.end()};
   }
-  pid_t pid = fork();
+  const auto started = std::chrono::steady_clock::now();
+  const auto pid =
+    SpawnWithOutput(cgi_program_path_, cgi_arguments_, pipe_fds[1]);
+  close(pipe_fds[1]);
   if (pid == -1) {
-    constexpr std::string_view error = "fail to fork()";
+    close(pipe_fds[0]);
+    constexpr std::string_view error = "fail to spawn the cgi program";
     return {error.begin(), error.end()};
   }
 
-  if (pid == 0) {
-    // child
+  // drain until EOF before harvesting, the child blocks on a full pipe
+  DynamicByteArray cgi_result;
+  FixedByteArray<kPipeChunkSize> buf{};
+  while (true) {
+    const auto curr_read = read(pipe_fds[0], buf.data(), buf.size());
+    if (curr_read > 0) {
+      cgi_result.insert(cgi_result.end(), buf.begin(), buf.begin() + curr_read);
+      continue;
+    }
+    if (curr_read == -1 && errno == EINTR) {
+      continue;
+    }
+    break;
+  }
+  close(pipe_fds[0]);
 
-    // link cgi program's stdout to the shared file
-    dup2(fd, STDOUT_FILENO);
-    close(fd);
+  int status{};
+  // wait and harvest child process
+  if (waitpid(pid, &status, 0) == -1) {
+    std::string error = "fail to harvest child by waitpid()";
+    return {error.begin(), error.end()};
+  }
+  ObserveDuration(started);
+  return cgi_result;
+}
 
-    owner<char**> argv = BuildArgv(cgi_arguments_, cgi_program_path_);
+auto CGIRunner::RunAsync(
+  not_null<Looper*> looper,
+  OutputCallback on_output,
+  ExitCallback on_exit) const -> bool {
+  assert(valid_);
+  std::array<int, 2> pipe_fds{};
+  if (pipe2(pipe_fds.data(), O_CLOEXEC) == -1) {
+    Log<LogLevel::kError>("CGIRunner: pipe2() error");
+    return false;
+  }
 
-    // walk into cgi program
-    if (execve(cgi_program_path_.c_str(), argv, nullptr) < 0) {
-      // only reach here when execve fails
-      perror("fail to execve()");
-      DeleteArgv(argv, cgi_arguments_.size() + 2U);
-      // TODO(longlp): not thread-safe
-      std::exit(EXIT_FAILURE);    // exit child process
-    }
+  const auto pid =
+    SpawnWithOutput(cgi_program_path_, cgi_arguments_, pipe_fds[1]);
+  close(pipe_fds[1]);
+  if (pid == -1) {
+    close(pipe_fds[0]);
+    return false;
   }
-  else {
-    // parent
-    close(fd);
-    int status{};
-    // wait and harvest child process
-    if (waitpid(pid, &status, 0) == -1) {
-      std::string error = "fail to harvest child by waitpid()";
-      return {error.begin(), error.end()};
-    }
-    // load cgi result from the shared file
-    LoadFile(shared_file_name, cgi_result);
-    // clean it up by deleting shared file
-    // TODO(longlp): check for return value
-    std::ignore = DeleteFile(shared_file_name);
+
+  auto session = std::make_shared<AsyncCGISession>(
+    pid,
+    looper,
+    std::move(on_output),
+    std::move(on_exit));
+
+  // the write end stays blocking for the child, only our end is non-blocking
+  auto output_socket = std::make_unique<Socket>(pipe_fds[0]);
+  output_socket->SetNonBlocking();
+  auto output = std::make_unique<Connection>(std::move(output_socket));
+  output->SetEvents(Poller::Event::kRead | Poller::Event::kET);
+  output->SetCallback([session](not_null<Connection*> connection) {
+    session->OnOutput(connection);
+  });
+  output->SetLooper(looper);
+  session->SetOutputConnection(output.get());
+
+  // pidfd needs Linux 5.3, otherwise fall back to EOF on the pipe
+  if (const auto pid_fd = OpenPidFd(pid); pid_fd != -1) {
+    auto exit_watcher =
+      std::make_unique<Connection>(std::make_unique<Socket>(pid_fd));
+    exit_watcher->SetEvents(Poller::Event::kRead);
+    exit_watcher->SetCallback([session](not_null<Connection*>) {
+      session->OnExit();
+    });
+    exit_watcher->SetLooper(looper);
+    session->SetExitConnection(pid_fd);
+    looper->AddConnection(std::move(exit_watcher));
   }
-  return cgi_result;
+  looper->AddConnection(std::move(output));
+  return true;
 }
 
 }    // namespace longlp::http
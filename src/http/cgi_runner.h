@@ -5,23 +5,34 @@
 #ifndef SRC_HTTP_CGI_RUNNER_H_
 #define SRC_HTTP_CGI_RUNNER_H_
 
+#include <functional>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "base/macros.h"
+#include "base/pointers.h"
 #include "core/typedefs.h"
 
+namespace longlp {
+class Looper;
+}    // namespace longlp
+
 namespace longlp::http {
 
-// This CGIRunner runs a client commanded program through traditional 'fork' +
-// 'execve'
+// This CGIRunner runs a client commanded program through 'posix_spawn'
 // All the cgi program should reside in a '/cgi-bin' folder in the root
-// directory of the http serving directory parent and child process communicate
-// through a file, where child writes the output to it and parent read it out
-// afterwards
+// directory of the http serving directory. The child stdout is a pipe, Run()
+// drains it until EOF and then harvests the child
+// RunAsync() is the non-blocking alternative for a reactor thread
 class CGIRunner {
  public:
+  // a chunk of the cgi program stdout
+  using OutputCallback = std::function<void(const Byte* data, size_t size)>;
+  // the child is harvested and all its output delivered, with the waitpid()
+  // status
+  using ExitCallback = std::function<void(int status)>;
+
   [[nodiscard]] static auto
   ParseCGIRunner(std::string_view resource_url) noexcept -> CGIRunner;
   [[nodiscard]] static auto MakeInvalidCGIRunner() noexcept -> CGIRunner;
@@ -32,12 +43,27 @@ class CGIRunner {
 
   [[nodiscard]] auto Run() -> DynamicByteArray;
 
+  // Spawn the program with posix_spawn() and return right away. Its stdout is
+  // captured through a non-blocking pipe and its exit tracked through a
+  // pidfd, both registered in the |looper| Poller, so |on_output| and then
+  // |on_exit| are called from the event loop of |looper|.
+  // Return false if the program could not be spawned, no callback is called
+  [[nodiscard]] auto RunAsync(
+    not_null<Looper*> looper,
+    OutputCallback on_output,
+    ExitCallback on_exit) const -> bool;
+
   [[nodiscard]] auto IsValid() const noexcept -> bool { return valid_; }
 
   [[nodiscard]] auto GetPath() const noexcept -> std::string {
     return cgi_program_path_;
   }
 
+  [[nodiscard]] auto GetArguments() const noexcept
+    -> const std::vector<std::string>& {
+    return cgi_arguments_;
+  }
+
  private:
   std::string cgi_program_path_;
   std::vector<std::string> cgi_arguments_;
@@ -0,0 +1,396 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/cgi_worker_pool.h"
+
+#include <arpa/inet.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "base/utils.h"
+#include "core/connection.h"
+#include "core/looper.h"
+#include "core/poller.h"
+#include "core/socket.h"
+#include "core/trace.h"
+#include "http/cgi_runner.h"
+#include "http/constants.h"
+#include "log/logger.h"
+
+namespace longlp::http {
+
+namespace {
+constexpr size_t kFrameHeaderSize = sizeof(uint32_t);
+
+auto OpenPidFd(pid_t pid) noexcept -> int {
+  // no glibc wrapper before 2.36
+  return narrow_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+// Harvest |pid| once it exits from the event loop of |looper|, through a
+// pidfd, or right away if pidfd is not supported
+void ReapFromLooper(pid_t pid, not_null<Looper*> looper) {
+  const auto pid_fd = OpenPidFd(pid);
+  if (pid_fd == -1) {
+    waitpid(pid, nullptr, 0);
+    return;
+  }
+  auto exit_watcher =
+    std::make_unique<Connection>(std::make_unique<Socket>(pid_fd));
+  exit_watcher->SetEvents(Poller::Event::kRead);
+  exit_watcher->SetCallback([pid, looper](not_null<Connection*> watcher) {
+    if (waitpid(pid, nullptr, WNOHANG) != 0) {
+      std::ignore = looper->DeleteConnection(watcher->GetFd());
+    }
+  });
+  exit_watcher->SetLooper(looper);
+  looper->AddConnection(std::move(exit_watcher));
+}
+}    // namespace
+
+// One running cgi program speaking the frame protocol over a socket watched
+// by the Poller of |looper_|, along with a timerfd bounding each request.
+// Only used from the thread of |looper_|
+class CGIWorkerPool::Worker : public std::enable_shared_from_this<Worker> {
+ public:
+  [[nodiscard]] static auto Spawn(
+    CGIWorkerPool& pool,
+    const std::string& program_path,
+    not_null<Looper*> looper) -> std::shared_ptr<Worker> {
+    std::array<int, 2> fds{};
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds.data()) == -1) {
+      Log<LogLevel::kError>("CGIWorkerPool: socketpair() error");
+      return nullptr;
+    }
+    const int timer_fd =
+      timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+      Log<LogLevel::kError>("CGIWorkerPool: timerfd_create() error");
+      close(fds[0]);
+      close(fds[1]);
+      return nullptr;
+    }
+
+    // the child end becomes both stdin and stdout, dup2() clears CLOEXEC on
+    // the duplicates while the originals are closed on exec
+    posix_spawn_file_actions_t actions{};
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+
+    std::array<char*, 2> argv{const_cast<char*>(program_path.c_str()), nullptr};
+    std::array<char*, 2> envp{const_cast<char*>(kCGIPersistentEnv), nullptr};
+
+    pid_t pid{};
+    const auto error = posix_spawn(
+      &pid,
+      program_path.c_str(),
+      &actions,
+      nullptr,
+      argv.data(),
+      envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (error != 0) {
+      Log<LogLevel::kError>(
+        "CGIWorkerPool: fail to spawn {}: {}",
+        program_path,
+        std::strerror(error));
+      close(fds[0]);
+      close(timer_fd);
+      return nullptr;
+    }
+
+    auto worker =
+      std::make_shared<Worker>(pool, program_path, pid, looper, fds[0]);
+    worker->timer_fd_ = timer_fd;
+    // the worker is owned by its connections until retired
+    auto socket = std::make_unique<Socket>(fds[0]);
+    socket->SetNonBlocking();
+    auto connection = std::make_unique<Connection>(std::move(socket));
+    connection->SetEvents(Poller::Event::kRead | Poller::Event::kET);
+    connection->SetCallback([worker](not_null<Connection*> self) {
+      worker->OnReadable(self);
+    });
+    connection->SetLooper(looper);
+    auto timer =
+      std::make_unique<Connection>(std::make_unique<Socket>(timer_fd));
+    timer->SetEvents(Poller::Event::kRead);
+    timer->SetCallback([worker](not_null<Connection*> /* timer */) {
+      worker->OnTimer();
+    });
+    timer->SetLooper(looper);
+    looper->AddConnection(std::move(connection));
+    looper->AddConnection(std::move(timer));
+    return worker;
+  }
+
+  Worker(
+    CGIWorkerPool& pool,
+    std::string program_path,
+    pid_t pid,
+    not_null<Looper*> looper,
+    int fd) :
+    pool_(pool),
+    program_path_(std::move(program_path)),
+    pid_(pid),
+    looper_(looper),
+    fd_(fd) {}
+
+  ~Worker() {
+    // at shutdown, the looper is gone along with the sockets
+    if (!retired_) {
+      kill(pid_, SIGTERM);
+      waitpid(pid_, nullptr, 0);
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(Worker);
+
+  // Send the request frame, |on_done| is kept until the response frame.
+  // Return false if the frame cannot be sent at once, the worker is broken
+  [[nodiscard]] auto Serve(
+    const std::vector<std::string>& arguments,
+    DoneCallback&& on_done) -> bool {
+    ++served_;
+
+    // [length][arg0 '\0' arg1 '\0' ...]
+    DynamicByteArray request(kFrameHeaderSize);
+    for (const auto& argument : arguments) {
+      request.insert(request.end(), argument.begin(), argument.end());
+      request.push_back(0);
+    }
+    const uint32_t request_size =
+      htonl(narrow_cast<uint32_t>(request.size() - kFrameHeaderSize));
+    std::memcpy(request.data(), &request_size, kFrameHeaderSize);
+    // an idle worker has read all its requests, the socket buffer takes a
+    // whole frame of arguments. MSG_NOSIGNAL, a dead worker must not SIGPIPE
+    // the server
+    const auto sent = send(
+      fd_,
+      request.data(),
+      request.size(),
+      MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent != narrow_cast<ssize_t>(request.size())) {
+      return false;
+    }
+    on_done_ = std::move(on_done);
+    ArmTimer(pool_.options_.timeout);
+    return true;
+  }
+
+  // recycled, its sockets are deleted from the looper and the program left
+  // to exit on EOF
+  void Retire() {
+    if (retired_) {
+      return;
+    }
+    retired_ = true;
+    pool_.Forget(*this);
+    std::ignore = looper_->DeleteConnection(fd_);
+    std::ignore = looper_->DeleteConnection(timer_fd_);
+    kill(pid_, SIGTERM);
+    ReapFromLooper(pid_, looper_);
+  }
+
+  [[nodiscard]] auto GetServed() const noexcept -> size_t { return served_; }
+
+  [[nodiscard]] auto GetProgramPath() const noexcept -> const std::string& {
+    return program_path_;
+  }
+
+  [[nodiscard]] auto GetLooper() const noexcept -> Looper* { return looper_; }
+
+ private:
+  void OnReadable(not_null<Connection*> connection) {
+    const TraceSpan span{"CGIWorker", "pid", pid_};
+    const auto [read, closed] = connection->Receive();
+    // bytes nobody asked for, or the program exited while idle
+    if (on_done_ == nullptr) {
+      Log<LogLevel::kWarning>(
+        "CGIWorkerPool: idle worker of {} misbehaved",
+        program_path_);
+      Fail();
+      return;
+    }
+    const auto received = connection->GetReadSize();
+    if (received >= kFrameHeaderSize) {
+      uint32_t response_size{};
+      std::memcpy(&response_size, connection->ReadData(), kFrameHeaderSize);
+      response_size = ntohl(response_size);
+      // e.g. the plain output of a program not speaking the frame protocol
+      if (response_size > pool_.options_.max_frame_size) {
+        Log<LogLevel::kWarning>(
+          "CGIWorkerPool: response frame of {} bytes over the limit of {}",
+          response_size,
+          pool_.options_.max_frame_size);
+        Fail();
+        return;
+      }
+      const auto frame_size = kFrameHeaderSize + response_size;
+      if (received > frame_size) {
+        Log<LogLevel::kWarning>(
+          "CGIWorkerPool: worker of {} answered more than a frame",
+          program_path_);
+        Fail();
+        return;
+      }
+      if (received == frame_size) {
+        const auto* payload = connection->ReadData() + kFrameHeaderSize;
+        DynamicByteArray output(payload, payload + response_size);
+        connection->ClearReadBuffer();
+        Complete(std::move(output));
+        return;
+      }
+    }
+    if (closed) {
+      Log<LogLevel::kWarning>(
+        "CGIWorkerPool: worker of {} exited in a request",
+        program_path_);
+      Fail();
+    }
+  }
+
+  void OnTimer() {
+    uint64_t expirations{};
+    std::ignore = read(timer_fd_, &expirations, sizeof(expirations));
+    if (on_done_ == nullptr) {
+      return;
+    }
+    Log<LogLevel::kWarning>(
+      "CGIWorkerPool: worker of {} did not answer in time",
+      program_path_);
+    Fail();
+  }
+
+  void Complete(DynamicByteArray output) {
+    ArmTimer(std::chrono::milliseconds{0});
+    auto on_done = std::move(on_done_);
+    on_done_     = nullptr;
+    pool_.Release(shared_from_this());
+    on_done(std::move(output));
+  }
+
+  void Fail() {
+    auto on_done = std::move(on_done_);
+    on_done_     = nullptr;
+    Retire();
+    if (on_done) {
+      on_done(std::nullopt);
+    }
+  }
+
+  // a zero |timeout| disarms the timer
+  void ArmTimer(std::chrono::milliseconds timeout) const {
+    const auto seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    itimerspec expiry{};
+    expiry.it_value.tv_sec  = seconds.count();
+    expiry.it_value.tv_nsec =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds)
+        .count();
+    std::ignore = timerfd_settime(timer_fd_, 0, &expiry, nullptr);
+  }
+
+  CGIWorkerPool& pool_;
+  std::string program_path_;
+  pid_t pid_;
+  not_null<Looper*> looper_;
+  // both owned by connections of |looper_|
+  int fd_;
+  int timer_fd_{-1};
+  // the request in progress, nullptr while idle
+  DoneCallback on_done_{nullptr};
+  size_t served_{0};
+  bool retired_{false};
+};
+
+CGIWorkerPool::CGIWorkerPool(Options options) :
+  options_(options) {}
+
+CGIWorkerPool::~CGIWorkerPool() = default;
+
+auto CGIWorkerPool::RunAsync(
+  const CGIRunner& runner,
+  not_null<Looper*> looper,
+  DoneCallback on_done) -> bool {
+  const TraceSpan span{"CGIWorker"};
+  auto worker = Acquire(runner.GetPath(), looper);
+  if (worker == nullptr) {
+    return false;
+  }
+  if (!worker->Serve(runner.GetArguments(), std::move(on_done))) {
+    Log<LogLevel::kWarning>(
+      "CGIWorkerPool: worker of {} failed",
+      runner.GetPath());
+    worker->Retire();
+    return false;
+  }
+  return true;
+}
+
+auto CGIWorkerPool::Acquire(
+  const std::string& program_path,
+  not_null<Looper*> looper) -> std::shared_ptr<Worker> {
+  std::unique_lock<std::mutex> lock(mtx_);
+  // node-based map, the reference survives rehashing
+  auto& program = programs_[program_path];
+  if (auto& idle = program.idle[looper]; !idle.empty()) {
+    auto worker = std::move(idle.back());
+    idle.pop_back();
+    return worker;
+  }
+  // every worker is busy or idle on another looper
+  if (program.live >= options_.max_workers) {
+    return nullptr;
+  }
+
+  // reserve the slot and spawn out of the lock
+  ++program.live;
+  lock.unlock();
+  auto worker = Worker::Spawn(*this, program_path, looper);
+  if (worker == nullptr) {
+    lock.lock();
+    --program.live;
+    return nullptr;
+  }
+  ++spawn_count_;
+  return worker;
+}
+
+void CGIWorkerPool::Release(const std::shared_ptr<Worker>& worker) {
+  if (worker->GetServed() >= options_.max_requests) {
+    worker->Retire();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mtx_);
+  programs_[worker->GetProgramPath()].idle[worker->GetLooper()].push_back(
+    worker);
+}
+
+void CGIWorkerPool::Forget(const Worker& worker) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto& program = programs_[worker.GetProgramPath()];
+  --program.live;
+  std::erase_if(
+    program.idle[worker.GetLooper()],
+    [&worker](const std::shared_ptr<Worker>& idle) {
+      return idle.get() == &worker;
+    });
+}
+
+}    // namespace longlp::http
@@ -0,0 +1,122 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_HTTP_CGI_WORKER_POOL_H_
+#define SRC_HTTP_CGI_WORKER_POOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/pointers.h"
+#include "core/typedefs.h"
+
+namespace longlp {
+class Looper;
+}    // namespace longlp
+
+namespace longlp::http {
+
+class CGIRunner;
+
+// Persistent (FastCGI-like) CGI workers, an alternative to
+// CGIRunner::RunAsync() that pays 'posix_spawn' once per worker instead of
+// once per request.
+//
+// A worker is the cgi program started with the environment
+// 'LONGLP_CGI_PERSISTENT=1' and both its stdin and stdout connected to a Unix
+// stream socket. Requests and responses are framed the same way:
+//   [4 bytes payload length, network byte order][payload]
+// the request payload is the cgi arguments, each terminated by '\0', and the
+// response payload is what the program would have printed to stdout. A worker
+// serves frames in a loop until its stdin reaches EOF.
+//
+// A worker is spawned by a reactor and stays on it, its socket is watched by
+// the Poller of that reactor and nothing ever blocks on it. Each program owns
+// at most |max_workers| workers over all the reactors. A worker is recycled
+// after |max_requests| requests, or as soon as it misbehaves, e.g. does not
+// answer within |timeout| or answers with a frame over |max_frame_size| as a
+// program not speaking the protocol does.
+// Thread-safe
+class CGIWorkerPool {
+ public:
+  static constexpr size_t kDefaultMaxWorkers   = 4U;
+  static constexpr size_t kDefaultMaxRequests  = 1000U;
+  static constexpr auto kDefaultTimeout        = std::chrono::seconds(30);
+  static constexpr size_t kDefaultMaxFrameSize = 4U << 20U;
+
+  struct Options {
+    // max live workers per cgi program
+    size_t max_workers = kDefaultMaxWorkers;
+    // requests served by a worker before it is recycled
+    size_t max_requests = kDefaultMaxRequests;
+    // how long to wait for a response frame before giving up a worker
+    std::chrono::milliseconds timeout = kDefaultTimeout;
+    // the largest response payload accepted, in bytes
+    size_t max_frame_size = kDefaultMaxFrameSize;
+  };
+
+  // the response payload, std::nullopt if the worker failed in the middle of
+  // the request
+  using DoneCallback =
+    std::function<void(std::optional<DynamicByteArray> output)>;
+
+  explicit CGIWorkerPool(Options options);
+
+  ~CGIWorkerPool();
+
+  DISALLOW_COPY_AND_MOVE(CGIWorkerPool);
+
+  // Send the cgi request to an idle worker of its program on |looper|, or to
+  // a new one while the program has fewer than |max_workers|, and return
+  // right away. |on_done| is called from the event loop of |looper| once the
+  // worker answered, the caller may fall back to CGIRunner::RunAsync() if it
+  // failed. Return false if no worker is free, |on_done| is not called then.
+  // Must be called from the thread of |looper|
+  [[nodiscard]] auto RunAsync(
+    const CGIRunner& runner,
+    not_null<Looper*> looper,
+    DoneCallback on_done) -> bool;
+
+  // total number of workers ever started, for monitoring recycling
+  [[nodiscard]] auto GetSpawnCount() const noexcept -> size_t {
+    return spawn_count_;
+  }
+
+ private:
+  class Worker;
+
+  // all the workers of a single cgi program
+  struct ProgramWorkers {
+    // by the looper watching them, a worker never leaves its looper
+    std::unordered_map<Looper*, std::vector<std::shared_ptr<Worker>>> idle;
+    size_t live{0};
+  };
+
+  [[nodiscard]] auto
+  Acquire(const std::string& program_path, not_null<Looper*> looper)
+    -> std::shared_ptr<Worker>;
+
+  // back to the idle workers, unless it served its max requests
+  void Release(const std::shared_ptr<Worker>& worker);
+
+  // the worker is retired, it no longer counts
+  void Forget(const Worker& worker);
+
+  Options options_;
+  std::mutex mtx_;
+  std::unordered_map<std::string, ProgramWorkers> programs_;
+  std::atomic<size_t> spawn_count_{0};
+};
+
+}    // namespace longlp::http
+
+#endif    // SRC_HTTP_CGI_WORKER_POOL_H_
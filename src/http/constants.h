@@ -10,17 +10,19 @@
 
 namespace longlp::http {
 
-constexpr auto kReadWritePermission       = 0600;
 constexpr std::string_view kCGIFolderName = "cgi-bin";
-constexpr std::string_view kCGIPrefix     = "cgi_temp";
+constexpr std::string_view kPluginRoute   = "/plugin/";
 constexpr std::string_view kSeparator     = "&";
-constexpr std::string_view kUnderscore    = "_";
 constexpr std::string_view kSpace         = " ";
 constexpr std::string_view kDot           = ".";
 constexpr std::string_view kCRLF          = "\r\n";
 constexpr std::string_view kColon         = ":";
+constexpr std::string_view kComma         = ",";
 constexpr std::string_view kDefaultRoute  = "index.html";
 
+// the environment a persistent CGI worker is started with, see CGIWorkerPool
+constexpr const char* kCGIPersistentEnv = "LONGLP_CGI_PERSISTENT=1";
+
 // Common Header and Value
 constexpr std::string_view kHeaderServer        = "Server";
 constexpr std::string_view kServerName          = "longlp/1.0";
@@ -30,8 +32,39 @@ constexpr std::string_view kContentLengthZero   = "0";
 constexpr std::string_view kHeaderConnection    = "Connection";
 constexpr std::string_view kConnectionClose     = "Close";
 constexpr std::string_view kConnectionKeepAlive = "Keep-Alive";
+constexpr std::string_view kHeaderRetryAfter    = "Retry-After";
 constexpr std::string_view kHTTPVersion         = "HTTP/1.1";
 
+// Transfer Coding Header and Value
+constexpr std::string_view kHeaderTransferEncoding  = "Transfer-Encoding";
+constexpr std::string_view kTransferEncodingChunked = "chunked";
+constexpr std::string_view kLastChunk               = "0\r\n\r\n";
+
+// Validator Headers
+constexpr std::string_view kHeaderETag            = "ETag";
+constexpr std::string_view kHeaderLastModified    = "Last-Modified";
+constexpr std::string_view kHeaderIfNoneMatch     = "If-None-Match";
+constexpr std::string_view kHeaderIfModifiedSince = "If-Modified-Since";
+constexpr std::string_view kWeakETagPrefix        = "W/";
+constexpr std::string_view kETagWildcard          = "*";
+// IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+constexpr const char* kHttpDateFormat = "%a, %d %b %Y %H:%M:%S GMT";
+
+// Content Coding Headers and Value
+constexpr std::string_view kHeaderAcceptEncoding  = "Accept-Encoding";
+constexpr std::string_view kHeaderContentEncoding = "Content-Encoding";
+constexpr std::string_view kHeaderVary            = "Vary";
+constexpr std::string_view kEncodingIdentity      = "identity";
+constexpr std::string_view kEncodingGzip          = "gzip";
+constexpr std::string_view kEncodingDeflate       = "deflate";
+constexpr std::string_view kEncodingBrotli        = "br";
+constexpr std::string_view kEncodingWildcard      = "*";
+constexpr std::string_view kQualityParameter      = "q=";
+constexpr std::string_view kSemicolon             = ";";
+constexpr std::string_view kGzipSidecarSuffix     = ".gz";
+constexpr std::string_view kBrotliSidecarSuffix   = ".br";
+constexpr std::string_view kDeflateVariantSuffix  = ".zz";
+
 // MIME Types
 constexpr std::string_view kMimeTypeHTML  = "text/html";
 constexpr std::string_view kMimeTypeCSS   = "text/css";
@@ -40,11 +73,17 @@ constexpr std::string_view kMimeTypeJPG   = "image/jpg";
 constexpr std::string_view kMimeTypeJPEG  = "image/jpeg";
 constexpr std::string_view kMimeTypeGIF   = "image/gif";
 constexpr std::string_view kMimeTypeOCTET = "application/octet-stream";
+constexpr std::string_view kMimeTypeJSON  = "application/json";
+// Prometheus text exposition format
+constexpr std::string_view kMimeTypeMetrics = "text/plain; version=0.0.4";
 
 // Response status
-constexpr std::string_view kResponseStatusOK         = "200 OK";
-constexpr std::string_view kResponseStatusBadRequest = "400 Bad Request";
-constexpr std::string_view kResponseStatusNotFound   = "404 Not Found";
+constexpr std::string_view kResponseStatusOK          = "200 OK";
+constexpr std::string_view kResponseStatusNotModified = "304 Not Modified";
+constexpr std::string_view kResponseStatusBadRequest  = "400 Bad Request";
+constexpr std::string_view kResponseStatusNotFound    = "404 Not Found";
+constexpr std::string_view kResponseStatusInternalServerError =
+  "500 Internal Server Error";
 constexpr std::string_view kResponseStatusServiceUnavailable =
   "503 Service Unavailable";
 
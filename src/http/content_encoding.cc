@@ -0,0 +1,313 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/content_encoding.h"
+
+// make z_stream::next_in a pointer to const
+#define ZLIB_CONST
+#include <zlib.h>
+
+#include <array>
+#include <charconv>
+
+#include <fmt/format.h>
+
+#include "base/utils.h"
+#include "core/cache.h"
+#include "http/constants.h"
+#include "http/http_utils.h"
+
+namespace longlp::http {
+
+namespace {
+// quality values are in [0, 1], negative means not listed in the header
+constexpr double kNotListed     = -1.0;
+constexpr double kDefaultWeight = 1.0;
+// zlib window size, gzip wrapper is requested by adding 16 to it
+constexpr int kWindowBits     = 15;
+constexpr int kGzipWrapper    = 16;
+constexpr int kMemoryLevel    = 8;
+constexpr size_t kNumEncoding = 4U;
+
+// weights of each ContentEncoding, indexed by its underlying value
+using EncodingWeights = std::array<double, kNumEncoding>;
+
+auto ToIndex(ContentEncoding encoding) noexcept -> size_t {
+  return static_cast<size_t>(encoding);
+}
+
+auto ParseQuality(std::string_view parameter) noexcept -> double {
+  const auto trimmed = Trim(parameter, kSpace);
+  if (!trimmed.starts_with(kQualityParameter)) {
+    return kDefaultWeight;
+  }
+  double quality    = kDefaultWeight;
+  const auto* begin = trimmed.data() + kQualityParameter.size();
+  const auto* end   = trimmed.data() + trimmed.size();
+  if (std::from_chars(begin, end, quality).ec != std::errc{}) {
+    return kDefaultWeight;
+  }
+  return quality;
+}
+
+auto ParseAcceptEncoding(std::string_view accept_encoding) noexcept
+  -> EncodingWeights {
+  EncodingWeights weights{};
+  weights.fill(kNotListed);
+  double wildcard = kNotListed;
+
+  for (const auto& token : Split(accept_encoding, kComma)) {
+    const auto parts = Split(token, kSemicolon);
+    if (parts.empty()) {
+      continue;
+    }
+    const auto coding  = Format(parts[0]);
+    const auto quality = (parts.size() > 1) ? ParseQuality(parts[1])
+                                            : kDefaultWeight;
+    if (coding == Format(kEncodingWildcard)) {
+      wildcard = quality;
+      continue;
+    }
+    for (const auto encoding :
+         {ContentEncoding::kBrotli,
+          ContentEncoding::kGzip,
+          ContentEncoding::kDeflate,
+          ContentEncoding::kIdentity}) {
+      if (coding == Format(ToString(encoding))) {
+        weights[ToIndex(encoding)] = quality;
+      }
+    }
+  }
+
+  // codings not listed take the wildcard weight if any, identity is always
+  // acceptable unless explicitly refused
+  for (auto i = 0U; i < kNumEncoding; ++i) {
+    if (weights[i] >= 0.0) {
+      continue;
+    }
+    if (wildcard >= 0.0) {
+      weights[i] = wildcard;
+    }
+    else {
+      weights[i] =
+        (i == ToIndex(ContentEncoding::kIdentity)) ? kDefaultWeight : 0.0;
+    }
+  }
+  return weights;
+}
+
+auto IsVariantAvailable(
+  std::string_view resource_path,
+  ContentEncoding encoding) noexcept -> bool {
+  const auto sidecar =
+    fmt::format("{}{}", resource_path, ToVariantSuffix(encoding));
+  switch (encoding) {
+    case ContentEncoding::kBrotli:
+      return IsFileExists(sidecar);
+    case ContentEncoding::kGzip:
+      return IsFileExists(sidecar) || IsCompressible(resource_path);
+    case ContentEncoding::kDeflate:
+      return IsCompressible(resource_path);
+    case ContentEncoding::kIdentity:
+      return true;
+  }
+  return false;
+}
+}    // namespace
+
+auto ToString(ContentEncoding encoding) noexcept -> std::string_view {
+  switch (encoding) {
+    case ContentEncoding::kBrotli:
+      return kEncodingBrotli;
+    case ContentEncoding::kGzip:
+      return kEncodingGzip;
+    case ContentEncoding::kDeflate:
+      return kEncodingDeflate;
+    case ContentEncoding::kIdentity:
+      return kEncodingIdentity;
+  }
+  return kEncodingIdentity;
+}
+
+auto ToVariantSuffix(ContentEncoding encoding) noexcept -> std::string_view {
+  switch (encoding) {
+    case ContentEncoding::kBrotli:
+      return kBrotliSidecarSuffix;
+    case ContentEncoding::kGzip:
+      return kGzipSidecarSuffix;
+    case ContentEncoding::kDeflate:
+      return kDeflateVariantSuffix;
+    case ContentEncoding::kIdentity:
+      return {};
+  }
+  return {};
+}
+
+auto IsCompressible(std::string_view resource_path) noexcept -> bool {
+  const auto last_dot = resource_path.find_last_of(kDot);
+  if (last_dot == std::string_view::npos) {
+    return false;
+  }
+  const auto extension = ToExtension(resource_path.substr(last_dot + 1));
+  return extension == Extension::kHTML || extension == Extension::kCSS;
+}
+
+auto NegotiateContentEncoding(
+  std::string_view accept_encoding,
+  std::string_view resource_path) noexcept -> ContentEncoding {
+  if (accept_encoding.empty()) {
+    return ContentEncoding::kIdentity;
+  }
+  const auto weights = ParseAcceptEncoding(accept_encoding);
+
+  // iterate in server preference order, so a tie keeps the preferred one
+  auto selected = ContentEncoding::kIdentity;
+  double best   = weights[ToIndex(ContentEncoding::kIdentity)];
+  for (const auto encoding :
+       {ContentEncoding::kBrotli,
+        ContentEncoding::kGzip,
+        ContentEncoding::kDeflate}) {
+    const auto weight = weights[ToIndex(encoding)];
+    const bool better = (selected == ContentEncoding::kIdentity)
+                          ? weight >= best
+                          : weight > best;
+    if (weight > 0.0 && better && IsVariantAvailable(resource_path, encoding)) {
+      selected = encoding;
+      best     = weight;
+    }
+  }
+  return selected;
+}
+
+auto HasEncodedVariants(std::string_view resource_path) noexcept -> bool {
+  return IsVariantAvailable(resource_path, ContentEncoding::kGzip) ||
+         IsVariantAvailable(resource_path, ContentEncoding::kBrotli);
+}
+
+auto MakeVariantETag(std::string_view etag, ContentEncoding encoding) noexcept
+  -> std::string {
+  if (encoding == ContentEncoding::kIdentity || etag.size() < 2 ||
+      !etag.ends_with('"')) {
+    return std::string(etag);
+  }
+  // "<tag>" -> "<tag>-<coding>"
+  etag.remove_suffix(1);
+  return fmt::format("{}-{}\"", etag, ToString(encoding));
+}
+
+auto Compress(
+  const DynamicByteArray& source,
+  ContentEncoding encoding,
+  DynamicByteArray& destination) noexcept -> bool {
+  if (encoding != ContentEncoding::kGzip &&
+      encoding != ContentEncoding::kDeflate) {
+    return false;
+  }
+  const int window_bits = (encoding == ContentEncoding::kGzip)
+                            ? kWindowBits + kGzipWrapper
+                            : kWindowBits;
+
+  z_stream stream{};
+  if (
+    deflateInit2(
+      &stream,
+      Z_DEFAULT_COMPRESSION,
+      Z_DEFLATED,
+      window_bits,
+      kMemoryLevel,
+      Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  // deflateBound() guarantees one-shot deflate() completes
+  const auto old_size = destination.size();
+  destination.resize(old_size + deflateBound(&stream, source.size()));
+  stream.next_in   = source.data();
+  stream.avail_in  = narrow_cast<uInt>(source.size());
+  stream.next_out  = destination.data() + old_size;
+  stream.avail_out = narrow_cast<uInt>(destination.size() - old_size);
+
+  const auto result = deflate(&stream, Z_FINISH);
+  destination.resize(old_size + stream.total_out);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    destination.resize(old_size);
+    return false;
+  }
+  return true;
+}
+
+auto LoadEncodedVariant(
+  std::string_view resource_path,
+  ContentEncoding encoding,
+  Cache& cache,
+  DynamicByteArray& destination,
+  std::string_view etag) -> bool {
+  if (encoding == ContentEncoding::kIdentity) {
+    return false;
+  }
+  if (LoadCachedVariant(resource_path, encoding, cache, destination, etag)) {
+    return true;
+  }
+  const auto variant_key =
+    fmt::format("{}{}", resource_path, ToVariantSuffix(encoding));
+
+  DynamicByteArray variant;
+  if (encoding != ContentEncoding::kDeflate && IsFileExists(variant_key)) {
+    // precompressed sidecar
+    LoadFile(variant_key, variant);
+  }
+  else {
+    DynamicByteArray identity;
+    const auto identity_key = std::string(resource_path);
+    if (!cache.TryLoad(identity_key, identity, etag)) {
+      LoadFile(resource_path, identity);
+      std::ignore =
+        cache.TryInsert(identity_key, identity, Cache::kNeverExpire, etag);
+    }
+    if (!Compress(identity, encoding, variant)) {
+      return false;
+    }
+  }
+  std::ignore =
+    cache.TryInsert(variant_key, variant, Cache::kNeverExpire, etag);
+  destination.insert(destination.end(), variant.begin(), variant.end());
+  return true;
+}
+
+auto LoadCachedVariant(
+  std::string_view resource_path,
+  ContentEncoding encoding,
+  Cache& cache,
+  DynamicByteArray& destination,
+  std::string_view etag) -> bool {
+  if (encoding == ContentEncoding::kIdentity) {
+    return false;
+  }
+  return cache.TryLoad(
+    fmt::format("{}{}", resource_path, ToVariantSuffix(encoding)),
+    destination,
+    etag);
+}
+
+auto LoadContent(
+  const std::string& resource_path,
+  ContentEncoding encoding,
+  Cache& cache,
+  DynamicByteArray& destination,
+  std::string_view etag) -> ContentEncoding {
+  if (
+    encoding != ContentEncoding::kIdentity &&
+    LoadEncodedVariant(resource_path, encoding, cache, destination, etag)) {
+    return encoding;
+  }
+  if (!cache.TryLoad(resource_path, destination, etag)) {
+    LoadFile(resource_path, destination);
+    std::ignore =
+      cache.TryInsert(resource_path, destination, Cache::kNeverExpire, etag);
+  }
+  return ContentEncoding::kIdentity;
+}
+
+}    // namespace longlp::http
@@ -0,0 +1,100 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_HTTP_CONTENT_ENCODING_H_
+#define SRC_HTTP_CONTENT_ENCODING_H_
+
+#include <string>
+#include <string_view>
+
+#include "core/typedefs.h"
+
+namespace longlp {
+class Cache;
+}    // namespace longlp
+
+namespace longlp::http {
+
+// HTTP content codings in the server preference order
+enum class ContentEncoding {
+  kBrotli,
+  kGzip,
+  kDeflate,
+  kIdentity
+};
+
+// the token of the coding as used in Accept-Encoding/Content-Encoding
+[[nodiscard]] auto
+ToString(ContentEncoding encoding) noexcept -> std::string_view;
+
+// the suffix appended to a resource path to name its encoded variant, it is
+// both the precompressed sidecar file name (index.html.gz) and the cache key
+[[nodiscard]] auto
+ToVariantSuffix(ContentEncoding encoding) noexcept -> std::string_view;
+
+// only text assets are worth compressing on the fly, images are already
+// compressed
+[[nodiscard]] auto
+IsCompressible(std::string_view resource_path) noexcept -> bool;
+
+// Select the coding of the response from the Accept-Encoding header value
+// (q-values honoured, ties resolved by server preference) and what is
+// available for the resource: brotli needs a '.br' sidecar, gzip either a
+// '.gz' sidecar or a compressible type, deflate a compressible type
+[[nodiscard]] auto NegotiateContentEncoding(
+  std::string_view accept_encoding,
+  std::string_view resource_path) noexcept -> ContentEncoding;
+
+// whether the resource could be served in more than one coding, responses of
+// such resource must carry 'Vary: Accept-Encoding'
+[[nodiscard]] auto
+HasEncodedVariants(std::string_view resource_path) noexcept -> bool;
+
+// the entity tag of an encoded variant must differ from the identity one
+[[nodiscard]] auto
+MakeVariantETag(std::string_view etag, ContentEncoding encoding) noexcept
+  -> std::string;
+
+// gzip/deflate |source| through zlib and append to |destination|
+[[nodiscard]] auto Compress(
+  const DynamicByteArray& source,
+  ContentEncoding encoding,
+  DynamicByteArray& destination) noexcept -> bool;
+
+// Append the |encoding| variant of the resource to |destination|, looked up
+// in order from the cache, a precompressed sidecar file and finally by
+// compressing the identity content. Any variant loaded from disk or
+// compressed is inserted into the cache alongside the identity version so
+// that it is compressed only once. Both are cached under |etag|, the entity
+// tag of the identity version, and reloaded once the resource changed
+[[nodiscard]] auto LoadEncodedVariant(
+  std::string_view resource_path,
+  ContentEncoding encoding,
+  Cache& cache,
+  DynamicByteArray& destination,
+  std::string_view etag = {}) -> bool;
+
+// Append the |encoding| variant of the resource to |destination| only if it is
+// cached under |etag|, nothing is read from disk nor compressed. Cheap enough
+// for a reactor to tell whether the content must be produced off it
+[[nodiscard]] auto LoadCachedVariant(
+  std::string_view resource_path,
+  ContentEncoding encoding,
+  Cache& cache,
+  DynamicByteArray& destination,
+  std::string_view etag = {}) -> bool;
+
+// Load the content of the resource into the empty |destination| in the
+// |encoding| coding, or in identity if that variant cannot be produced, through
+// the cache as LoadEncodedVariant() does. Return the coding of the content
+[[nodiscard]] auto LoadContent(
+  const std::string& resource_path,
+  ContentEncoding encoding,
+  Cache& cache,
+  DynamicByteArray& destination,
+  std::string_view etag = {}) -> ContentEncoding;
+
+}    // namespace longlp::http
+
+#endif    // SRC_HTTP_CONTENT_ENCODING_H_
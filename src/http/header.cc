@@ -4,29 +4,49 @@
 
 #include "http/header.h"
 
+#include <utility>
+
 #include <fmt/format.h>
 
 #include "http/constants.h"
-#include "http/http_utils.h"
 
 namespace longlp::http {
 
-Header::Header(const std::string_view key, const std::string_view value) :
-  key_(key),
-  value_(value) {}
+Header::Header(
+  const std::string_view key,
+  const std::string_view value,
+  const allocator_type& alloc) :
+  key_(key, alloc),
+  value_(value, alloc) {}
 
-Header::Header(const std::string_view line) {
-  auto tokens = Split(line, kColon);
-  if (tokens.size() < 2) {
+Header::Header(const std::string_view line, const allocator_type& alloc) :
+  key_(alloc),
+  value_(alloc) {
+  const auto colon = line.find(kColon);
+  if (colon == std::string_view::npos || colon + kColon.size() == line.size()) {
     valid_ = false;
     return;
   }
-  key_ = std::move(tokens[0]);
-  tokens.erase(tokens.begin());
-  // the value could be like '127.0.0.1:20080' and get split into more than 1
-  value_ = (tokens.size() == 1) ? tokens[0] : Join(tokens, kColon);
+  key_ = line.substr(0, colon);
+  // the value could be like '127.0.0.1:20080' and contain more colons, only
+  // a single trailing one is dropped
+  auto value = line.substr(colon + kColon.size());
+  if (value.ends_with(kColon)) {
+    value.remove_suffix(kColon.size());
+  }
+  value_ = value;
 }
 
+Header::Header(const Header& other, const allocator_type& alloc) :
+  key_(other.key_, alloc),
+  value_(other.value_, alloc),
+  valid_(other.valid_) {}
+
+Header::Header(Header&& other, const allocator_type& alloc) :
+  key_(std::move(other.key_), alloc),
+  value_(std::move(other.value_), alloc),
+  valid_(other.valid_) {}
+
 auto Header::Serialize() const -> std::string {
   return fmt::format(
     "{key}{colon}{value}{crlf}",
@@ -36,6 +56,13 @@ auto Header::Serialize() const -> std::string {
     fmt::arg("crlf", kCRLF));
 }
 
+void Header::Serialize(DynamicByteArray& buffer) const {
+  buffer.insert(buffer.end(), key_.begin(), key_.end());
+  buffer.insert(buffer.end(), kColon.begin(), kColon.end());
+  buffer.insert(buffer.end(), value_.begin(), value_.end());
+  buffer.insert(buffer.end(), kCRLF.begin(), kCRLF.end());
+}
+
 auto operator<<(std::ostream& os, const Header& header) -> std::ostream& {
   os << fmt::format(
     "HTTP Header contains:\n"
@@ -6,26 +6,49 @@
 #define SRC_HTTP_HEADER_H_
 
 #include <iostream>
+#include <memory_resource>
+#include <string>
 #include <string_view>
 
 #include "base/macros.h"
+#include "core/typedefs.h"
 
 namespace longlp::http {
 
-// The HTTP Header in the form of string "key : value"
+// The HTTP Header in the form of string "key : value".
+// Allocator-aware, a std::pmr::vector<Header> hands its memory resource down
+// to its headers
 class Header {
  public:
-  Header(std::string_view key, std::string_view value);
+  using allocator_type = std::pmr::polymorphic_allocator<>;
 
-  explicit Header(std::string_view line);    // deserialize method
+  Header(
+    std::string_view key,
+    std::string_view value,
+    const allocator_type& alloc = {});
+
+  explicit Header(
+    std::string_view line,
+    const allocator_type& alloc = {});    // deserialize method
+
+  Header(const Header& other, const allocator_type& alloc);
+
+  Header(Header&& other, const allocator_type& alloc);
+
+  DEFAULT_COPY(Header);
+  DEFAULT_MOVE(Header);
+  ~Header() = default;
 
   [[nodiscard]] auto Serialize() const -> std::string;
 
+  // append "key:value\r\n" to |buffer|
+  void Serialize(DynamicByteArray& buffer) const;
+
   [[nodiscard]] auto IsValid() const -> bool { return valid_; }
 
-  [[nodiscard]] auto GetKey() const -> std::string { return key_; }
+  [[nodiscard]] auto GetKey() const -> std::string_view { return key_; }
 
-  [[nodiscard]] auto GetValue() const -> std::string { return value_; }
+  [[nodiscard]] auto GetValue() const -> std::string_view { return value_; }
 
   void SetValue(const std::string_view new_value) noexcept {
     value_ = new_value;
@@ -35,8 +58,8 @@ class Header {
   operator<<(std::ostream& os, const Header& header) -> std::ostream&;
 
  private:
-  std::string key_;
-  std::string value_;
+  std::pmr::string key_;
+  std::pmr::string value_;
   bool valid_{true};
 };
 
@@ -4,7 +4,10 @@
 
 #include "http/http_utils.h"
 
+#include <sys/stat.h>
+
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cctype>
 #include <filesystem>
@@ -12,8 +15,11 @@
 #include <functional>
 #include <sstream>
 
+#include <fmt/format.h>
+
 #include "base/no_destructor.h"
 #include "base/utils.h"
+#include "core/trace.h"
 
 namespace longlp::http {
 using std::boyer_moore_horspool_searcher;
@@ -108,6 +114,27 @@ auto Split(const std::string_view str, const std::string_view delim) noexcept
   return tokens;
 }
 
+auto Split(
+  const std::string_view str,
+  const std::string_view delim,
+  std::pmr::memory_resource* resource) -> std::pmr::vector<std::string_view> {
+  std::pmr::vector<std::string_view> tokens{resource};
+  if (str.empty()) {
+    return tokens;
+  }
+  size_t curr = 0;
+  size_t next{};
+  while ((next = str.find(delim, curr)) != std::string::npos) {
+    tokens.push_back(str.substr(curr, next - curr));
+    curr = next + delim.size();
+  }
+  if (curr != str.size()) {
+    // one last word
+    tokens.push_back(str.substr(curr, str.size() - curr));
+  }
+  return tokens;
+}
+
 auto Join(
   const std::vector<std::string>& tokens,
   const std::string_view delim) noexcept -> std::string {
@@ -127,16 +154,21 @@ auto Join(
 
 auto Trim(const std::string_view str, const std::string_view delim) noexcept
   -> std::string {
+  return std::string(TrimView(str, delim));
+}
+
+auto TrimView(const std::string_view str, const std::string_view delim) noexcept
+  -> std::string_view {
   size_t r_found = str.find_last_not_of(delim);
   if (r_found == std::string::npos) {
     return {};
   }
   size_t l_found = str.find_first_not_of(delim);
-  return str.substr(l_found, r_found - l_found + 1).data();
+  return str.substr(l_found, r_found - l_found + 1);
 }
 
 auto ToUpper(const std::string_view str) noexcept -> std::string {
-  std::string result(str.data());
+  std::string result(str);
   for (auto& c : result) {
     c = narrow_cast<char>(std::toupper(c));
   }
@@ -148,6 +180,21 @@ auto Format(const std::string_view str) noexcept -> std::string {
   return ToUpper(Trim(str, kSpace));
 }
 
+auto IsFormattedEqual(
+  const std::string_view lhs,
+  const std::string_view rhs) noexcept -> bool {
+  const auto lhs_trimmed = TrimView(lhs, kSpace);
+  const auto rhs_trimmed = TrimView(rhs, kSpace);
+  return std::equal(
+    lhs_trimmed.begin(),
+    lhs_trimmed.end(),
+    rhs_trimmed.begin(),
+    rhs_trimmed.end(),
+    [](char lhs_char, char rhs_char) {
+      return std::toupper(lhs_char) == std::toupper(rhs_char);
+    });
+}
+
 auto IsDirectoryExists(const std::string_view directory_path) noexcept -> bool {
   return std::filesystem::is_directory(directory_path);
 }
@@ -177,6 +224,7 @@ auto CheckFileSize(const std::string_view file_path) noexcept -> size_t {
 void LoadFile(
   const std::string_view file_path,
   DynamicByteArray& buffer) noexcept {
+  const TraceSpan span{"LoadFile"};
   size_t file_size       = CheckFileSize(file_path);
   size_t buffer_old_size = buffer.size();
 
@@ -188,4 +236,56 @@ void LoadFile(
     narrow_cast<std::streamsize>(file_size));
 }
 
+auto StatFile(const std::string_view file_path) noexcept
+  -> std::optional<FileInfo> {
+  // std::filesystem::file_time_type has no portable conversion to time_t in
+  // C++20 libraries yet, stat() is used instead
+  struct stat file_stat {};
+
+  if (stat(std::string(file_path).c_str(), &file_stat) == -1) {
+    return std::nullopt;
+  }
+  return FileInfo{narrow_cast<size_t>(file_stat.st_size), file_stat.st_mtime};
+}
+
+auto GetLastModifiedTime(const std::string_view file_path) noexcept
+  -> std::time_t {
+  const auto file_info = StatFile(file_path);
+  return file_info.has_value() ? file_info->last_modified : 0;
+}
+
+auto MakeETag(const FileInfo& file_info) -> std::string {
+  return fmt::format(
+    "\"{mtime:x}-{size:x}\"",
+    fmt::arg("mtime", file_info.last_modified),
+    fmt::arg("size", file_info.size));
+}
+
+auto MakeETag(const std::string_view file_path) noexcept -> std::string {
+  const auto file_info = StatFile(file_path);
+  return file_info.has_value() ? MakeETag(*file_info) : std::string{};
+}
+
+auto ToHttpDate(const std::time_t time) noexcept -> std::string {
+  // long enough for "Sun, 06 Nov 1994 08:49:37 GMT"
+  static constexpr auto kHttpDateLength = 64U;
+  std::array<char, kHttpDateLength> date_buf{};
+  std::tm time_gmt{};
+  gmtime_r(&time, &time_gmt);
+  const auto written =
+    std::strftime(date_buf.data(), date_buf.size(), kHttpDateFormat, &time_gmt);
+  return {date_buf.data(), written};
+}
+
+auto ParseHttpDate(const std::string_view http_date) noexcept
+  -> std::optional<std::time_t> {
+  const auto date_str = Trim(http_date, kSpace);
+  std::tm time_gmt{};
+  const char* end = strptime(date_str.c_str(), kHttpDateFormat, &time_gmt);
+  if (end == nullptr || *end != '\0') {
+    return std::nullopt;
+  }
+  return timegm(&time_gmt);
+}
+
 }    // namespace longlp::http
@@ -5,7 +5,10 @@
 #ifndef SRC_HTTP_SRC_HTTP_UTILS_H_
 #define SRC_HTTP_SRC_HTTP_UTILS_H_
 
+#include <ctime>
 #include <map>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -31,6 +34,12 @@ ToExtension(std::string_view extension_str) noexcept -> Extension;
 [[nodiscard]] auto Split(std::string_view str, std::string_view delim) noexcept
   -> std::vector<std::string>;
 
+// Split() into views of |str|, only the vector is allocated, from |resource|
+[[nodiscard]] auto Split(
+  std::string_view str,
+  std::string_view delim,
+  std::pmr::memory_resource* resource) -> std::pmr::vector<std::string_view>;
+
 // concatenate a collection of strings using the specified delimiter
 [[nodiscard]] auto
 Join(const std::vector<std::string>& tokens, std::string_view delim) noexcept
@@ -40,11 +49,19 @@ Join(const std::vector<std::string>& tokens, std::string_view delim) noexcept
 [[nodiscard]] auto
 Trim(std::string_view str, std::string_view delim) noexcept -> std::string;
 
+// Trim() into a view of |str|
+[[nodiscard]] auto TrimView(std::string_view str, std::string_view delim) noexcept
+  -> std::string_view;
+
 [[nodiscard]] auto ToUpper(std::string_view str) noexcept -> std::string;
 
 // Apply Trim + ToUpper to a string and return the formatted version
 [[nodiscard]] auto Format(std::string_view str) noexcept -> std::string;
 
+// Format(lhs) == Format(rhs) without building either
+[[nodiscard]] auto
+IsFormattedEqual(std::string_view lhs, std::string_view rhs) noexcept -> bool;
+
 [[nodiscard]] auto
 IsDirectoryExists(std::string_view directory_path) noexcept -> bool;
 
@@ -58,6 +75,36 @@ IsDirectoryExists(std::string_view directory_path) noexcept -> bool;
 
 void LoadFile(std::string_view file_path, DynamicByteArray& buffer) noexcept;
 
+// what a response needs to know of a file, looked up once per request
+struct FileInfo {
+  size_t size;
+  // in seconds since epoch
+  std::time_t last_modified;
+};
+
+// a single stat() of |file_path|, std::nullopt if it does not exist
+[[nodiscard]] auto
+StatFile(std::string_view file_path) noexcept -> std::optional<FileInfo>;
+
+// the modification time of a file in seconds since epoch
+[[nodiscard]] auto
+GetLastModifiedTime(std::string_view file_path) noexcept -> std::time_t;
+
+// strong entity tag built from the file modification time and size, in the
+// form of "<mtime hex>-<size hex>", cheap enough to be computed per request
+// without touching the content
+[[nodiscard]] auto MakeETag(const FileInfo& file_info) -> std::string;
+
+// MakeETag() of the file at |file_path|, empty if it does not exist
+[[nodiscard]] auto MakeETag(std::string_view file_path) noexcept -> std::string;
+
+// format a point in time as an HTTP-date (IMF-fixdate), always in GMT
+[[nodiscard]] auto ToHttpDate(std::time_t time) noexcept -> std::string;
+
+// parse an IMF-fixdate HTTP-date, std::nullopt if malformed
+[[nodiscard]] auto ParseHttpDate(std::string_view http_date) noexcept
+  -> std::optional<std::time_t>;
+
 }    // namespace longlp::http
 
 #endif    // SRC_HTTP_SRC_HTTP_UTILS_H_
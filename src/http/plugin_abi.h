@@ -0,0 +1,85 @@
+/* Copyright 2023 Phi-Long Le. All rights reserved.
+ * Use of this source code is governed by a MIT license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef SRC_HTTP_PLUGIN_ABI_H_
+#define SRC_HTTP_PLUGIN_ABI_H_
+
+/* The stable C ABI of the in-process handler plugins, an alternative to CGI
+ * for trusted endpoints.
+ *
+ * A plugin is a shared object exporting LONGLP_PLUGIN_ENTRY_SYMBOL, which
+ * returns a pointer to a static longlp_plugin. It is loaded once with dlopen()
+ * and serves the requests to /plugin/<name>/... by calling |handle|:
+ *   - |request| and every string it refers to are only valid during the call,
+ *     strings are not null-terminated
+ *   - the content is written through |response|, in as many pieces as needed
+ *   - the return value is the HTTP status code of the response
+ * |handle| is called concurrently from several threads. It runs on the
+ * reactor unless LONGLP_PLUGIN_BLOCKING is set, so it must not block then.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LONGLP_PLUGIN_ABI_VERSION    1U
+#define LONGLP_PLUGIN_ENTRY_SYMBOL   "longlp_plugin_entry"
+/* run on the blocking thread pool rather than on the reactor */
+#define LONGLP_PLUGIN_BLOCKING       0x1U
+
+typedef struct longlp_plugin_string {
+  const char* data;
+  size_t size;
+} longlp_plugin_string;
+
+typedef struct longlp_plugin_header {
+  longlp_plugin_string key;
+  longlp_plugin_string value;
+} longlp_plugin_header;
+
+typedef struct longlp_plugin_request {
+  longlp_plugin_string method;
+  /* as requested, e.g. /plugin/echo/a/b */
+  longlp_plugin_string url;
+  /* what follows the plugin name, e.g. /a/b */
+  longlp_plugin_string path;
+  const longlp_plugin_header* headers;
+  size_t header_count;
+} longlp_plugin_request;
+
+typedef struct longlp_plugin_response {
+  /* owned by the server, to be passed back as is */
+  void* context;
+  void (*write)(void* context, const void* data, size_t size);
+  void (*add_header)(
+    void* context,
+    longlp_plugin_string key,
+    longlp_plugin_string value);
+} longlp_plugin_response;
+
+typedef struct longlp_plugin {
+  /* LONGLP_PLUGIN_ABI_VERSION the plugin is built against */
+  uint32_t abi_version;
+  /* routing name, a single path segment */
+  const char* name;
+  uint32_t flags;
+  int (*handle)(
+    const longlp_plugin_request* request,
+    const longlp_plugin_response* response);
+} longlp_plugin;
+
+typedef const longlp_plugin* (*longlp_plugin_entry_fn)(void);
+
+/* to be defined by the plugin, looked up by LONGLP_PLUGIN_ENTRY_SYMBOL */
+const longlp_plugin* longlp_plugin_entry(void);
+
+#ifdef __cplusplus
+}    /* extern "C" */
+#endif
+
+#endif /* SRC_HTTP_PLUGIN_ABI_H_ */
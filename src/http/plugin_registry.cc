@@ -0,0 +1,242 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/plugin_registry.h"
+
+#include <dlfcn.h>
+#include <filesystem>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "base/utils.h"
+#include "core/trace.h"
+#include "http/constants.h"
+#include "http/header.h"
+#include "http/http_utils.h"
+#include "http/request.h"
+#include "http/response.h"
+#include "log/logger.h"
+
+namespace longlp::http {
+
+namespace {
+constexpr std::string_view kSharedObjectExtension = ".so";
+
+// what the plugin produces through longlp_plugin_response
+struct ResponseContext {
+  std::vector<std::pair<std::string, std::string>> headers;
+  DynamicByteArray content;
+};
+
+void WriteContent(void* context, const void* data, size_t size) {
+  auto* response_context = static_cast<ResponseContext*>(context);
+  const auto* bytes      = static_cast<const Byte*>(data);
+  response_context->content.insert(
+    response_context->content.end(),
+    bytes,
+    bytes + size);
+}
+
+void AddHeader(
+  void* context,
+  longlp_plugin_string key,
+  longlp_plugin_string value) {
+  static_cast<ResponseContext*>(context)->headers.emplace_back(
+    std::string(key.data, key.size),
+    std::string(value.data, value.size));
+}
+
+auto ToPluginString(std::string_view str) noexcept -> longlp_plugin_string {
+  return {str.data(), str.size()};
+}
+
+// the server frames the content itself, and a line break would let the plugin
+// smuggle headers or a whole response
+auto IsAllowedHeader(std::string_view key, std::string_view value) noexcept
+  -> bool {
+  constexpr std::string_view kLineBreaks = "\r\n";
+  return !IsFormattedEqual(key, kHeaderContentLength) &&
+         !IsFormattedEqual(key, kHeaderTransferEncoding) &&
+         key.find_first_of(kLineBreaks) == std::string_view::npos &&
+         value.find_first_of(kLineBreaks) == std::string_view::npos;
+}
+
+auto ToStatusLine(int status) -> std::string {
+  switch (status) {
+    case 200:
+      return std::string(kResponseStatusOK);
+    case 201:
+      return "201 Created";
+    case 204:
+      return "204 No Content";
+    case 400:
+      return std::string(kResponseStatusBadRequest);
+    case 403:
+      return "403 Forbidden";
+    case 404:
+      return std::string(kResponseStatusNotFound);
+    case 500:
+      return std::string(kResponseStatusInternalServerError);
+    case 503:
+      return std::string(kResponseStatusServiceUnavailable);
+    default:
+      // the reason phrase may be empty
+      return fmt::format("{}{}", status, kSpace);
+  }
+}
+}    // namespace
+
+PluginRegistry::~PluginRegistry() {
+  for (auto& [name, loaded] : plugins_) {
+    dlclose(loaded.handle);
+  }
+}
+
+auto PluginRegistry::Load(const std::string& library_path) -> bool {
+  void* handle = dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    Log<LogLevel::kError>(
+      "PluginRegistry: fail to load {}: {}",
+      library_path,
+      dlerror());
+    return false;
+  }
+
+  auto entry = bit_cast<longlp_plugin_entry_fn>(
+    dlsym(handle, LONGLP_PLUGIN_ENTRY_SYMBOL));
+  const longlp_plugin* plugin = entry != nullptr ? entry() : nullptr;
+  if (
+    plugin == nullptr || plugin->abi_version != LONGLP_PLUGIN_ABI_VERSION ||
+    plugin->name == nullptr || plugin->handle == nullptr ||
+    plugins_.contains(plugin->name)) {
+    Log<LogLevel::kError>(
+      "PluginRegistry: {} is not a compatible plugin",
+      library_path);
+    dlclose(handle);
+    return false;
+  }
+
+  plugins_.emplace(plugin->name, LoadedPlugin{handle, plugin});
+  Log<LogLevel::kInfo>(
+    "PluginRegistry: plugin {} loaded from {}",
+    plugin->name,
+    library_path);
+  return true;
+}
+
+auto PluginRegistry::LoadDirectory(const std::string& directory_path)
+  -> size_t {
+  size_t loaded = 0;
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(directory_path, error)) {
+    if (
+      entry.is_regular_file() &&
+      entry.path().extension() == kSharedObjectExtension &&
+      Load(entry.path().string())) {
+      ++loaded;
+    }
+  }
+  return loaded;
+}
+
+auto PluginRegistry::Find(std::string_view name) const -> const longlp_plugin* {
+  if (const auto found = plugins_.find(std::string(name));
+      found != plugins_.end()) {
+    return found->second.plugin;
+  }
+  return nullptr;
+}
+
+// static
+auto PluginRegistry::ParseRoute(std::string_view resource_url)
+  -> std::optional<std::pair<std::string_view, std::string_view>> {
+  if (!resource_url.starts_with(kPluginRoute)) {
+    return std::nullopt;
+  }
+  resource_url.remove_prefix(kPluginRoute.size());
+  const auto slash = resource_url.find('/');
+  if (slash == 0) {
+    return std::nullopt;
+  }
+  if (slash == std::string_view::npos) {
+    return std::make_pair(resource_url, std::string_view{});
+  }
+  return std::make_pair(
+    resource_url.substr(0, slash),
+    resource_url.substr(slash));
+}
+
+// static
+auto PluginRegistry::Serve(
+  const longlp_plugin& plugin,
+  const Request& request,
+  DynamicByteArray& response_buf) -> bool {
+  const TraceSpan span{"Plugin"};
+  // the request view refers to the request itself, which outlives the call
+  const std::string_view method =
+    request.GetMethod() == Method::kHEAD ? "HEAD" : "GET";
+  const auto url      = request.GetResourceUrl();
+  const auto& headers = request.GetHeaders();
+  std::vector<longlp_plugin_header> header_views;
+  header_views.reserve(headers.size());
+  for (const auto& header : headers) {
+    header_views.push_back(
+      {ToPluginString(header.GetKey()), ToPluginString(header.GetValue())});
+  }
+  const auto route = ParseRoute(url);
+
+  const longlp_plugin_request plugin_request{
+    ToPluginString(method),
+    ToPluginString(url),
+    ToPluginString(route.has_value() ? route->second : std::string_view{}),
+    header_views.data(),
+    header_views.size()};
+  ResponseContext context;
+  const longlp_plugin_response plugin_response{
+    &context,
+    WriteContent,
+    AddHeader};
+
+  const auto status = plugin.handle(&plugin_request, &plugin_response);
+  if (status < 100 || status > 599) {
+    Log<LogLevel::kError>(
+      "PluginRegistry: plugin {} returned status {}",
+      plugin.name,
+      status);
+    Response response{kResponseStatusInternalServerError, true, std::nullopt};
+    response.Serialize(response_buf);
+    return true;
+  }
+  for (const auto& [key, value] : context.headers) {
+    if (!IsAllowedHeader(key, value)) {
+      Log<LogLevel::kError>(
+        "PluginRegistry: plugin {} returned forbidden header {}",
+        plugin.name,
+        key);
+      Response response{kResponseStatusInternalServerError, true, std::nullopt};
+      response.Serialize(response_buf);
+      return true;
+    }
+  }
+
+  Response response{ToStatusLine(status), request.ShouldClose(), std::nullopt};
+  std::ignore = response.ChangeHeader(
+    kHeaderContentLength,
+    std::to_string(context.content.size()));
+  for (const auto& [key, value] : context.headers) {
+    response.AddHeader(key, value);
+  }
+  response.Serialize(response_buf);
+  if (request.GetMethod() == Method::kGET) {
+    response_buf.insert(
+      response_buf.end(),
+      context.content.begin(),
+      context.content.end());
+  }
+  return request.ShouldClose();
+}
+
+}    // namespace longlp::http
@@ -0,0 +1,71 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_HTTP_PLUGIN_REGISTRY_H_
+#define SRC_HTTP_PLUGIN_REGISTRY_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "base/macros.h"
+#include "core/typedefs.h"
+#include "http/plugin_abi.h"
+
+namespace longlp::http {
+
+class Request;
+
+// The native handler plugins loaded in the server, see plugin_abi.h.
+// Plugins are loaded at start up, the registry is read-only afterward and can
+// then be shared by every reactor without locking
+class PluginRegistry {
+ public:
+  PluginRegistry() = default;
+
+  ~PluginRegistry();
+
+  DISALLOW_COPY_AND_MOVE(PluginRegistry);
+
+  // dlopen() the shared object, false if it is not a compatible plugin or its
+  // name is already taken
+  [[nodiscard]] auto Load(const std::string& library_path) -> bool;
+
+  // every '.so' file of the directory, return the number of plugins loaded
+  auto LoadDirectory(const std::string& directory_path) -> size_t;
+
+  [[nodiscard]] auto Find(std::string_view name) const -> const longlp_plugin*;
+
+  [[nodiscard]] auto GetSize() const noexcept -> size_t {
+    return plugins_.size();
+  }
+
+  // Split '/plugin/<name>/<path>' into the plugin name and the path,
+  // std::nullopt if the url is not a plugin route
+  [[nodiscard]] static auto ParseRoute(std::string_view resource_url)
+    -> std::optional<std::pair<std::string_view, std::string_view>>;
+
+  // Call the plugin and serialize the whole response into |response_buf|.
+  // A plugin failure, e.g. an invalid status or a header framing the response,
+  // is answered with 500 and the connection closed.
+  // Return whether the connection should be closed after the response
+  [[nodiscard]] static auto Serve(
+    const longlp_plugin& plugin,
+    const Request& request,
+    DynamicByteArray& response_buf) -> bool /* should_close */;
+
+ private:
+  struct LoadedPlugin {
+    void* handle;
+    const longlp_plugin* plugin;
+  };
+
+  std::unordered_map<std::string, LoadedPlugin> plugins_;
+};
+
+}    // namespace longlp::http
+
+#endif    // SRC_HTTP_PLUGIN_REGISTRY_H_
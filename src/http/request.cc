@@ -40,17 +40,26 @@ Request::Request(
   Method method,
   Version version,
   const std::string_view resource_url,
-  const std::vector<Header>& headers) noexcept :
+  const std::vector<Header>& headers,
+  const allocator_type& alloc) noexcept :
   method_(method),
   version_(version),
-  resource_url_(resource_url),
-  headers_(headers),
-  is_valid_(true) {}
+  resource_url_(resource_url, alloc),
+  headers_(headers.begin(), headers.end(), alloc),
+  is_valid_(true),
+  invalid_reason_(alloc),
+  accept_encoding_(alloc) {}
 
-Request::Request(const std::string_view request_str) noexcept :
+Request::Request(
+  const std::string_view request_str,
+  const allocator_type& alloc) noexcept :
   method_{Method::kUnsupported},
-  version_{Version::kUnsupported} {
-  auto lines = Split(request_str, kCRLF);
+  version_{Version::kUnsupported},
+  resource_url_(alloc),
+  headers_(alloc),
+  invalid_reason_(alloc),
+  accept_encoding_(alloc) {
+  auto lines = Split(request_str, kCRLF, alloc.resource());
   if (lines.size() < 2 || !lines.back().empty()) {
     invalid_reason_ = "Request format is wrong.";
     return;
@@ -68,21 +77,39 @@ Request::Request(const std::string_view request_str) noexcept :
     return;
   }
 
-  lines.erase(lines.begin());
-  for (const auto& line : lines) {
-    Header header{line};
+  headers_.reserve(lines.size() - 1);
+  for (size_t i = 1; i < lines.size(); ++i) {
+    auto& header = headers_.emplace_back(lines[i]);
     if (!header.IsValid()) {
-      invalid_reason_ = "Fail to parse header line: " + line;
+      invalid_reason_ = "Fail to parse header line: ";
+      invalid_reason_ += lines[i];
+      headers_.pop_back();
       return;
     }
     ScanHeader(header);
-    headers_.push_back(std::move(header));
   }
   is_valid_ = true;
 }
 
+Request::Request(const Request& other, const allocator_type& alloc) :
+  method_(other.method_),
+  version_(other.version_),
+  resource_url_(other.resource_url_, alloc),
+  headers_(other.headers_, alloc),
+  should_close_(other.should_close_),
+  is_valid_(other.is_valid_),
+  invalid_reason_(other.invalid_reason_, alloc),
+  accept_encoding_(other.accept_encoding_, alloc) {
+  if (other.if_none_match_.has_value()) {
+    if_none_match_.emplace(other.if_none_match_.value(), alloc);
+  }
+  if (other.if_modified_since_.has_value()) {
+    if_modified_since_.emplace(other.if_modified_since_.value(), alloc);
+  }
+}
+
 auto Request::ParseRequestLine(const std::string_view request_line) -> bool {
-  const auto tokens = Split(request_line, kSpace);
+  const auto tokens = Split(request_line, kSpace, get_allocator().resource());
   if (tokens.size() != 3) {
     invalid_reason_ =
       fmt::format("Invalid first request headline: {}", request_line);
@@ -102,23 +129,64 @@ auto Request::ParseRequestLine(const std::string_view request_line) -> bool {
   }
 
   // default route to index.html
-  resource_url_ =
-    (tokens[1].empty() || tokens[1].at(tokens[1].size() - 1) == '/')
-      ? fmt::format("{}{}", tokens[1], kDefaultRoute)
-      : tokens[1];
+  resource_url_ = tokens[1];
+  if (tokens[1].empty() || tokens[1].back() == '/') {
+    resource_url_ += kDefaultRoute;
+  }
   return true;
 }
 
 void Request::ScanHeader(const Header& header) {
-  // currently only scan for whether the connection should be closed after
-  // service
-  const auto key = Format(header.GetKey());
-  if (key == Format(kHeaderConnection)) {
-    const auto value = Format(header.GetValue());
-    if (value == Format(kConnectionKeepAlive)) {
+  // scan for whether the connection should be closed after service, for
+  // the validators of conditional requests and for content negotiation
+  const auto key = header.GetKey();
+  if (IsFormattedEqual(key, kHeaderConnection)) {
+    if (IsFormattedEqual(header.GetValue(), kConnectionKeepAlive)) {
       should_close_ = false;
     }
   }
+  else if (IsFormattedEqual(key, kHeaderIfNoneMatch)) {
+    if_none_match_.emplace(TrimView(header.GetValue(), kSpace), get_allocator());
+  }
+  else if (IsFormattedEqual(key, kHeaderIfModifiedSince)) {
+    if_modified_since_.emplace(
+      TrimView(header.GetValue(), kSpace),
+      get_allocator());
+  }
+  else if (IsFormattedEqual(key, kHeaderAcceptEncoding)) {
+    accept_encoding_ = TrimView(header.GetValue(), kSpace);
+  }
+}
+
+auto Request::IsNotModified(
+  const std::string_view etag,
+  const std::time_t last_modified) const noexcept -> bool {
+  if (if_none_match_.has_value()) {
+    if (etag.empty()) {
+      return false;
+    }
+    // weak comparison, GET/HEAD only
+    auto strip_weak = [](std::string_view tag) {
+      if (tag.starts_with(kWeakETagPrefix)) {
+        tag.remove_prefix(kWeakETagPrefix.size());
+      }
+      return tag;
+    };
+    for (const auto candidate :
+         Split(if_none_match_.value(), kComma, get_allocator().resource())) {
+      const auto tag = TrimView(candidate, kSpace);
+      if (tag == kETagWildcard || strip_weak(tag) == strip_weak(etag)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  if (if_modified_since_.has_value()) {
+    const auto since = ParseHttpDate(if_modified_since_.value());
+    return since.has_value() && last_modified <= since.value();
+  }
+  return false;
 }
 
 auto operator<<(std::ostream& os, const Request& request) -> std::ostream& {
@@ -141,8 +209,8 @@ auto operator<<(std::ostream& os, const Request& request) -> std::ostream& {
       fmt::arg("resource_url", request.resource_url_),
       fmt::arg("alive", ((request.should_close_) ? "False" : "True")));
 
-    const auto headers = request.GetHeaders();
-    std::for_each(headers.begin(), headers.end(), [&](auto header) {
+    const auto& headers = request.GetHeaders();
+    std::for_each(headers.begin(), headers.end(), [&](const auto& header) {
       os << header.Serialize();
     });
   }
@@ -5,33 +5,46 @@
 #ifndef SRC_HTTP_REQUEST_H_
 #define SRC_HTTP_REQUEST_H_
 
+#include <ctime>
 #include <iostream>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "base/macros.h"
+#include "http/header.h"
 
 namespace longlp::http {
 
-class Header;
 enum class Method;
 enum class Version;
 
 // The (limited GET/HEAD-only HTTP 1.1) HTTP Request class
 // contains necessary request line features including method, resource url, http
 // version and since we supports http 1.1, it also cares if the client
-// connection should be kept alive
+// connection should be kept alive.
+// Everything it parses is allocated from its allocator, e.g. the per-reactor
+// RequestArena, and so is the Response built for it
 class Request {
  public:
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
   Request(
     Method method,
     Version version,
     std::string_view resource_url,
-    const std::vector<Header>& headers) noexcept;
+    const std::vector<Header>& headers,
+    const allocator_type& alloc = {}) noexcept;
+
+  explicit Request(
+    std::string_view request_str,
+    const allocator_type& alloc = {}) noexcept;    // deserialize method
+
+  // a copy in other memory, e.g. to outlive the arena of the request
+  Request(const Request& other, const allocator_type& alloc);
 
-  explicit Request(std::string_view request_str) noexcept;    // deserialize
-                                                              // method
   DISALLOW_COPY(Request);
   DEFAULT_MOVE(Request);
   ~Request() = default;
@@ -46,18 +59,36 @@ class Request {
 
   [[nodiscard]] auto GetVersion() const noexcept -> Version { return version_; }
 
-  [[nodiscard]] auto GetResourceUrl() const noexcept -> std::string {
+  [[nodiscard]] auto GetResourceUrl() const noexcept -> std::string_view {
     return resource_url_;
   }
 
-  [[nodiscard]] auto GetHeaders() const noexcept -> std::vector<Header> {
+  [[nodiscard]] auto GetHeaders() const noexcept
+    -> const std::pmr::vector<Header>& {
     return headers_;
   }
 
-  [[nodiscard]] auto GetInvalidReason() const noexcept -> std::string {
+  [[nodiscard]] auto GetInvalidReason() const noexcept -> std::string_view {
     return invalid_reason_;
   }
 
+  // the raw Accept-Encoding value, empty if the client did not send one
+  [[nodiscard]] auto GetAcceptEncoding() const noexcept -> std::string_view {
+    return accept_encoding_;
+  }
+
+  [[nodiscard]] auto get_allocator() const noexcept -> allocator_type {
+    return headers_.get_allocator();
+  }
+
+  // conditional GET: whether the client's cached representation identified by
+  // If-None-Match / If-Modified-Since is still fresh against the current
+  // validators, so that a body-less 304 response is sufficient.
+  // If-None-Match takes precedence over If-Modified-Since as in RFC 9110
+  [[nodiscard]] auto IsNotModified(
+    std::string_view etag,
+    std::time_t last_modified) const noexcept -> bool;
+
   friend auto
   operator<<(std::ostream& os, const Request& request) -> std::ostream&;
 
@@ -67,11 +98,14 @@ class Request {
 
   Method method_;
   Version version_;
-  std::string resource_url_;
-  std::vector<Header> headers_;
+  std::pmr::string resource_url_;
+  std::pmr::vector<Header> headers_;
   bool should_close_{true};
   bool is_valid_{false};
-  std::string invalid_reason_;
+  std::pmr::string invalid_reason_;
+  std::optional<std::pmr::string> if_none_match_;
+  std::optional<std::pmr::string> if_modified_since_;
+  std::pmr::string accept_encoding_;
 };
 }    // namespace longlp::http
 
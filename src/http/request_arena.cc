@@ -0,0 +1,32 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/request_arena.h"
+
+namespace longlp::http {
+
+RequestArena::RequestArena(size_t capacity) :
+  buffer_(std::make_unique<std::byte[]>(capacity)),
+  resource_(buffer_.get(), capacity) {}
+
+RequestArena::~RequestArena() = default;
+
+// static
+auto RequestArena::ForThisThread() -> RequestArena& {
+  thread_local RequestArena arena{};
+  return arena;
+}
+
+RequestArena::Scope::Scope(RequestArena& arena) noexcept :
+  arena_(arena) {
+  ++arena_.depth_;
+}
+
+RequestArena::Scope::~Scope() {
+  if (--arena_.depth_ == 0) {
+    arena_.resource_.release();
+  }
+}
+
+}    // namespace longlp::http
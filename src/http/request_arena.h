@@ -0,0 +1,68 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SRC_HTTP_REQUEST_ARENA_H_
+#define SRC_HTTP_REQUEST_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+#include "base/macros.h"
+
+namespace longlp::http {
+
+// A reusable arena for the memory of the requests handled by one thread, i.e.
+// one reactor: the Request, its headers and the Response head are bump
+// allocated from a buffer which is kept and released all at once when the
+// request is done. Nothing is shared with other threads, so reactors never
+// contend on the allocator. Not thread-safe
+class RequestArena {
+ public:
+  // a request and its response head usually fit, a larger one spills over
+  // to the default resource until the arena is released
+  static constexpr size_t kDefaultCapacity = 16 * 1024;
+
+  explicit RequestArena(size_t capacity = kDefaultCapacity);
+
+  ~RequestArena();
+
+  DISALLOW_COPY_AND_MOVE(RequestArena);
+
+  // the arena of the calling thread
+  [[nodiscard]] static auto ForThisThread() -> RequestArena&;
+
+  [[nodiscard]] auto GetResource() noexcept -> std::pmr::memory_resource* {
+    return &resource_;
+  }
+
+  // Hand out the arena for one request. The memory is released when the
+  // outermost scope of the thread ends, a request handled within another
+  // one, e.g. resumed by it, shares its memory
+  class Scope {
+   public:
+    explicit Scope(RequestArena& arena = ForThisThread()) noexcept;
+
+    ~Scope();
+
+    DISALLOW_COPY_AND_MOVE(Scope);
+
+    [[nodiscard]] auto GetResource() const noexcept
+      -> std::pmr::memory_resource* {
+      return arena_.GetResource();
+    }
+
+   private:
+    RequestArena& arena_;
+  };
+
+ private:
+  std::unique_ptr<std::byte[]> buffer_;
+  std::pmr::monotonic_buffer_resource resource_;
+  size_t depth_{0};
+};
+
+}    // namespace longlp::http
+
+#endif    // SRC_HTTP_REQUEST_ARENA_H_
@@ -4,7 +4,6 @@
 
 #include "http/response.h"
 
-#include <sstream>
 #include <utility>
 
 #include <fmt/format.h>
@@ -18,8 +17,65 @@ namespace longlp::http {
 // static
 auto Response::Make200Response(
   bool should_close,
-  std::optional<std::string> resource_url) -> Response {
-  return {kResponseStatusOK.data(), should_close, std::move(resource_url)};
+  std::optional<std::string> resource_url,
+  const allocator_type& alloc) -> Response {
+  return {kResponseStatusOK.data(), should_close, std::move(resource_url), alloc};
+}
+
+// static
+auto Response::Make200Response(
+  bool should_close,
+  std::string resource_url,
+  const FileInfo& file_info,
+  const allocator_type& alloc) -> Response {
+  return {
+    kResponseStatusOK.data(),
+    should_close,
+    std::move(resource_url),
+    file_info,
+    alloc};
+}
+
+// static
+auto Response::Make304Response(
+  bool should_close,
+  std::optional<std::string> resource_url,
+  const allocator_type& alloc) -> Response {
+  Response response{
+    kResponseStatusNotModified.data(),
+    should_close,
+    std::move(resource_url),
+    alloc};
+  response.RemoveContentLength();
+  return response;
+}
+
+// static
+auto Response::Make304Response(
+  bool should_close,
+  std::string resource_url,
+  const FileInfo& file_info,
+  const allocator_type& alloc) -> Response {
+  Response response{
+    kResponseStatusNotModified.data(),
+    should_close,
+    std::move(resource_url),
+    file_info,
+    alloc};
+  response.RemoveContentLength();
+  return response;
+}
+
+// static
+auto Response::MakeChunkedResponse(
+  bool should_close,
+  const allocator_type& alloc) -> Response {
+  Response response{kResponseStatusOK.data(), should_close, std::nullopt, alloc};
+  response.RemoveContentLength();
+  response.headers_.emplace_back(
+    kHeaderTransferEncoding,
+    kTransferEncodingChunked);
+  return response;
 }
 
 // static
@@ -40,45 +96,102 @@ auto Response::Make503Response() noexcept -> Response {
 Response::Response(
   const std::string_view status_code,
   bool should_close,
-  std::optional<std::string> resource_url) :
+  std::optional<std::string> resource_url,
+  const allocator_type& alloc) :
+  Response(status_code, should_close, alloc) {
+  // if resource is specified and available
+  const auto file_info = resource_url.has_value()
+                           ? StatFile(resource_url.value())
+                           : std::nullopt;
+  if (file_info.has_value()) {
+    resource_url_ = std::move(resource_url);
+    AddResourceHeaders(file_info.value());
+  }
+  else {
+    headers_.emplace_back(kHeaderContentLength, kContentLengthZero);
+  }
+}
+
+Response::Response(
+  const std::string_view status_code,
+  bool should_close,
+  std::string resource_url,
+  const FileInfo& file_info,
+  const allocator_type& alloc) :
+  Response(status_code, should_close, alloc) {
+  resource_url_ = std::move(resource_url);
+  AddResourceHeaders(file_info);
+}
+
+Response::Response(
+  const std::string_view status_code,
+  bool should_close,
+  const allocator_type& alloc) :
+  status_line_(alloc),
   should_close_(should_close),
-  resource_url_(std::move(resource_url)) {
+  headers_(alloc) {
   // construct the status line
-  status_line_ = fmt::format("{}{}{}", kHTTPVersion, kSpace, status_code);
+  status_line_.append(kHTTPVersion).append(kSpace).append(status_code);
 
+  // the usual headers, the resource ones included, fit without growing
+  static constexpr size_t kExpectedHeaders = 8;
+  headers_.reserve(kExpectedHeaders);
   // add necessary headers
   headers_.emplace_back(kHeaderServer, kServerName);
   headers_.emplace_back(
     kHeaderConnection,
     ((should_close_) ? kConnectionClose : kConnectionKeepAlive));
-  // if resource is specified and available
-  if (resource_url_.has_value() && IsFileExists(resource_url_.value())) {
-    size_t content_length = CheckFileSize(resource_url_.value());
-    headers_.emplace_back(kHeaderContentLength, std::to_string(content_length));
-    // parse out the extension
-    auto last_dot = resource_url_.value().find_last_of(kDot);
-    if (last_dot != std::string::npos) {
-      auto extension_raw_str = resource_url_.value().substr(last_dot + 1);
-      auto extension         = ToExtension(extension_raw_str);
-      headers_.emplace_back(kHeaderContentType, ExtensionToMime(extension));
-    }
-  }
-  else {
-    resource_url_ = std::nullopt;
-    headers_.emplace_back(kHeaderContentLength, kContentLengthZero);
+}
+
+void Response::AddResourceHeaders(const FileInfo& file_info) {
+  headers_.emplace_back(kHeaderContentLength, std::to_string(file_info.size));
+  // parse out the extension
+  auto last_dot = resource_url_.value().find_last_of(kDot);
+  if (last_dot != std::string::npos) {
+    auto extension_raw_str = resource_url_.value().substr(last_dot + 1);
+    auto extension         = ToExtension(extension_raw_str);
+    headers_.emplace_back(kHeaderContentType, ExtensionToMime(extension));
   }
+  // validators for conditional requests
+  headers_.emplace_back(kHeaderETag, MakeETag(file_info));
+  headers_.emplace_back(
+    kHeaderLastModified,
+    ToHttpDate(file_info.last_modified));
+}
+
+void Response::RemoveContentLength() {
+  std::erase_if(headers_, [](const Header& header) {
+    return header.GetKey() == kHeaderContentLength;
+  });
 }
 
 void Response::Serialize(DynamicByteArray& buffer) {
-  // construct everything before body
-  std::stringstream str_stream;
-  str_stream << fmt::format("{}{}", status_line_, kCRLF);
+  // construct everything before body, straight into the buffer
+  buffer.insert(buffer.end(), status_line_.begin(), status_line_.end());
+  buffer.insert(buffer.end(), kCRLF.begin(), kCRLF.end());
   for (const auto& header : headers_) {
-    str_stream << header.Serialize();
+    header.Serialize(buffer);
+  }
+  buffer.insert(buffer.end(), kCRLF.begin(), kCRLF.end());
+}
+
+// static
+void Response::AppendChunk(
+  const Byte* data,
+  size_t size,
+  DynamicByteArray& buffer) {
+  if (size == 0) {
+    return;
   }
-  str_stream << kCRLF;
-  std::string response_head = str_stream.str();
-  buffer.insert(buffer.end(), response_head.begin(), response_head.end());
+  const auto chunk_size = fmt::format("{:x}{}", size, kCRLF);
+  buffer.insert(buffer.end(), chunk_size.begin(), chunk_size.end());
+  buffer.insert(buffer.end(), data, data + size);
+  buffer.insert(buffer.end(), kCRLF.begin(), kCRLF.end());
+}
+
+// static
+void Response::AppendLastChunk(DynamicByteArray& buffer) {
+  buffer.insert(buffer.end(), kLastChunk.begin(), kLastChunk.end());
 }
 
 auto Response::ChangeHeader(
@@ -93,4 +206,10 @@ auto Response::ChangeHeader(
   return false;
 }
 
+void Response::AddHeader(
+  const std::string_view key,
+  const std::string_view value) {
+  headers_.emplace_back(key, value);
+}
+
 }    // namespace longlp::http
@@ -5,23 +5,53 @@
 #ifndef SRC_HTTP_RESPONSE_H_
 #define SRC_HTTP_RESPONSE_H_
 
+#include <memory_resource>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "core/typedefs.h"
+#include "http/header.h"
 
 namespace longlp::http {
 
-class Header;
+struct FileInfo;
 
-// The HTTP Response class use vector of char to be able to contain binary data
+// The HTTP Response class use vector of char to be able to contain binary data.
+// Its status line and headers are allocated from its allocator, usually the
+// one of the request it answers
 class Response {
  public:
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
   // 200 OK response
+  [[nodiscard]] static auto Make200Response(
+    bool should_close,
+    std::optional<std::string> resource_url,
+    const allocator_type& alloc = {}) -> Response;
+  // the resource described by |file_info| is not looked up again
+  [[nodiscard]] static auto Make200Response(
+    bool should_close,
+    std::string resource_url,
+    const FileInfo& file_info,
+    const allocator_type& alloc = {}) -> Response;
+  // 304 Not Modified response, validators of the resource are kept but no
+  // content is ever carried, neither is its length since it depends on the
+  // negotiated content coding
+  [[nodiscard]] static auto Make304Response(
+    bool should_close,
+    std::optional<std::string> resource_url,
+    const allocator_type& alloc = {}) -> Response;
+  [[nodiscard]] static auto Make304Response(
+    bool should_close,
+    std::string resource_url,
+    const FileInfo& file_info,
+    const allocator_type& alloc = {}) -> Response;
+  // 200 OK response whose content follows in chunks, for content of unknown
+  // length such as a running cgi program output
   [[nodiscard]] static auto
-  Make200Response(bool should_close, std::optional<std::string> resource_url)
+  MakeChunkedResponse(bool should_close, const allocator_type& alloc = {})
     -> Response;
   // 400 Bad Request response, close connection
   [[nodiscard]] static auto Make400Response() noexcept -> Response;
@@ -30,24 +60,55 @@ class Response {
   // 503 Service Unavailable response, close connection
   [[nodiscard]] static auto Make503Response() noexcept -> Response;
 
+  // the resource headers are added if |resource_url| exists
+  Response(
+    std::string_view status_code,
+    bool should_close,
+    std::optional<std::string> resource_url,
+    const allocator_type& alloc = {});
+
   Response(
     std::string_view status_code,
     bool should_close,
-    std::optional<std::string> resource_url);
+    std::string resource_url,
+    const FileInfo& file_info,
+    const allocator_type& alloc = {});
 
   // no content, content should separately be loaded
   void Serialize(DynamicByteArray& buffer);
 
-  [[nodiscard]] auto GetHeaders() -> std::vector<Header> { return headers_; }
+  // chunked content framing, an empty chunk would end the content so it is
+  // skipped, the end is marked with AppendLastChunk()
+  static void
+  AppendChunk(const Byte* data, size_t size, DynamicByteArray& buffer);
+  static void AppendLastChunk(DynamicByteArray& buffer);
+
+  [[nodiscard]] auto GetHeaders() const noexcept
+    -> const std::pmr::vector<Header>& {
+    return headers_;
+  }
 
   [[nodiscard]] auto
   ChangeHeader(std::string_view key, std::string_view new_value) noexcept
     -> bool;
 
+  void AddHeader(std::string_view key, std::string_view value);
+
  private:
-  std::string status_line_;
+  Response(
+    std::string_view status_code,
+    bool should_close,
+    const allocator_type& alloc);
+
+  // Content-Length, Content-Type and the validators of the resource
+  void AddResourceHeaders(const FileInfo& file_info);
+
+  // neither 304 nor chunked responses tell the length of the content
+  void RemoveContentLength();
+
+  std::pmr::string status_line_;
   bool should_close_;
-  std::vector<Header> headers_;
+  std::pmr::vector<Header> headers_;
   std::optional<std::string> resource_url_;
   DynamicByteArray body_;
 };
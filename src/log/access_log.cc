@@ -0,0 +1,32 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/access_log.h"
+
+#include <iterator>
+
+#include <fmt/format.h>
+
+namespace longlp {
+
+void AppendAccessLogLine(
+  const AccessLogEntry& entry,
+  std::string_view date_time,
+  std::string& out) {
+  fmt::format_to(
+    std::back_inserter(out),
+    "{} {} reactor={} \"{} {}\" {} {} parse={}us handle={}us send={}us\n",
+    date_time,
+    entry.client.View(),
+    entry.reactor_id,
+    entry.method.View(),
+    entry.url.View(),
+    entry.status,
+    entry.bytes_sent,
+    entry.parse.count(),
+    entry.handle.count(),
+    entry.send.count());
+}
+
+}    // namespace longlp
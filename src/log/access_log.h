@@ -0,0 +1,83 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef LOG_ACCESS_LOG_H_
+#define LOG_ACCESS_LOG_H_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "base/chrono.h"
+
+namespace longlp {
+
+// A string stored in place, longer strings are truncated
+template <size_t Capacity>
+class BoundedString {
+ public:
+  void Assign(std::string_view str) noexcept {
+    size_ = std::min(str.size(), Capacity);
+    std::copy_n(str.data(), size_, data_.begin());
+  }
+
+  // formats straight into the storage, without a temporary string
+  template <typename... Args>
+  void Format(fmt::format_string<Args...> format, Args&&... args) {
+    const auto result = fmt::format_to_n(
+      data_.data(),
+      Capacity,
+      format,
+      std::forward<Args>(args)...);
+    size_ = std::min(result.size, Capacity);
+  }
+
+  [[nodiscard]] auto View() const noexcept -> std::string_view {
+    return {data_.data(), size_};
+  }
+
+ private:
+  std::array<char, Capacity> data_{};
+  size_t size_ = 0;
+};
+
+// One request of the access log, see Logger::LogAccess(). Entries have a fixed
+// size so that logging a request never allocates, they are copied into the
+// slots preallocated by the logger
+struct AccessLogEntry {
+  // when the request was read
+  system_clock::time_point time;
+  // ip:port
+  BoundedString<64> client;
+  BoundedString<8> method;
+  BoundedString<256> url;
+  uint16_t status     = 0;
+  uint64_t bytes_sent = 0;
+  // building the request from the read buffer
+  microseconds parse{0};
+  // producing the response, until the end of an asynchronous response
+  microseconds handle{0};
+  // writing the response to the socket
+  microseconds send{0};
+  size_t reactor_id = 0;
+};
+
+// A line of the access log, e.g.
+//   18-10-2023 10:00:00 127.0.0.1:51234 reactor=1 "GET /index.html" 200 1024
+//   parse=3us handle=40us send=12us
+// |date_time| is the formatted |entry.time|
+void AppendAccessLogLine(
+  const AccessLogEntry& entry,
+  std::string_view date_time,
+  std::string& out);
+
+}    // namespace longlp
+
+#endif    // LOG_ACCESS_LOG_H_
@@ -0,0 +1,307 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/binary_log.h"
+
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iterator>
+
+#include <fmt/args.h>
+#include <fmt/chrono.h>
+
+namespace longlp::binary_log {
+
+namespace {
+// larger sizes are taken as corruption
+constexpr uint32_t kMaxStringSize = 64U * 1024U * 1024U;
+constexpr auto kMaxLogLevel       = static_cast<uint8_t>(LogLevel::kFatal);
+
+template <class T>
+auto ReadRaw(std::istream& in, T& value) -> bool {
+  std::array<char, sizeof(T)> bytes{};
+  in.read(bytes.data(), bytes.size());
+  if (in.gcount() != static_cast<std::streamsize>(bytes.size())) {
+    return false;
+  }
+  std::memcpy(&value, bytes.data(), sizeof(T));
+  return true;
+}
+
+auto ReadString(std::istream& in, std::string& str) -> bool {
+  uint32_t size = 0;
+  if (!ReadRaw(in, size) || size > kMaxStringSize) {
+    return false;
+  }
+  str.resize(size);
+  in.read(str.data(), size);
+  return in.gcount() == static_cast<std::streamsize>(size);
+}
+
+auto FormatTime(int64_t time_ns) -> std::string {
+  const auto time_point = std::chrono::system_clock::time_point(
+    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::nanoseconds(time_ns)));
+  return fmt::format(
+    "{:%d-%m-%Y %H:%M:%S}",
+    fmt::localtime(std::chrono::system_clock::to_time_t(time_point)));
+}
+
+void AppendJsonString(std::string& out, std::string_view str) {
+  out.push_back('"');
+  for (const char c : str) {
+    switch (c) {
+      case '"':
+        out.append("\\\"");
+        break;
+      case '\\':
+        out.append("\\\\");
+        break;
+      case '\n':
+        out.append("\\n");
+        break;
+      case '\r':
+        out.append("\\r");
+        break;
+      case '\t':
+        out.append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          fmt::format_to(
+            std::back_inserter(out),
+            "\\u{:04x}",
+            static_cast<unsigned>(c));
+        }
+        else {
+          out.push_back(c);
+        }
+    }
+  }
+  out.push_back('"');
+}
+
+void AppendJsonArg(std::string& out, const Arg& arg) {
+  std::visit(
+    [&out](const auto& value) {
+      using T = std::decay_t<decltype(value)>;
+      if constexpr (std::is_same_v<T, std::string>) {
+        AppendJsonString(out, value);
+      }
+      else if constexpr (std::is_same_v<T, char>) {
+        AppendJsonString(out, std::string_view(&value, 1));
+      }
+      else if constexpr (std::is_same_v<T, double>) {
+        if (std::isfinite(value)) {
+          fmt::format_to(std::back_inserter(out), "{}", value);
+        }
+        else {
+          out.append("null");
+        }
+      }
+      else {
+        fmt::format_to(std::back_inserter(out), "{}", value);
+      }
+    },
+    arg);
+}
+}    // namespace
+
+void PackString(std::string& out, std::string_view str) {
+  PackRaw(out, ArgTag::kString);
+  PackRaw(out, static_cast<uint32_t>(str.size()));
+  out.append(str);
+}
+
+// static
+void Encoder::AppendMagic(std::string& out) { out.append(kMagic); }
+
+void Encoder::AppendLogHead(
+  std::string& out,
+  int64_t time_ns,
+  LogLevel level,
+  fmt::string_view format,
+  size_t arg_count) {
+  auto [found, inserted] = format_ids_.try_emplace(format.data(), 0);
+  if (inserted) {
+    found->second = next_format_id_++;
+    PackRaw(out, RecordKind::kFormat);
+    PackRaw(out, found->second);
+    PackRaw(out, static_cast<uint32_t>(format.size()));
+    out.append(format.data(), format.size());
+  }
+  PackRaw(out, RecordKind::kLog);
+  PackRaw(out, time_ns);
+  PackRaw(out, static_cast<uint8_t>(level));
+  PackRaw(out, found->second);
+  PackRaw(out, static_cast<uint8_t>(arg_count));
+}
+
+// static
+void Encoder::AppendPlainLog(
+  std::string& out,
+  int64_t time_ns,
+  LogLevel level,
+  std::string_view msg) {
+  PackRaw(out, RecordKind::kLog);
+  PackRaw(out, time_ns);
+  PackRaw(out, static_cast<uint8_t>(level));
+  PackRaw(out, kPlainMessageId);
+  PackRaw(out, uint8_t{1});
+  PackString(out, msg);
+}
+
+Decoder::Decoder(std::istream& in) : in_(in) {
+  std::string magic(kMagic.size(), '\0');
+  in_.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+  valid_ = in_.gcount() == static_cast<std::streamsize>(magic.size()) &&
+           magic == kMagic;
+}
+
+auto Decoder::Next() -> std::optional<Record> {
+  if (!valid_) {
+    return std::nullopt;
+  }
+  RecordKind kind{};
+  while (ReadRaw(in_, kind)) {
+    if (kind == RecordKind::kFormat) {
+      if (!ReadFormat()) {
+        return std::nullopt;
+      }
+      continue;
+    }
+    if (kind != RecordKind::kLog) {
+      return std::nullopt;
+    }
+
+    Record record{};
+    uint8_t level      = 0;
+    uint32_t format_id = 0;
+    uint8_t arg_count  = 0;
+    if (
+      !ReadRaw(in_, record.time_ns) || !ReadRaw(in_, level) ||
+      level > kMaxLogLevel || !ReadRaw(in_, format_id) ||
+      !ReadRaw(in_, arg_count)) {
+      return std::nullopt;
+    }
+    record.level = static_cast<LogLevel>(level);
+    if (format_id == kPlainMessageId) {
+      record.format = "{}";
+    }
+    else if (const auto found = formats_.find(format_id);
+             found != formats_.end()) {
+      record.format = found->second;
+    }
+    else {
+      return std::nullopt;
+    }
+    record.args.reserve(arg_count);
+    for (auto i = 0U; i < arg_count; ++i) {
+      auto arg = ReadArg();
+      if (!arg.has_value()) {
+        return std::nullopt;
+      }
+      record.args.push_back(std::move(*arg));
+    }
+    return record;
+  }
+  return std::nullopt;
+}
+
+auto Decoder::ReadFormat() -> bool {
+  uint32_t format_id = 0;
+  std::string format;
+  if (!ReadRaw(in_, format_id) || !ReadString(in_, format)) {
+    return false;
+  }
+  formats_.insert_or_assign(format_id, std::move(format));
+  return true;
+}
+
+auto Decoder::ReadArg() -> std::optional<Arg> {
+  ArgTag tag{};
+  if (!ReadRaw(in_, tag)) {
+    return std::nullopt;
+  }
+  switch (tag) {
+    case ArgTag::kInt:
+      if (int64_t value = 0; ReadRaw(in_, value)) {
+        return value;
+      }
+      break;
+    case ArgTag::kUint:
+      if (uint64_t value = 0; ReadRaw(in_, value)) {
+        return value;
+      }
+      break;
+    case ArgTag::kDouble:
+      if (double value = 0; ReadRaw(in_, value)) {
+        return value;
+      }
+      break;
+    case ArgTag::kBool:
+      if (uint8_t value = 0; ReadRaw(in_, value)) {
+        return value != 0;
+      }
+      break;
+    case ArgTag::kChar:
+      if (char value = 0; ReadRaw(in_, value)) {
+        return value;
+      }
+      break;
+    case ArgTag::kString:
+      if (std::string value; ReadString(in_, value)) {
+        return value;
+      }
+      break;
+    default:
+      break;
+  }
+  return std::nullopt;
+}
+
+auto FormatMessage(const Record& record) -> std::string {
+  fmt::dynamic_format_arg_store<fmt::format_context> store;
+  for (const auto& arg : record.args) {
+    std::visit([&store](const auto& value) { store.push_back(value); }, arg);
+  }
+  try {
+    return fmt::vformat(record.format, store);
+  }
+  catch (const fmt::format_error&) {
+    // the arguments do not match the format string
+    return fmt::format("{} (malformed arguments)", record.format);
+  }
+}
+
+auto ToText(const Record& record) -> std::string {
+  return fmt::format(
+    "{}{}:{}",
+    FormatTime(record.time_ns),
+    ToString(record.level),
+    FormatMessage(record));
+}
+
+auto ToJson(const Record& record) -> std::string {
+  std::string out = fmt::format(
+    R"({{"time_ns":{},"time":"{}","level":"{}","format":)",
+    record.time_ns,
+    FormatTime(record.time_ns),
+    ToString(record.level));
+  AppendJsonString(out, record.format);
+  out.append(R"(,"args":[)");
+  for (size_t i = 0; i < record.args.size(); ++i) {
+    if (i != 0) {
+      out.push_back(',');
+    }
+    AppendJsonArg(out, record.args[i]);
+  }
+  out.append(R"(],"message":)");
+  AppendJsonString(out, FormatMessage(record));
+  out.push_back('}');
+  return out;
+}
+
+}    // namespace longlp::binary_log
@@ -0,0 +1,165 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef LOG_BINARY_LOG_H_
+#define LOG_BINARY_LOG_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "log/log_level.h"
+
+// The binary log format, written instead of text by Logger when
+// Logger::OutputFormat::kBinary is selected. Nothing is formatted when
+// writing, a log record only holds an id of its format string, the raw time
+// and the packed arguments. Integers are stored in the byte order of the
+// machine, files are to be decoded on the same architecture.
+//
+//   file   := kMagic record*
+//   record := kFormat id:u32 size:u32 bytes[size]
+//           | kLog time_ns:i64 level:u8 format_id:u32 arg_count:u8 arg*
+//   arg    := tag:u8 payload
+//
+// Each format string is defined once per file, before its first use.
+namespace longlp::binary_log {
+
+inline constexpr std::string_view kMagic = "LLPLOG01";
+
+enum class RecordKind : uint8_t {
+  kFormat = 1,
+  kLog    = 2,
+};
+
+enum class ArgTag : uint8_t {
+  kInt    = 1,
+  kUint   = 2,
+  kDouble = 3,
+  kBool   = 4,
+  kChar   = 5,
+  kString = 6,
+};
+
+// format id of the plain messages, they hold a single string argument
+inline constexpr uint32_t kPlainMessageId = 0;
+
+template <class T>
+inline void PackRaw(std::string& out, T value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  std::array<char, sizeof(T)> bytes{};
+  std::memcpy(bytes.data(), &value, sizeof(T));
+  out.append(bytes.data(), bytes.size());
+}
+
+void PackString(std::string& out, std::string_view str);
+
+// arguments with no matching tag are formatted and packed as strings
+template <class T>
+inline void PackArg(std::string& out, const T& arg) {
+  if constexpr (std::is_same_v<T, bool>) {
+    PackRaw(out, ArgTag::kBool);
+    PackRaw(out, static_cast<uint8_t>(arg));
+  }
+  else if constexpr (std::is_same_v<T, char>) {
+    PackRaw(out, ArgTag::kChar);
+    PackRaw(out, arg);
+  }
+  else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    PackRaw(out, ArgTag::kInt);
+    PackRaw(out, static_cast<int64_t>(arg));
+  }
+  else if constexpr (std::is_integral_v<T>) {
+    PackRaw(out, ArgTag::kUint);
+    PackRaw(out, static_cast<uint64_t>(arg));
+  }
+  else if constexpr (std::is_floating_point_v<T>) {
+    PackRaw(out, ArgTag::kDouble);
+    PackRaw(out, static_cast<double>(arg));
+  }
+  else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+    PackString(out, arg);
+  }
+  else {
+    PackString(out, fmt::format("{}", arg));
+  }
+}
+
+// Writer side, keeps track of the format strings defined in the file
+class Encoder {
+ public:
+  static void AppendMagic(std::string& out);
+
+  // the log record head, followed by |arg_count| packed arguments. |format| is
+  // a compile-time format string, its address identifies it
+  void AppendLogHead(
+    std::string& out,
+    int64_t time_ns,
+    LogLevel level,
+    fmt::string_view format,
+    size_t arg_count);
+
+  static void AppendPlainLog(
+    std::string& out,
+    int64_t time_ns,
+    LogLevel level,
+    std::string_view msg);
+
+ private:
+  std::unordered_map<const char*, uint32_t> format_ids_;
+  uint32_t next_format_id_ = kPlainMessageId + 1;
+};
+
+using Arg = std::variant<int64_t, uint64_t, double, bool, char, std::string>;
+
+struct Record {
+  int64_t time_ns;
+  LogLevel level;
+  std::string format;
+  std::vector<Arg> args;
+};
+
+// Reader side
+class Decoder {
+ public:
+  explicit Decoder(std::istream& in);
+
+  // false if the stream does not start with kMagic
+  [[nodiscard]] auto IsValid() const noexcept -> bool { return valid_; }
+
+  // the next log record, std::nullopt at the end of the stream or on a
+  // truncated or corrupted record
+  [[nodiscard]] auto Next() -> std::optional<Record>;
+
+ private:
+  auto ReadFormat() -> bool;
+
+  auto ReadArg() -> std::optional<Arg>;
+
+  std::istream& in_;
+  std::unordered_map<uint32_t, std::string> formats_;
+  bool valid_ = false;
+};
+
+// the message as the text log would have it
+[[nodiscard]] auto FormatMessage(const Record& record) -> std::string;
+
+// a line of the text log, without the line break
+[[nodiscard]] auto ToText(const Record& record) -> std::string;
+
+// a JSON object on a single line
+[[nodiscard]] auto ToJson(const Record& record) -> std::string;
+
+}    // namespace longlp::binary_log
+
+#endif    // LOG_BINARY_LOG_H_
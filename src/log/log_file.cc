@@ -0,0 +1,201 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/log_file.h"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <filesystem>
+#include <utility>
+
+#include <fmt/chrono.h>
+#include <fmt/format.h>
+
+namespace longlp {
+
+namespace {
+constexpr mode_t kLogFileMode = 0644;
+}    // namespace
+
+LogFile::LogFile(
+  Options options,
+  std::string_view name,
+  std::string_view extension) :
+  options_(std::move(options)),
+  prefix_(fmt::format("{}_", name)),
+  extension_(extension) {
+  Open();
+  RemoveOldFiles();
+}
+
+LogFile::~LogFile() { Close(); }
+
+auto LogFile::ShouldRotate() const noexcept -> bool {
+  return fd_ == -1 || std::time(nullptr) >= next_day_ ||
+         (options_.max_file_size != 0 && GetSize() >= options_.max_file_size);
+}
+
+void LogFile::Rotate() {
+  Close();
+  Open();
+  RemoveOldFiles();
+}
+
+void LogFile::Append(std::string chunk) {
+  if (chunk.empty()) {
+    return;
+  }
+  if (queue_.empty()) {
+    oldest_queued_ = std::chrono::steady_clock::now();
+  }
+  queued_size_ += chunk.size();
+  queue_.push_back(std::move(chunk));
+  if (queued_size_ >= options_.write_batch_size) {
+    Flush();
+  }
+}
+
+void LogFile::FlushIfDue() {
+  if (
+    !queue_.empty() && std::chrono::steady_clock::now() - oldest_queued_ >=
+                         options_.flush_interval) {
+    Flush();
+  }
+}
+
+void LogFile::Flush() {
+  if (queue_.empty()) {
+    return;
+  }
+
+  std::vector<iovec> iov;
+  iov.reserve(queue_.size());
+  for (auto& chunk : queue_) {
+    iov.push_back({chunk.data(), chunk.size()});
+  }
+  size_t index = 0;
+  while (fd_ != -1 && index < iov.size()) {
+    const auto count = std::min<size_t>(iov.size() - index, IOV_MAX);
+    const auto written = ::writev(fd_, &iov[index], static_cast<int>(count));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // nowhere to report it, the queue is dropped
+      break;
+    }
+    written_size_ += static_cast<size_t>(written);
+    // skip what is written, the last chunk may be partially written
+    auto remaining = static_cast<size_t>(written);
+    while (index < iov.size() && remaining >= iov[index].iov_len) {
+      remaining -= iov[index].iov_len;
+      ++index;
+    }
+    if (remaining > 0) {
+      iov[index].iov_base =
+        static_cast<char*>(iov[index].iov_base) + remaining;
+      iov[index].iov_len -= remaining;
+    }
+  }
+  queue_.clear();
+  queued_size_ = 0;
+
+  if (fd_ != -1 && options_.fsync_policy == FsyncPolicy::kOnFlush) {
+    ::fdatasync(fd_);
+  }
+}
+
+void LogFile::Open() {
+  const auto now = std::time(nullptr);
+  auto local     = fmt::localtime(now);
+  // format DD-MM-YYYY
+  const auto prefix = fmt::format("{}{:%d-%m-%Y}.", prefix_, local);
+  local.tm_hour  = 0;
+  local.tm_min   = 0;
+  local.tm_sec   = 0;
+  local.tm_isdst = -1;
+  ++local.tm_mday;
+  next_day_ = std::mktime(&local);
+
+  // continue after the files of the day
+  size_t sequence = 0;
+  std::error_code error;
+  std::filesystem::create_directories(options_.directory, error);
+  for (const auto& entry :
+       std::filesystem::directory_iterator(options_.directory, error)) {
+    const auto name = entry.path().filename().string();
+    if (!name.starts_with(prefix)) {
+      continue;
+    }
+    size_t existing   = 0;
+    const auto* begin = name.data() + prefix.size();
+    const auto [end, parse_error] =
+      std::from_chars(begin, name.data() + name.size(), existing);
+    if (parse_error == std::errc{} && end != begin) {
+      sequence = std::max(sequence, existing + 1);
+    }
+  }
+
+  // another process may take the same sequence in between
+  for (;; ++sequence) {
+    path_ = (std::filesystem::path(options_.directory) /
+             fmt::format("{}{}{}", prefix, sequence, extension_))
+              .string();
+    fd_ = ::open(
+      path_.c_str(),
+      O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC,
+      kLogFileMode);
+    if (fd_ != -1 || errno != EEXIST) {
+      break;
+    }
+  }
+  written_size_ = 0;
+}
+
+void LogFile::Close() {
+  Flush();
+  if (fd_ == -1) {
+    return;
+  }
+  if (options_.fsync_policy != FsyncPolicy::kNone) {
+    ::fdatasync(fd_);
+  }
+  ::close(fd_);
+  fd_ = -1;
+}
+
+void LogFile::RemoveOldFiles() const {
+  if (options_.max_files == 0) {
+    return;
+  }
+
+  std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>>
+    files;
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(options_.directory, error)) {
+    if (
+      entry.is_regular_file(error) &&
+      entry.path().filename().string().starts_with(prefix_) &&
+      entry.path() != path_) {
+      files.emplace_back(entry.last_write_time(error), entry.path());
+    }
+  }
+  // the current file counts as well
+  if (files.size() < options_.max_files) {
+    return;
+  }
+  std::sort(files.begin(), files.end());
+  const auto removed = files.size() + 1 - options_.max_files;
+  for (size_t i = 0; i < removed; ++i) {
+    std::filesystem::remove(files[i].second, error);
+  }
+}
+
+}    // namespace longlp
@@ -0,0 +1,106 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef LOG_LOG_FILE_H_
+#define LOG_LOG_FILE_H_
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace longlp {
+
+// The files written by the log backend, named
+// {directory}/{name}_DD-MM-YYYY.{sequence}{extension}.
+// A new file is started on every day, when the size limit is reached, and by
+// every process, existing files are never truncated. Chunks are queued and
+// written together with writev() to keep the I/O cost predictable.
+// Only used by the log backend thread.
+class LogFile {
+ public:
+  enum class FsyncPolicy {
+    // leave it to the kernel
+    kNone,
+    // when a file is complete
+    kOnRotate,
+    // after every write
+    kOnFlush,
+  };
+
+  struct Options {
+    std::string directory = ".";
+    // start a new file from this size on, 0 for no limit
+    size_t max_file_size = 64U * 1024U * 1024U;
+    // files of the same name kept in the directory, the oldest are removed, 0
+    // to keep all
+    size_t max_files = 16;
+    // queued bytes written at once
+    size_t write_batch_size = 64U * 1024U;
+    // longest time a chunk stays queued
+    std::chrono::milliseconds flush_interval{100};
+    FsyncPolicy fsync_policy = FsyncPolicy::kOnRotate;
+  };
+
+  // open the first file
+  LogFile(Options options, std::string_view name, std::string_view extension);
+
+  // flush and close the current file
+  ~LogFile();
+
+  DISALLOW_COPY_AND_MOVE(LogFile);
+
+  // the day changed or the size limit is reached
+  [[nodiscard]] auto ShouldRotate() const noexcept -> bool;
+
+  // flush and close the current file, open the next one and remove the files
+  // beyond the retention limit
+  void Rotate();
+
+  // queue |chunk|, the queue is written once it reaches the write batch size
+  void Append(std::string chunk);
+
+  // write the queue if its oldest chunk waited for the flush interval
+  void FlushIfDue();
+
+  void Flush();
+
+  [[nodiscard]] auto IsOpen() const noexcept -> bool { return fd_ != -1; }
+
+  [[nodiscard]] auto GetPath() const noexcept -> const std::string& {
+    return path_;
+  }
+
+  // written and queued bytes of the current file
+  [[nodiscard]] auto GetSize() const noexcept -> size_t {
+    return written_size_ + queued_size_;
+  }
+
+ private:
+  void Open();
+
+  void Close();
+
+  void RemoveOldFiles() const;
+
+  Options options_;
+  // files start with it
+  std::string prefix_;
+  std::string extension_;
+  int fd_ = -1;
+  std::string path_;
+  // start of the next day, in local time
+  std::time_t next_day_ = 0;
+  size_t written_size_  = 0;
+  size_t queued_size_   = 0;
+  std::vector<std::string> queue_;
+  std::chrono::steady_clock::time_point oldest_queued_;
+};
+
+}    // namespace longlp
+
+#endif    // LOG_LOG_FILE_H_
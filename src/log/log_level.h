@@ -0,0 +1,36 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef LOG_LOG_LEVEL_H_
+#define LOG_LOG_LEVEL_H_
+
+#include <cstddef>
+#include <string_view>
+
+namespace longlp {
+
+enum class LogLevel : size_t {
+  kInfo    = 0,
+  kWarning = 1,
+  kError   = 2,
+  kFatal   = 3,
+};
+
+inline constexpr auto ToString(LogLevel level) -> std::string_view {
+  switch (level) {
+    case LogLevel::kError:
+      return "Error";
+    case LogLevel::kFatal:
+      return "Fatal";
+    case LogLevel::kInfo:
+      return "Info";
+    case LogLevel::kWarning:
+      return "Warning";
+  }
+  return "Unknown";
+}
+
+}    // namespace longlp
+
+#endif    // LOG_LOG_LEVEL_H_
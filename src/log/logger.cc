@@ -6,95 +6,282 @@
 
 #include <array>
 #include <chrono>
-#include <filesystem>
-#include <fstream>
+#include <cstring>
+#include <ctime>
+#include <iterator>
 
 #include <fmt/chrono.h>
 #include <fmt/format.h>
 
 #include "base/chrono.h"
 #include "base/no_destructor.h"
+#include "log/access_log.h"
+#include "log/binary_log.h"
+#include "log/log_file.h"
+#include "log/spsc_ring_buffer.h"
 
 namespace longlp {
 
 namespace {
-constexpr auto kThreshold                = 1000;
-constexpr auto kRefreshThresholdDuration = microseconds(3000);
-
-inline constexpr auto ToString(LogLevel level) -> std::string_view {
-  switch (level) {
-    case LogLevel::kError:
-      return "Error";
-    case LogLevel::kFatal:
-      return "Fatal";
-    case LogLevel::kInfo:
-      return "Info";
-    case LogLevel::kWarning:
-      return "Warning";
-  }
-}
-
+// per producer thread
+constexpr size_t kRingBufferCapacity           = 4096;
+constexpr size_t kAccessRingBufferCapacity     = 1024;
+constexpr auto kRefreshThresholdDuration       = microseconds(3000);
+constexpr std::string_view kLogFileName        = "longlp_log";
+constexpr std::string_view kAccessLogFileName  = "longlp_access_log";
+constexpr std::string_view kBinaryLogExtension = ".bin";
 }    // namespace
 
-// Each individual Log message upon construction, the date time is prepended
+// Each individual Log message, only the raw time is taken upon construction,
+// the date time and the arguments are formatted by the backend worker. The
+// message is stored in the ring buffer slot itself unless it is oversized
 class Logger::Log {
  public:
-  // stamp datetime and log level not guaranteed to be output in the stamped
+  Log() = default;
+
+  // stamp time and log level not guaranteed to be output in the stamped
   // time order, best effort approach
-  Log(LogLevel log_level, const std::string_view log_msg) noexcept {
-    auto current_time = std::time(nullptr);
-    std::ostringstream stream;
-    stream << fmt::format(
-      "{time_stamp:%d-%m-%Y %H:%M:%S}{log_level}:{log_msg}\n",
-      fmt::arg("time_stamp", fmt::localtime(current_time)),
-      fmt::arg("log_level", ToString(log_level)),
-      fmt::arg("log_msg", log_msg));
-    stamped_msg_ = stream.str();
+  Log(LogLevel log_level, const std::string_view log_msg) :
+    time_stamp_(system_clock::now()),
+    log_level_(log_level) {
+    if (!log_msg.empty()) {
+      auto* msg = args_.Allocate(log_msg.size());
+      std::memcpy(msg, log_msg.data(), log_msg.size());
+    }
   }
 
-  friend auto operator<<(std::ostream& os, const Log& log) -> std::ostream& {
-    os << log.stamped_msg_;
-    return os;
+  Log(
+    LogLevel log_level,
+    fmt::string_view format,
+    const log_internal::ArgsDecoder& decoder,
+    log_internal::PackedArgs&& args) :
+    time_stamp_(system_clock::now()),
+    log_level_(log_level),
+    format_(format),
+    decoder_(&decoder),
+    args_(std::move(args)) {}
+
+  Log(
+    LogLevel log_level,
+    std::unique_ptr<const log_internal::DeferredMessage> deferred_msg) :
+    time_stamp_(system_clock::now()),
+    log_level_(log_level),
+    deferred_msg_(std::move(deferred_msg)) {}
+
+  [[nodiscard]] auto GetTimeStamp() const noexcept -> system_clock::time_point {
+    return time_stamp_;
+  }
+
+  [[nodiscard]] auto GetLogLevel() const noexcept -> LogLevel {
+    return log_level_;
+  }
+
+  void FormatMsgTo(std::string& out) const {
+    if (decoder_ != nullptr) {
+      decoder_->format_to(format_, args_.GetData(), out);
+    }
+    else if (deferred_msg_ != nullptr) {
+      deferred_msg_->FormatTo(out);
+    }
+    else {
+      out.append(GetPlainMsg());
+    }
+  }
+
+  // a binary log record, nothing gets formatted
+  void EncodeTo(binary_log::Encoder& encoder, std::string& out) const {
+    const auto time_ns = duration_cast<std::chrono::nanoseconds>(
+                           time_stamp_.time_since_epoch())
+                           .count();
+    if (decoder_ != nullptr) {
+      encoder.AppendLogHead(
+        out,
+        time_ns,
+        log_level_,
+        format_,
+        decoder_->arg_count);
+      decoder_->pack_to(args_.GetData(), out);
+      return;
+    }
+    if (deferred_msg_ == nullptr) {
+      binary_log::Encoder::AppendPlainLog(
+        out,
+        time_ns,
+        log_level_,
+        GetPlainMsg());
+      return;
+    }
+    encoder.AppendLogHead(
+      out,
+      time_ns,
+      log_level_,
+      deferred_msg_->GetFormat(),
+      deferred_msg_->GetArgCount());
+    deferred_msg_->PackArgsTo(out);
   }
 
  private:
-  std::string stamped_msg_;
+  [[nodiscard]] auto GetPlainMsg() const noexcept -> std::string_view {
+    return {args_.GetData(), args_.GetSize()};
+  }
+
+  system_clock::time_point time_stamp_;
+  LogLevel log_level_ = LogLevel::kInfo;
+  fmt::string_view format_;
+  // the packed arguments, or the plain message if there is no decoder
+  const log_internal::ArgsDecoder* decoder_ = nullptr;
+  log_internal::PackedArgs args_;
+  // arguments which could not be packed
+  std::unique_ptr<const log_internal::DeferredMessage> deferred_msg_;
+};
+
+// The ring buffer owned by one producer thread, shared with the backend worker
+// so that the logs left by an exited thread can still be drained
+struct Logger::ThreadBuffer {
+  using AccessRing = SPSCRingBuffer<AccessLogEntry, kAccessRingBufferCapacity>;
+
+  SPSCRingBuffer<Log, kRingBufferCapacity> ring;
+  // created on the first access log of the thread, most threads have none
+  std::unique_ptr<AccessRing> access_ring_storage;
+  std::atomic<AccessRing*> access_ring = nullptr;
+  std::atomic<bool> retired            = false;
 };
 
-// opened log stream during the lifetime of the entire server
+// The log files opened during the lifetime of the entire server
 class Logger::StreamWriter {
  public:
-  explicit StreamWriter() {
-    const auto current_time = std::time(nullptr);
-
-    // format DD-MM-YYYY
-    f_.open(
-      fmt::format("longlp_log_{:%d-%m-%Y}", fmt::localtime(current_time)),
-      std::fstream::out | std::fstream::trunc);
+  StreamWriter(OutputFormat output_format, LogFile::Options file_options) :
+    output_format_(output_format),
+    file_options_(std::move(file_options)),
+    file_(
+      file_options_,
+      kLogFileName,
+      output_format == OutputFormat::kBinary ? kBinaryLogExtension : "") {
+    StartFile();
   }
 
-  ~StreamWriter() {
-    if (f_.is_open()) {
-      f_.flush();
-      f_.close();
+  ~StreamWriter() = default;
+
+  DISALLOW_COPY_AND_MOVE(StreamWriter);
+
+  // queued in the file, written out in batches
+  void WriteLogs(const std::vector<Logger::Log>& logs) {
+    // the binary format strings are defined per file, rotate before encoding
+    if (file_.ShouldRotate()) {
+      file_.Rotate();
+      StartFile();
+    }
+    std::string out;
+    if (output_format_ == OutputFormat::kBinary) {
+      for (const auto& log : logs) {
+        log.EncodeTo(encoder_, out);
+      }
     }
+    else {
+      for (const auto& log : logs) {
+        AppendText(log, out);
+      }
+    }
+    file_.Append(std::move(out));
   }
 
-  DISALLOW_COPY_AND_MOVE(StreamWriter);
+  // always text, in its own files
+  void WriteAccessLogs(const std::vector<AccessLogEntry>& entries) {
+    if (access_file_ == nullptr) {
+      access_file_ =
+        std::make_unique<LogFile>(file_options_, kAccessLogFileName, "");
+    }
+    else if (access_file_->ShouldRotate()) {
+      access_file_->Rotate();
+    }
+    std::string out;
+    for (const auto& entry : entries) {
+      AppendAccessLogLine(entry, FormatDateTime(entry.time), out);
+    }
+    access_file_->Append(std::move(out));
+  }
 
-  void WriteLogs(const std::deque<Logger::Log>& logs) {
-    std::for_each(logs.begin(), logs.end(), [this](auto& log) { f_ << log; });
-    f_.flush();
+  void FlushIfDue() {
+    file_.FlushIfDue();
+    if (access_file_ != nullptr) {
+      access_file_->FlushIfDue();
+    }
   }
 
  private:
-  std::fstream f_;
+  auto FormatDateTime(system_clock::time_point time_point) -> std::string_view {
+    const auto seconds = system_clock::to_time_t(time_point);
+    // logs come in bursts, the date time is only formatted once per second
+    if (seconds != cached_seconds_) {
+      cached_seconds_   = seconds;
+      cached_date_time_ = fmt::format(
+        "{:%d-%m-%Y %H:%M:%S}",
+        fmt::localtime(seconds));
+    }
+    return cached_date_time_;
+  }
+
+  void AppendText(const Logger::Log& log, std::string& out) {
+    fmt::format_to(
+      std::back_inserter(out),
+      "{time_stamp}{log_level}:",
+      fmt::arg("time_stamp", FormatDateTime(log.GetTimeStamp())),
+      fmt::arg("log_level", ToString(log.GetLogLevel())));
+    log.FormatMsgTo(out);
+    out.push_back('\n');
+  }
+
+  void StartFile() {
+    encoder_ = binary_log::Encoder{};
+    if (output_format_ == OutputFormat::kBinary) {
+      std::string magic;
+      binary_log::Encoder::AppendMagic(magic);
+      file_.Append(std::move(magic));
+    }
+  }
+
+  OutputFormat output_format_;
+  LogFile::Options file_options_;
+  LogFile file_;
+  std::unique_ptr<LogFile> access_file_;
+  binary_log::Encoder encoder_;
+  std::time_t cached_seconds_ = -1;
+  std::string cached_date_time_;
 };
 
 // static
 void Logger::LogMsg(LogLevel log_level, const std::string_view msg) noexcept {
-  auto log = Logger::Log(log_level, msg);
-  GetInstance().PushLog(std::move(log));
+  GetInstance().PushLog(Logger::Log(log_level, msg));
+}
+
+// static
+void Logger::LogMsg(
+  LogLevel log_level,
+  fmt::string_view format,
+  const log_internal::ArgsDecoder& decoder,
+  log_internal::PackedArgs&& args) noexcept {
+  GetInstance().PushLog(
+    Logger::Log(log_level, format, decoder, std::move(args)));
+}
+
+// static
+void Logger::LogMsg(
+  LogLevel log_level,
+  std::unique_ptr<const log_internal::DeferredMessage> msg) noexcept {
+  GetInstance().PushLog(Logger::Log(log_level, std::move(msg)));
+}
+
+// static
+void Logger::LogAccess(const AccessLogEntry& entry) noexcept {
+  auto& logger      = GetInstance();
+  auto& buffer      = logger.GetThreadBuffer();
+  auto* access_ring = buffer.access_ring.load(std::memory_order_relaxed);
+  if (access_ring == nullptr) {
+    buffer.access_ring_storage = std::make_unique<ThreadBuffer::AccessRing>();
+    access_ring                = buffer.access_ring_storage.get();
+    buffer.access_ring.store(access_ring, std::memory_order_release);
+  }
+  logger.PushTo(*access_ring, entry);
 }
 
 // static
@@ -103,10 +290,7 @@ auto Logger::GetInstance() noexcept -> Logger& {
   return *single_logger;
 }
 
-Logger::Logger() {
-  last_flush_ = GetCurrentTimeMs();
-  log_writer_ = std::thread(&Logger::LogWriting, this);
-}
+Logger::Logger() { log_writer_ = std::thread(&Logger::LogWriting, this); }
 
 Logger::~Logger() {
   // signal and harvest backend thread
@@ -117,48 +301,130 @@ Logger::~Logger() {
   }
 }
 
+auto Logger::GetThreadBuffer() -> ThreadBuffer& {
+  // registered on the first log of the thread, retired on thread exit and
+  // released by the backend worker once drained
+  struct Registration {
+    explicit Registration(Logger& logger) :
+      buffer(std::make_shared<ThreadBuffer>()) {
+      std::lock_guard<std::mutex> lock(logger.mtx_);
+      logger.buffers_.push_back(buffer);
+    }
+
+    ~Registration() { buffer->retired.store(true, std::memory_order_release); }
+
+    DISALLOW_COPY_AND_MOVE(Registration);
+
+    std::shared_ptr<ThreadBuffer> buffer;
+  };
+
+  thread_local Registration registration{*this};
+  return *registration.buffer;
+}
+
 void Logger::PushLog(Logger::Log&& log) {
-  bool should_notify = false;
-  {
-    std::unique_lock<std::mutex> lock(mtx_);
-    queue_.push_back(std::move(log));
-    milliseconds now = GetCurrentTimeMs();
-    if ((now - last_flush_) > kRefreshThresholdDuration ||
-        queue_.size() > kThreshold) {
-      should_notify = true;
+  PushTo(GetThreadBuffer().ring, std::move(log));
+}
+
+template <class Ring, class T>
+void Logger::PushTo(Ring& ring, T&& item) {
+  // |item| is left untouched until it is pushed
+  while (!ring.TryPush(std::forward<T>(item))) {
+    if (overflow_policy_.load(std::memory_order_relaxed) ==
+        OverflowPolicy::kDrop) {
+      dropped_total_.fetch_add(1, std::memory_order_relaxed);
+      return;
     }
+    cv_.notify_one();
+    std::this_thread::yield();
   }
   // a best effort notification to worker thread, not guarantee flush soon
-  if (should_notify) {
+  if (ring.GetSize() >= Ring::GetCapacity() / 2) {
     cv_.notify_one();
   }
 }
 
-void Logger::LogWriting() {
-  std::deque<Logger::Log> writer_queue;
+void Logger::DrainBuffers(
+  std::vector<Logger::Log>& logs,
+  std::vector<AccessLogEntry>& access_entries) {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    buffers = buffers_;
+  }
 
-  auto print_to_file = [](const std::deque<Logger::Log>& logs) {
-    static NoDestructor<StreamWriter> stream_writer{};
-    (*stream_writer).WriteLogs(logs);
-  };
+  Log log;
+  AccessLogEntry access_entry;
+  for (const auto& buffer : buffers) {
+    // read the flag first, a retired buffer gets no more logs
+    const bool retired = buffer->retired.load(std::memory_order_acquire);
+    while (buffer->ring.TryPop(log)) {
+      logs.push_back(std::move(log));
+    }
+    if (auto* access_ring = buffer->access_ring.load(std::memory_order_acquire);
+        access_ring != nullptr) {
+      while (access_ring->TryPop(access_entry)) {
+        access_entries.push_back(access_entry);
+      }
+    }
+    if (retired) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      std::erase(buffers_, buffer);
+    }
+  }
+
+  const auto dropped = dropped_total_.load(std::memory_order_relaxed);
+  if (dropped != dropped_reported_) {
+    logs.emplace_back(
+      LogLevel::kWarning,
+      fmt::format(
+        "Logger: {} logs dropped, the producers outpace the writer",
+        dropped - dropped_reported_));
+    dropped_reported_ = dropped;
+  }
+}
+
+void Logger::LogWriting() {
+  std::vector<Logger::Log> writer_queue;
+  std::vector<AccessLogEntry> access_queue;
+  // opened along with the first log
+  std::unique_ptr<StreamWriter> stream_writer;
 
   while (true) {
-    std::unique_lock<std::mutex> lock(mtx_);
-    cv_.wait(lock, [this]() {
-      return done_ || queue_.size() > kThreshold ||
-             GetCurrentTimeMs() - last_flush_ > kRefreshThresholdDuration;
-    });
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait_for(lock, kRefreshThresholdDuration, [this]() {
+        return done_.load();
+      });
+    }
     // either the flush criteria is met or is about to exit
     // need to record the remaining log in either case
-    if (!queue_.empty()) {
-      writer_queue.swap(queue_);
-      lock.unlock();    // producer may continue
-      print_to_file(writer_queue);
-      last_flush_ = GetCurrentTimeMs();
-      writer_queue.clear();
+    DrainBuffers(writer_queue, access_queue);
+    if (!writer_queue.empty() || !access_queue.empty()) {
+      if (stream_writer == nullptr) {
+        LogFile::Options file_options;
+        {
+          std::lock_guard<std::mutex> lock(mtx_);
+          file_options = file_options_;
+        }
+        stream_writer = std::make_unique<StreamWriter>(
+          output_format_.load(std::memory_order_relaxed),
+          std::move(file_options));
+      }
+      if (!writer_queue.empty()) {
+        stream_writer->WriteLogs(writer_queue);
+        writer_queue.clear();
+      }
+      if (!access_queue.empty()) {
+        stream_writer->WriteAccessLogs(access_queue);
+        access_queue.clear();
+      }
+    }
+    if (stream_writer != nullptr) {
+      stream_writer->FlushIfDue();
     }
     if (done_) {
-      // exit this background thread
+      // exit this background thread, the files are flushed and closed
       return;
     }
   }
@@ -6,69 +6,464 @@
 #define LOG_LOGGER_H_
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
-#include <deque>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
 
 #include "base/chrono.h"
 #include "base/macros.h"
 #include "base/no_destructor.h"
+#include "base/utils.h"
+#include "log/access_log.h"
+#include "log/binary_log.h"
+#include "log/log_file.h"
+#include "log/log_level.h"
 
 namespace longlp {
 
-enum class LogLevel : size_t {
-  kInfo    = 0,
-  kWarning = 1,
-  kError   = 2,
-  kFatal   = 3,
+// Set by the LONGLP_LOG_MIN_LEVEL CMake option, logs below this level are
+// compiled out
+#ifndef LONGLP_LOG_MIN_LEVEL
+#define LONGLP_LOG_MIN_LEVEL 0
+#endif
+inline constexpr auto kCompiledMinLogLevel =
+  static_cast<LogLevel>(LONGLP_LOG_MIN_LEVEL);
+
+namespace log_internal {
+// A log message whose formatting is left to the backend worker, for the
+// arguments which cannot be packed, see ArgsCodec
+class DeferredMessage {
+ public:
+  DeferredMessage() = default;
+
+  virtual ~DeferredMessage() = default;
+
+  DISALLOW_COPY_AND_MOVE(DeferredMessage);
+
+  virtual void FormatTo(std::string& out) const = 0;
+
+  // for the binary log, see binary_log.h
+  [[nodiscard]] virtual auto GetFormat() const noexcept -> fmt::string_view = 0;
+
+  [[nodiscard]] virtual auto GetArgCount() const noexcept -> size_t = 0;
+
+  virtual void PackArgsTo(std::string& out) const = 0;
+};
+
+// string views may not outlive the call, they are captured as strings
+template <class T>
+using CapturedArg = std::conditional_t<
+  std::is_convertible_v<const std::decay_t<T>&, std::string_view>,
+  std::string,
+  std::decay_t<T>>;
+
+template <class... Args>
+class CapturedMessage final : public DeferredMessage {
+  static_assert(sizeof...(Args) <= UINT8_MAX, "too many log arguments");
+
+ public:
+  // |format| is a compile-time format string, hence of static storage
+  template <class... Ts>
+  explicit CapturedMessage(fmt::string_view format, Ts&&... args) :
+    format_(format),
+    args_(std::forward<Ts>(args)...) {}
+
+  ~CapturedMessage() override = default;
+
+  DISALLOW_COPY_AND_MOVE(CapturedMessage);
+
+  void FormatTo(std::string& out) const override {
+    std::apply(
+      [this, &out](const auto&... args) {
+        fmt::vformat_to(
+          std::back_inserter(out),
+          format_,
+          fmt::make_format_args(args...));
+      },
+      args_);
+  }
+
+  [[nodiscard]] auto GetFormat() const noexcept -> fmt::string_view override {
+    return format_;
+  }
+
+  [[nodiscard]] auto GetArgCount() const noexcept -> size_t override {
+    return sizeof...(Args);
+  }
+
+  void PackArgsTo(std::string& out) const override {
+    std::apply(
+      [&out](const auto&... args) { (binary_log::PackArg(out, args), ...); },
+      args_);
+  }
+
+ private:
+  fmt::string_view format_;
+  std::tuple<Args...> args_;
+};
+// The arguments of a log packed as bytes, stored inline in the ring buffer
+// slot so that logging does not allocate. Only the arguments over
+// kInlineCapacity bytes, e.g. a long string, go to the heap
+class PackedArgs {
+ public:
+  static constexpr size_t kInlineCapacity = 128;
+
+  PackedArgs() = default;
+
+  ~PackedArgs() = default;
+
+  // only the bytes in use are copied
+  PackedArgs(PackedArgs&& other) noexcept :
+    heap_(std::move(other.heap_)),
+    size_(other.size_) {
+    if (heap_ == nullptr) {
+      std::memcpy(inline_.data(), other.inline_.data(), size_);
+    }
+  }
+
+  auto operator=(PackedArgs&& other) noexcept -> PackedArgs& {
+    heap_ = std::move(other.heap_);
+    size_ = other.size_;
+    if (heap_ == nullptr) {
+      std::memcpy(inline_.data(), other.inline_.data(), size_);
+    }
+    return *this;
+  }
+
+  DISALLOW_COPY(PackedArgs);
+
+  // room for |size| bytes, to be written by the caller
+  [[nodiscard]] auto Allocate(size_t size) -> char* {
+    size_ = size;
+    if (size <= kInlineCapacity) {
+      heap_.reset();
+      return inline_.data();
+    }
+    heap_ = std::make_unique_for_overwrite<char[]>(size);
+    return heap_.get();
+  }
+
+  [[nodiscard]] auto GetData() const noexcept -> const char* {
+    return heap_ != nullptr ? heap_.get() : inline_.data();
+  }
+
+  [[nodiscard]] auto GetSize() const noexcept -> size_t { return size_; }
+
+ private:
+  // left uninitialized, only the first |size_| bytes are ever read
+  std::array<char, kInlineCapacity> inline_;
+  std::unique_ptr<char[]> heap_;
+  size_t size_{0};
 };
 
+// string-like arguments are packed as their bytes, the other ones have to be
+// trivially copyable to be packed, e.g. numbers, enums and durations
+template <class T>
+inline constexpr bool kIsStringArg =
+  std::is_convertible_v<const std::decay_t<T>&, std::string_view>;
+
+template <class T>
+inline constexpr bool kIsPackableArg =
+  kIsStringArg<T> || std::is_trivially_copyable_v<std::decay_t<T>>;
+
+// The backend side of the packed arguments, see ArgsCodec
+struct ArgsDecoder {
+  void (*format_to)(
+    fmt::string_view format,
+    const char* data,
+    std::string& out);
+  // for the binary log, see binary_log.h
+  void (*pack_to)(const char* data, std::string& out);
+  size_t arg_count;
+};
+
+// Pack the arguments on the calling thread and unpack them on the backend.
+// A string is packed as its size followed by its bytes, any other argument as
+// its object representation
+template <class... Args>
+class ArgsCodec {
+  static_assert(sizeof...(Args) <= UINT8_MAX, "too many log arguments");
+  static_assert((kIsPackableArg<Args> && ...));
+
+ public:
+  static constexpr ArgsDecoder kDecoder{
+    &ArgsCodec::FormatTo,
+    &ArgsCodec::PackTo,
+    sizeof...(Args)};
+
+  template <class... Ts>
+  static void Pack(PackedArgs& packed, const Ts&... args) {
+    char* cursor = packed.Allocate((GetPackedSize(args) + ...));
+    (WriteArg(cursor, args), ...);
+  }
+
+ private:
+  template <class T>
+  using UnpackedArg =
+    std::conditional_t<kIsStringArg<T>, std::string_view, std::decay_t<T>>;
+
+  using Unpacked = std::tuple<UnpackedArg<Args>...>;
+
+  template <class T>
+  static auto GetPackedSize(const T& arg) noexcept -> size_t {
+    if constexpr (kIsStringArg<T>) {
+      return sizeof(size_t) + std::string_view(arg).size();
+    }
+    else {
+      return sizeof(T);
+    }
+  }
+
+  template <class T>
+  static void WriteArg(char*& cursor, const T& arg) noexcept {
+    if constexpr (kIsStringArg<T>) {
+      const std::string_view str(arg);
+      const size_t size = str.size();
+      std::memcpy(cursor, &size, sizeof(size));
+      cursor += sizeof(size);
+      std::memcpy(cursor, str.data(), size);
+      cursor += size;
+    }
+    else {
+      std::memcpy(cursor, &arg, sizeof(T));
+      cursor += sizeof(T);
+    }
+  }
+
+  template <class T>
+  static auto ReadArg(const char*& cursor) noexcept -> UnpackedArg<T> {
+    if constexpr (kIsStringArg<T>) {
+      size_t size{};
+      std::memcpy(&size, cursor, sizeof(size));
+      cursor += sizeof(size);
+      const std::string_view str(cursor, size);
+      cursor += size;
+      return str;
+    }
+    else {
+      std::array<char, sizeof(T)> bytes{};
+      std::memcpy(bytes.data(), cursor, sizeof(T));
+      cursor += sizeof(T);
+      return bit_cast<T>(bytes);
+    }
+  }
+
+  // braced, the arguments are read in order
+  static auto Unpack(const char* data) -> Unpacked {
+    return Unpacked{ReadArg<Args>(data)...};
+  }
+
+  static void FormatTo(
+    fmt::string_view format,
+    const char* data,
+    std::string& out) {
+    std::apply(
+      [format, &out](const auto&... args) {
+        fmt::vformat_to(
+          std::back_inserter(out),
+          format,
+          fmt::make_format_args(args...));
+      },
+      Unpack(data));
+  }
+
+  static void PackTo(const char* data, std::string& out) {
+    std::apply(
+      [&out](const auto&... args) { (binary_log::PackArg(out, args), ...); },
+      Unpack(data));
+  }
+};
+}    // namespace log_internal
+
 // A simple asynchronous logger
-// All callers counts as frontend-producer and is non-blocking a backend worker
-// thread periodically flush the log to persistent storage
+// All callers counts as frontend-producer: each thread appends its logs to its
+// own lock-free ring buffer, a backend worker thread periodically drains every
+// buffer, formats the logs and flush them to persistent storage, see LogFile
 class Logger {
  public:
+  // what a producer does when its ring buffer is full
+  enum class OverflowPolicy {
+    // the log is discarded and counted, the count is reported in the log file
+    kDrop,
+    // spin until the backend makes room
+    kBlock,
+  };
+
+  // how the log file is written
+  enum class OutputFormat {
+    // longlp_log_DD-MM-YYYY.N, one formatted line per log
+    kText,
+    // longlp_log_DD-MM-YYYY.N.bin, see binary_log.h and the log_decoder tool
+    kBinary,
+  };
+
   static void LogMsg(LogLevel log_level, std::string_view msg) noexcept;
 
+  // |args| are unpacked by |decoder| and formatted by the backend worker,
+  // |format| is a compile-time format string
+  static void LogMsg(
+    LogLevel log_level,
+    fmt::string_view format,
+    const log_internal::ArgsDecoder& decoder,
+    log_internal::PackedArgs&& args) noexcept;
+
+  // |msg| is formatted by the backend worker
+  static void LogMsg(
+    LogLevel log_level,
+    std::unique_ptr<const log_internal::DeferredMessage> msg) noexcept;
+
+  // the runtime minimum level, checked before any formatting
+  [[nodiscard]] static auto IsEnabled(LogLevel log_level) noexcept -> bool {
+    return log_level >= min_level_.load(std::memory_order_relaxed);
+  }
+
+  static void SetMinLevel(LogLevel log_level) noexcept {
+    min_level_.store(log_level, std::memory_order_relaxed);
+  }
+
+  // Append a request to the access log, longlp_access_log_DD-MM-YYYY.N, it is
+  // written along with the other logs
+  static void LogAccess(const AccessLogEntry& entry) noexcept;
+
+  [[nodiscard]] static auto IsAccessLogEnabled() noexcept -> bool {
+    return access_log_enabled_.load(std::memory_order_relaxed);
+  }
+
+  static void SetAccessLogEnabled(bool enabled) noexcept {
+    access_log_enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  // only effective before the first log is written
+  void SetFileOptions(LogFile::Options file_options) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    file_options_ = std::move(file_options);
+  }
+
+  // only effective before the first log is written
+  static void SetOutputFormat(OutputFormat output_format) noexcept {
+    output_format_.store(output_format, std::memory_order_relaxed);
+  }
+
   [[nodiscard]] static auto GetInstance() noexcept -> Logger&;
 
   DISALLOW_COPY_AND_MOVE(Logger);
 
+  void SetOverflowPolicy(OverflowPolicy policy) noexcept {
+    overflow_policy_.store(policy, std::memory_order_relaxed);
+  }
+
+  // number of logs discarded so far under OverflowPolicy::kDrop
+  [[nodiscard]] auto GetDroppedCount() const noexcept -> uint64_t {
+    return dropped_total_.load(std::memory_order_relaxed);
+  }
+
  private:
   class Log;
   class StreamWriter;
+  struct ThreadBuffer;
   friend class NoDestructor<Logger>;
 
   explicit Logger();
 
   ~Logger();
 
-  // internal helper to push a log into the FIFO queue potentially notify the
-  // backend worker to swap and flush if threshold criteria is met
+  // the ring buffer of the calling thread, registered on its first log
+  auto GetThreadBuffer() -> ThreadBuffer&;
+
+  // internal helper to push a log into the ring buffer of the calling thread,
+  // wake the backend worker up early when the buffer fills up
   void PushLog(Log&& log);
 
+  template <class Ring, class T>
+  void PushTo(Ring& ring, T&& item);
+
   // The thread routine for the backend log writer
   void LogWriting();
 
+  // move every buffered log into |logs| and access log entry into
+  // |access_entries|, forget the buffers of exited threads
+  void DrainBuffers(
+    std::vector<Log>& logs,
+    std::vector<AccessLogEntry>& access_entries);
+
+  static inline std::atomic<LogLevel> min_level_         = kCompiledMinLogLevel;
+  static inline std::atomic<OutputFormat> output_format_ = OutputFormat::kText;
+  static inline std::atomic<bool> access_log_enabled_     = false;
+
   std::atomic<bool> done_ = false;
+  // guards |buffers_| and |file_options_|, producers only take it once to
+  // register
   std::mutex mtx_;
   std::condition_variable cv_;
-  std::deque<Log> queue_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+  LogFile::Options file_options_;
   std::thread log_writer_;
-  microseconds last_flush_;
+  std::atomic<OverflowPolicy> overflow_policy_ = OverflowPolicy::kDrop;
+  std::atomic<uint64_t> dropped_total_         = 0;
+  // dropped logs not reported yet, only used by the backend worker
+  uint64_t dropped_reported_ = 0;
 };
 
 template <LogLevel level>
 inline void Log(std::string_view msg) {
-  Logger::LogMsg(level, msg);
+  if constexpr (level >= kCompiledMinLogLevel) {
+    if (Logger::IsEnabled(level)) {
+      Logger::LogMsg(level, msg);
+    }
+  }
+}
+
+// Only the arguments are captured on the calling thread, e.g.
+//   Log<LogLevel::kInfo>("{} not exist.", path);
+// they are packed in the ring buffer unless one cannot be copied as bytes
+template <LogLevel level, class Arg, class... Args>
+inline void Log(
+  fmt::format_string<Arg, Args...> format,
+  Arg&& arg,
+  Args&&... args) {
+  if constexpr (level >= kCompiledMinLogLevel) {
+    if (!Logger::IsEnabled(level)) {
+      return;
+    }
+    if constexpr (
+      log_internal::kIsPackableArg<Arg> &&
+      (log_internal::kIsPackableArg<Args> && ...)) {
+      using Codec =
+        log_internal::ArgsCodec<std::decay_t<Arg>, std::decay_t<Args>...>;
+      log_internal::PackedArgs packed;
+      Codec::Pack(packed, arg, args...);
+      Logger::LogMsg(level, format, Codec::kDecoder, std::move(packed));
+    }
+    else {
+      using Message = log_internal::CapturedMessage<
+        log_internal::CapturedArg<Arg>,
+        log_internal::CapturedArg<Args>...>;
+      Logger::LogMsg(
+        level,
+        std::make_unique<const Message>(
+          format,
+          std::forward<Arg>(arg),
+          std::forward<Args>(args)...));
+    }
+  }
 }
 
 }    // namespace longlp
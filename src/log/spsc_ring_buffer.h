@@ -0,0 +1,88 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef LOG_SPSC_RING_BUFFER_H_
+#define LOG_SPSC_RING_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "base/macros.h"
+
+namespace longlp {
+
+// A bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Each side keeps a cached copy of the other side's index so that the
+// shared cache lines are only touched when the queue looks full or empty
+template <class T, size_t Capacity>
+class SPSCRingBuffer {
+  static_assert(
+    Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+    "the capacity must be a power of 2");
+
+ public:
+  SPSCRingBuffer() = default;
+
+  ~SPSCRingBuffer() = default;
+
+  DISALLOW_COPY_AND_MOVE(SPSCRingBuffer);
+
+  // producer side, |item| is left untouched when the queue is full
+  template <class U>
+  [[nodiscard]] auto TryPush(U&& item) noexcept -> bool {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == Capacity) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == Capacity) {
+        return false;
+      }
+    }
+    slots_[tail & kMask] = std::forward<U>(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side
+  [[nodiscard]] auto TryPop(T& item) noexcept -> bool {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    item = std::move(slots_[head & kMask]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // approximate when called concurrently with either side
+  [[nodiscard]] auto GetSize() const noexcept -> size_t {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] static constexpr auto GetCapacity() noexcept -> size_t {
+    return Capacity;
+  }
+
+ private:
+  static constexpr size_t kMask          = Capacity - 1;
+  static constexpr size_t kCacheLineSize = 64;
+
+  // consumer-owned
+  alignas(kCacheLineSize) std::atomic<size_t> head_ = 0;
+  size_t cached_tail_                               = 0;
+  // producer-owned
+  alignas(kCacheLineSize) std::atomic<size_t> tail_ = 0;
+  size_t cached_head_                               = 0;
+
+  alignas(kCacheLineSize) std::array<T, Capacity> slots_{};
+};
+
+}    // namespace longlp
+
+#endif    // LOG_SPSC_RING_BUFFER_H_
@@ -4,6 +4,8 @@
 
 #include "core/cache.h"
 
+#include <chrono>
+#include <thread>
 #include <vector>
 
 #include <fmt/format.h>
@@ -12,6 +14,7 @@
 namespace {
 using longlp::Cache;
 using longlp::DynamicByteArray;
+using namespace std::chrono_literals;
 }    // namespace
 
 TEST_CASE("[core/cache]") {
@@ -48,4 +51,45 @@ TEST_CASE("[core/cache]") {
     const bool load_success = cache.TryLoad("url1", read_buf);
     CHECK(!load_success);
   }
+
+  SECTION("cache should drop an entry once its time to live is over") {
+    CHECK(cache.TryInsert("ttl", data, 50ms));
+    CHECK(cache.TryInsert("forever", data));
+    // not expired yet, cannot be replaced
+    CHECK(!cache.TryInsert("ttl", data, 50ms));
+
+    DynamicByteArray read_buf;
+    CHECK(cache.TryLoad("ttl", read_buf));
+    CHECK(read_buf == data);
+
+    std::this_thread::sleep_for(100ms);
+    CHECK(!cache.TryLoad("ttl", read_buf));
+    CHECK(cache.GetOccupancy() == data_size);
+    CHECK(cache.TryLoad("forever", read_buf));
+
+    // expired entry is replaced in place
+    CHECK(cache.TryInsert("short-lived", data, 1ms));
+    std::this_thread::sleep_for(10ms);
+    CHECK(cache.TryInsert("short-lived", data));
+    CHECK(cache.GetOccupancy() == 2 * data_size);
+  }
+
+  SECTION("cache should drop an entry of another version") {
+    const auto forever = Cache::kNeverExpire;
+    CHECK(cache.TryInsert("file", data, forever, "\"1-a\""));
+    // same version, cannot be replaced
+    CHECK(!cache.TryInsert("file", data, forever, "\"1-a\""));
+
+    DynamicByteArray read_buf;
+    CHECK(cache.TryLoad("file", read_buf, "\"1-a\""));
+    CHECK(cache.TryLoad("file", read_buf));
+    // the file changed since, the entry is stale
+    CHECK(!cache.TryLoad("file", read_buf, "\"2-b\""));
+    CHECK(cache.GetOccupancy() == 0);
+
+    CHECK(cache.TryInsert("file", data, forever, "\"1-a\""));
+    CHECK(cache.TryInsert("file", data, forever, "\"2-b\""));
+    CHECK(cache.TryLoad("file", read_buf, "\"2-b\""));
+    CHECK(cache.GetOccupancy() == data_size);
+  }
 }
@@ -0,0 +1,81 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/connection_pool.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <memory>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/buffer.h"
+#include "core/connection.h"
+
+using longlp::Connection;
+using longlp::ConnectionPool;
+
+namespace {
+auto MakeFd() -> int {
+  return eventfd(0, EFD_CLOEXEC);
+}
+
+auto IsOpen(int fd) -> bool {
+  return fcntl(fd, F_GETFD) != -1;
+}
+}    // namespace
+
+TEST_CASE("[core/connection_pool]") {
+  ConnectionPool pool{2};
+
+  SECTION("a released connection is handed out again as a new one") {
+    const auto first_fd = MakeFd();
+    auto connection     = pool.Acquire(first_fd);
+    const auto* address = connection.get();
+    connection->Read(std::string(100, 'a'));
+    connection->SetCallback([](Connection*) {});
+    connection->Suspend();
+    const auto lifetime = connection->GetLifetime();
+
+    pool.Release(std::move(connection));
+    CHECK_FALSE(IsOpen(first_fd));
+    CHECK(lifetime.expired());
+    CHECK(pool.GetIdleCount() == 1);
+
+    const auto second_fd = MakeFd();
+    auto reused          = pool.Acquire(second_fd);
+    CHECK(reused.get() == address);
+    CHECK(reused->GetFd() == second_fd);
+    CHECK(IsOpen(second_fd));
+    CHECK(reused->GetReadSize() == 0);
+    CHECK_FALSE(reused->IsSuspended());
+    CHECK_FALSE(reused->IsExpired());
+    CHECK(pool.GetIdleCount() == 0);
+  }
+
+  SECTION("the pool keeps at most its maximum of idle connections") {
+    auto first  = pool.Acquire(MakeFd());
+    auto second = pool.Acquire(MakeFd());
+    auto third  = pool.Acquire(MakeFd());
+    pool.Release(std::move(first));
+    pool.Release(std::move(second));
+    pool.Release(std::move(third));
+    CHECK(pool.GetIdleCount() == 2);
+  }
+
+  SECTION("only a buffer grown too much gives its memory back") {
+    auto connection = pool.Acquire(MakeFd());
+    connection->Read(
+      std::string(ConnectionPool::kMaxIdleBufferCapacity / 2, 'a'));
+    connection->Write(
+      std::string(ConnectionPool::kMaxIdleBufferCapacity + 1, 'a'));
+    const auto read_capacity = connection->GetReadCapacity();
+    pool.Release(std::move(connection));
+    auto reused = pool.Acquire(MakeFd());
+    CHECK(reused->GetWriteSize() == 0);
+    CHECK(reused->GetWriteCapacity() == longlp::Buffer::kDefaultCapacity);
+    CHECK(reused->GetReadCapacity() == read_capacity);
+  }
+}
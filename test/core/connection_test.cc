@@ -55,6 +55,22 @@ TEST_CASE("[core/connection]") {
     CHECK(i == 1);
   }
 
+  SECTION("connection's static handler is called in place") {
+    struct Counter {
+      int32_t calls = 0;
+
+      void operator()(Connection*) { ++calls; }
+    };
+
+    Counter counter{};
+    server_connection.SetHandler(&counter);
+    server_connection.Start();
+    server_connection.Suspend();
+    server_connection.Start();
+    server_connection.Resume();
+    CHECK(counter.calls == 2);
+  }
+
   SECTION("through connection to send and recv messages") {
     const std::string client_message = "hello from client";
     const std::string server_message = "hello from server";
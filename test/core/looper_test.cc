@@ -7,6 +7,7 @@
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <future>
 #include <memory>
 #include <numeric>
 #include <thread>
@@ -121,4 +122,28 @@ TEST_CASE("[core/looper]") {
       threads[i].join();
     }
   }
+
+  SECTION("posted tasks run in order on the looper thread") {
+    std::thread runner([&looper]() { looper.StartLoop(); });
+
+    constexpr auto kTaskNum = 100;
+    std::vector<int> order;
+    std::promise<std::thread::id> done;
+    auto finished = done.get_future();
+    // posted from another thread than the looper one
+    for (auto i = 0; i < kTaskNum; ++i) {
+      looper.Post([&order, i]() { order.push_back(i); });
+    }
+    looper.Post([&done]() { done.set_value(std::this_thread::get_id()); });
+
+    // wakes up the looper right away, far before the poll timeout
+    REQUIRE(finished.wait_for(1s) == std::future_status::ready);
+    CHECK(finished.get() == runner.get_id());
+    std::vector<int> expected(kTaskNum);
+    std::iota(expected.begin(), expected.end(), 0);
+    CHECK(order == expected);
+
+    looper.Exit();
+    runner.join();
+  }
 }
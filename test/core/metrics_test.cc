@@ -0,0 +1,96 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/metrics.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using longlp::Histogram;
+using longlp::MetricsRegistry;
+
+TEST_CASE("[core/metrics]") {
+  MetricsRegistry registry;
+
+  SECTION("counters are merged from every thread on read") {
+    constexpr auto thread_num = 8U;
+    constexpr auto increments = 10'000U;
+    auto& counter = registry.GetCounter("requests_total", "requests");
+    std::vector<std::thread> threads;
+    for (auto i = 0U; i < thread_num; ++i) {
+      threads.emplace_back([&counter]() {
+        for (auto j = 0U; j < increments; ++j) {
+          counter.Increment();
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    CHECK(counter.GetValue() == thread_num * increments);
+    // the same name and labels give back the same counter
+    CHECK(&registry.GetCounter("requests_total", "requests") == &counter);
+  }
+
+  SECTION("histogram buckets keep a bounded relative error") {
+    for (uint64_t value : {0U, 1U, 3U, 4U, 7U, 100U, 1'000U, 123'456U}) {
+      const auto index = Histogram::GetBucketIndex(value);
+      const auto upper = Histogram::GetBucketUpperBound(index);
+      CHECK(value <= upper);
+      CHECK(upper - value <= value / Histogram::kSubBucketCount);
+      if (index > 0) {
+        CHECK(Histogram::GetBucketUpperBound(index - 1) < value);
+      }
+    }
+    CHECK(
+      Histogram::GetBucketIndex(uint64_t{1} << Histogram::kMaxExponent) ==
+      Histogram::kBucketCount - 1);
+
+    auto& histogram = registry.GetHistogram("latency_seconds", "latency");
+    histogram.Observe(longlp::microseconds{5});
+    histogram.Observe(longlp::microseconds{500});
+    const auto snapshot = histogram.GetSnapshot();
+    CHECK(snapshot.count == 2);
+    CHECK(snapshot.sum == longlp::microseconds{505});
+  }
+
+  SECTION("metrics are exposed in the prometheus text format") {
+    registry.GetCounter("hits_total", "cache hits").Increment(3);
+    registry.GetGauge("connections", "open", {{"reactor", "0"}}).Add(2);
+    registry.GetGauge("connections", "open", {{"reactor", "1"}}).Add(5);
+    registry.AddCallback(
+      "dropped_total",
+      "dropped \"logs\"",
+      MetricsRegistry::Type::kCounter,
+      [] { return 7.0; });
+    registry.GetHistogram("latency_seconds", "latency")
+      .Observe(longlp::microseconds{2});
+
+    std::string text;
+    registry.WriteText(text);
+    CHECK(
+      text.find("# HELP hits_total cache hits\n"
+                "# TYPE hits_total counter\n"
+                "hits_total 3\n") != std::string::npos);
+    CHECK(
+      text.find("# TYPE connections gauge\n"
+                "connections{reactor=\"0\"} 2\n"
+                "connections{reactor=\"1\"} 5\n") != std::string::npos);
+    CHECK(text.find("dropped_total 7\n") != std::string::npos);
+    CHECK(text.find("# TYPE latency_seconds histogram\n") != std::string::npos);
+    CHECK(
+      text.find("latency_seconds_bucket{le=\"1e-06\"} 0\n"
+                "latency_seconds_bucket{le=\"2e-06\"} 1\n") !=
+      std::string::npos);
+    CHECK(
+      text.find("latency_seconds_bucket{le=\"+Inf\"} 1\n"
+                "latency_seconds_sum 2e-06\n"
+                "latency_seconds_count 1\n") != std::string::npos);
+    // families are sorted by name
+    CHECK(text.find("connections") < text.find("hits_total"));
+  }
+}
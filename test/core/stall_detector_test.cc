@@ -0,0 +1,65 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/stall_detector.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/looper.h"
+#include "core/metrics.h"
+#include "core/trace.h"
+
+using longlp::Looper;
+using longlp::MetricsRegistry;
+using longlp::StallDetector;
+using longlp::TraceSpan;
+using namespace std::chrono_literals;
+
+TEST_CASE("[core/stall_detector]") {
+  constexpr size_t kReactorId = 42;
+  auto& registry              = MetricsRegistry::GetInstance();
+  auto& stalls                = registry.GetCounter(
+    "longlp_looper_stalls_total",
+    "",
+    {{"reactor", "42"}});
+  auto& dispatch = registry.GetHistogram(
+    "longlp_looper_dispatch_duration_seconds",
+    "",
+    {{"reactor", "42"}});
+
+  StallDetector::GetInstance().SetThreshold(20ms);
+  Looper looper{kReactorId};
+  auto loop = std::async(std::launch::async, [&looper]() {
+    looper.StartLoop();
+  });
+
+  SECTION("a callback over the threshold is reported once") {
+    const auto stalls_before   = stalls.GetValue();
+    const auto dispatch_before = dispatch.GetSnapshot().count;
+    std::promise<void> done;
+    looper.Post([&done]() {
+      const TraceSpan span{"LoadFile"};
+      std::this_thread::sleep_for(100ms);
+      done.set_value();
+    });
+    done.get_future().wait();
+    // a short one is not
+    std::promise<void> quick;
+    looper.Post([&quick]() { quick.set_value(); });
+    quick.get_future().wait();
+    std::this_thread::sleep_for(50ms);
+
+    CHECK(stalls.GetValue() == stalls_before + 1);
+    CHECK(dispatch.GetSnapshot().count >= dispatch_before + 2);
+  }
+
+  looper.Exit();
+  looper.Post([]() {});
+  loop.wait();
+  StallDetector::GetInstance().SetThreshold(0ms);
+}
@@ -0,0 +1,163 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/task.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "base/chrono.h"
+#include "base/macros.h"
+#include "base/utils.h"
+#include "core/connection.h"
+#include "core/looper.h"
+#include "core/poller.h"
+#include "core/socket.h"
+#include "core/thread_pool.h"
+
+namespace {
+using longlp::Connection;
+using longlp::DynamicByteArray;
+using longlp::Looper;
+using longlp::Poller;
+using longlp::Socket;
+using longlp::Task;
+using longlp::ThreadPool;
+using namespace std::chrono_literals;
+
+BEGIN_SUPPRESS_COROUTINE_WARNINGS
+
+auto Add(int lhs, int rhs) -> Task<int> {
+  co_return lhs + rhs;
+}
+
+auto AddTwice(int value, int& result) -> Task<> {
+  const auto once = co_await Add(value, value);
+  result          = co_await Add(once, once);
+}
+
+auto Fail() -> Task<int> {
+  throw std::runtime_error("failed");
+  co_return 0;
+}
+
+auto CatchFailure(bool& caught) -> Task<> {
+  try {
+    std::ignore = co_await Fail();
+  }
+  catch (const std::runtime_error&) {
+    caught = true;
+  }
+}
+
+// echo what the peer sends, upper-cased on the pool, after a nap
+auto Echo(
+  Connection* connection,
+  ThreadPool& pool,
+  std::promise<bool>& resumed_on_looper) -> Task<> {
+  auto* looper = Looper::GetCurrent();
+  co_await looper->Sleep(10ms);
+  const auto [read, exit] = co_await connection->AsyncRead();
+  auto message            = connection->ReadDataAsString();
+  connection->ClearReadBuffer();
+  auto upper_case = [message]() {
+    DynamicByteArray upper;
+    for (const auto ch : message) {
+      upper.push_back(static_cast<longlp::Byte>(std::toupper(ch)));
+    }
+    return upper;
+  };
+  auto reply = co_await pool.Offload(std::move(upper_case));
+  const auto on_looper = Looper::GetCurrent() == looper;
+  const auto sent      = co_await connection->AsyncWrite(std::move(reply));
+  resumed_on_looper.set_value(read > 0 && !exit && on_looper && sent);
+}
+
+// more than the socket buffers hold, the write waits for the peer to read
+auto SendLarge(
+  Connection* connection,
+  size_t size,
+  std::promise<bool>& sent) -> Task<> {
+  DynamicByteArray payload(size, 'x');
+  sent.set_value(co_await connection->AsyncWrite(std::move(payload)));
+}
+
+END_SUPPRESS_COROUTINE_WARNINGS
+}    // namespace
+
+TEST_CASE("[core/task]") {
+  SECTION("tasks run when awaited and hand their result back") {
+    int result = 0;
+    AddTwice(1, result).Detach();
+    CHECK(result == 4);
+  }
+
+  SECTION("exceptions propagate to the awaiting coroutine") {
+    bool caught = false;
+    CatchFailure(caught).Detach();
+    CHECK(caught);
+  }
+
+  SECTION("coroutines wait on the looper for timers, sockets and the pool") {
+    std::array<int, 2> fds{};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+    auto socket = std::make_unique<Socket>(fds[0]);
+    socket->SetNonBlocking();
+    auto connection = std::make_unique<Connection>(std::move(socket));
+    auto* client    = connection.get();
+    Looper looper;
+    ThreadPool pool{2};
+    connection->SetLooper(&looper);
+    connection->SetEvents(Poller::Event::kRead | Poller::Event::kET);
+    connection->SetCallback([](longlp::not_null<Connection*> /* conn */) {});
+    looper.AddConnection(std::move(connection));
+
+    std::promise<bool> resumed_on_looper;
+    auto finished = resumed_on_looper.get_future();
+    std::thread runner([&looper]() { looper.StartLoop(); });
+    looper.Post([client, &pool, &resumed_on_looper]() {
+      Echo(client, pool, resumed_on_looper).Detach();
+    });
+
+    const std::string message = "ping";
+    REQUIRE(write(fds[1], message.data(), message.size()) == 4);
+    REQUIRE(finished.wait_for(5s) == std::future_status::ready);
+    CHECK(finished.get());
+    std::array<char, 4> reply{};
+    REQUIRE(read(fds[1], reply.data(), reply.size()) == 4);
+    CHECK(std::string(reply.data(), reply.size()) == "PING");
+
+    constexpr size_t kLargeSize = 4U << 20U;
+    std::promise<bool> sent;
+    auto large_sent = sent.get_future();
+    looper.Post([client, &sent]() {
+      SendLarge(client, kLargeSize, sent).Detach();
+    });
+    std::array<char, 65536> chunk{};
+    size_t received = 0;
+    while (received < kLargeSize) {
+      const auto curr_read = read(fds[1], chunk.data(), chunk.size());
+      REQUIRE(curr_read > 0);
+      received += longlp::narrow_cast<size_t>(curr_read);
+    }
+    REQUIRE(large_sent.wait_for(5s) == std::future_status::ready);
+    CHECK(large_sent.get());
+    CHECK(received == kLargeSize);
+
+    looper.Exit();
+    looper.Post([]() {});
+    runner.join();
+    close(fds[1]);
+  }
+}
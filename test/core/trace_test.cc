@@ -0,0 +1,87 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "core/trace.h"
+
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+using longlp::Tracer;
+using longlp::TraceSample;
+using longlp::TraceSpan;
+
+namespace {
+auto CountSpans(std::string_view trace) -> size_t {
+  constexpr std::string_view kComplete = "\"ph\":\"X\"";
+  size_t count = 0;
+  for (auto found = trace.find(kComplete); found != std::string_view::npos;
+       found      = trace.find(kComplete, found + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+auto WriteTrace() -> std::string {
+  std::string trace;
+  Tracer::GetInstance().WriteChromeTrace(trace);
+  return trace;
+}
+}    // namespace
+
+TEST_CASE("[core/trace]") {
+  auto& tracer = Tracer::GetInstance();
+  tracer.Clear();
+
+  SECTION("nothing is recorded when sampling is off") {
+    tracer.SetSampleRate(0);
+    {
+      const TraceSample sample{};
+      const TraceSpan span{"Receive", "fd", 7};
+    }
+    CHECK(CountSpans(WriteTrace()) == 0);
+  }
+
+  SECTION("sampled spans are written as trace events") {
+    tracer.SetSampleRate(1);
+    std::thread([&tracer]() {
+      tracer.SetThreadName("reactor 3");
+      const TraceSample sample{};
+      const TraceSpan outer{"Dispatch", "fd", 7};
+      const TraceSpan inner{"Parse"};
+    }).join();
+    // outside of a sampled unit of work
+    { const TraceSpan span{"Send"}; }
+
+    const auto trace = WriteTrace();
+    CHECK(trace.starts_with("{\"traceEvents\":["));
+    CHECK(CountSpans(trace) == 2);
+    CHECK(trace.find("\"name\":\"Dispatch\"") != std::string::npos);
+    CHECK(trace.find("\"args\":{\"fd\":7}") != std::string::npos);
+    CHECK(trace.find("\"name\":\"Parse\"") != std::string::npos);
+    CHECK(trace.find("\"name\":\"reactor 3\"") != std::string::npos);
+    CHECK(trace.find("Send") == std::string::npos);
+  }
+
+  SECTION("a thread keeps its latest spans") {
+    tracer.SetSampleRate(1);
+    const TraceSample sample{};
+    for (size_t i = 0; i < Tracer::kEventsPerThread + 10; ++i) {
+      const TraceSpan span{"Poll", "i", static_cast<int64_t>(i)};
+    }
+    const auto trace = WriteTrace();
+    CHECK(CountSpans(trace) == Tracer::kEventsPerThread);
+    CHECK(trace.find("\"args\":{\"i\":9}") == std::string::npos);
+    CHECK(
+      trace.find(fmt::format(
+        "\"args\":{{\"i\":{}}}",
+        Tracer::kEventsPerThread + 9)) != std::string::npos);
+  }
+
+  tracer.SetSampleRate(0);
+  tracer.Clear();
+}
@@ -0,0 +1,107 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/cgi_cache.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/cache.h"
+#include "http/cgi_runner.h"
+
+namespace {
+using longlp::Cache;
+using longlp::DynamicByteArray;
+using longlp::http::CGICache;
+using longlp::http::CGIRunner;
+using Outcome = longlp::http::CGICache::Outcome;
+using namespace std::chrono_literals;
+
+constexpr std::string_view kReport = "/srv/cgi-bin/report";
+}    // namespace
+
+TEST_CASE("[http/cgi_cache]") {
+  constexpr auto kCapacity = 64U;
+  auto cache               = std::make_shared<Cache>(kCapacity);
+  CGICache::Options options{};
+  options.program_ttls.emplace(std::string(kReport), 1min);
+  CGICache cgi_cache{cache, options};
+
+  const CGIRunner report{kReport, {"2023", "q1"}};
+  const DynamicByteArray output = {'o', 'k'};
+  std::vector<CGICache::Output> delivered;
+  auto on_output = [&delivered](CGICache::Output delivered_output) {
+    delivered.push_back(std::move(delivered_output));
+  };
+
+  SECTION("programs without ttl are not cached") {
+    const CGIRunner other{"/srv/cgi-bin/other", {}};
+    DynamicByteArray destination;
+    auto ticket = cgi_cache.Join(other, destination, on_output);
+    CHECK(ticket.outcome == Outcome::kBypass);
+    CHECK(ticket.flight == nullptr);
+  }
+
+  SECTION("identical requests are coalesced on the running flight") {
+    DynamicByteArray destination;
+    auto leader = cgi_cache.Join(report, destination, on_output);
+    REQUIRE(leader.outcome == Outcome::kLeader);
+    REQUIRE(leader.flight != nullptr);
+    CHECK(
+      cgi_cache.Join(report, destination, on_output).outcome ==
+      Outcome::kFollower);
+    CHECK(
+      cgi_cache.Join(report, destination, on_output).outcome ==
+      Outcome::kFollower);
+    // other arguments, other flight
+    const CGIRunner other_quarter{kReport, {"2023", "q2"}};
+    CHECK(
+      cgi_cache.Join(other_quarter, destination, on_output).outcome ==
+      Outcome::kLeader);
+
+    leader.flight->Append(output.data(), output.size());
+    leader.flight->Commit();
+    REQUIRE(delivered.size() == 2);
+    for (const auto& delivered_output : delivered) {
+      REQUIRE(delivered_output != nullptr);
+      CHECK(*delivered_output == output);
+    }
+
+    // from now on it is served from the cache
+    CHECK(
+      cgi_cache.Join(report, destination, on_output).outcome ==
+      Outcome::kHit);
+    CHECK(destination == output);
+  }
+
+  SECTION("waiters are told when the flight is abandoned") {
+    DynamicByteArray destination;
+    auto leader = cgi_cache.Join(report, destination, on_output);
+    REQUIRE(leader.outcome == Outcome::kLeader);
+    CHECK(
+      cgi_cache.Join(report, destination, on_output).outcome ==
+      Outcome::kFollower);
+    leader.flight.reset();
+    REQUIRE(delivered.size() == 1);
+    CHECK(delivered.front() == nullptr);
+    // nothing cached, a new flight starts
+    CHECK(
+      cgi_cache.Join(report, destination, on_output).outcome ==
+      Outcome::kLeader);
+  }
+
+  SECTION("outputs larger than the cache are not cached") {
+    DynamicByteArray destination;
+    auto leader = cgi_cache.Join(report, destination, on_output);
+    REQUIRE(leader.outcome == Outcome::kLeader);
+    const DynamicByteArray large(kCapacity + 1, 'x');
+    leader.flight->Append(large.data(), large.size());
+    leader.flight->Commit();
+    CHECK(cache->GetOccupancy() == 0);
+  }
+}
@@ -0,0 +1,93 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/cgi_limiter.h"
+
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/metrics.h"
+
+namespace {
+using longlp::MetricsRegistry;
+using longlp::http::CGILimiter;
+using Admission = longlp::http::CGILimiter::Admission;
+
+const std::string kReport = "/cgi-bin/report";
+const std::string kHello  = "/cgi-bin/hello";
+const std::string kWorld  = "/cgi-bin/world";
+}    // namespace
+
+TEST_CASE("[http/cgi_limiter]") {
+  CGILimiter::Options options{};
+  options.max_running             = 2;
+  options.max_running_per_program = 1;
+  options.max_queued              = 2;
+  CGILimiter limiter{options};
+  std::vector<std::string> dispatched;
+  auto on_ready = [&dispatched](const std::string& name) {
+    return [&dispatched, name]() { dispatched.push_back(name); };
+  };
+
+  SECTION("requests over the limits are queued then rejected") {
+    CHECK(limiter.TryAcquire(kReport, on_ready("r1")) == Admission::kAdmitted);
+    // per program limit
+    CHECK(limiter.TryAcquire(kReport, on_ready("r2")) == Admission::kQueued);
+    // hello has room, it does not wait behind the busy report
+    CHECK(limiter.TryAcquire(kHello, on_ready("h1")) == Admission::kAdmitted);
+    CHECK(limiter.TryAcquire(kHello, on_ready("h2")) == Admission::kQueued);
+    CHECK(limiter.TryAcquire(kWorld, on_ready("w1")) == Admission::kRejected);
+
+    const auto stats = limiter.GetStats();
+    CHECK(stats.running == 2);
+    CHECK(stats.queued == 2);
+    CHECK(stats.admitted_total == 2);
+    CHECK(stats.queued_total == 2);
+    CHECK(stats.rejected_total == 1);
+    CHECK(dispatched.empty());
+  }
+
+  SECTION("released slots are handed over to the waiters in order") {
+    const auto& wait_metric = MetricsRegistry::GetInstance().GetHistogram(
+      "longlp_cgi_queue_wait_seconds",
+      "Time a queued cgi request waited for a slot");
+    const auto observed = wait_metric.GetSnapshot().count;
+    CHECK(limiter.TryAcquire(kReport, on_ready("r1")) == Admission::kAdmitted);
+    CHECK(limiter.TryAcquire(kHello, on_ready("h1")) == Admission::kAdmitted);
+    CHECK(limiter.TryAcquire(kWorld, on_ready("w1")) == Admission::kQueued);
+    CHECK(limiter.TryAcquire(kReport, on_ready("r2")) == Admission::kQueued);
+
+    limiter.Release(kHello);
+    CHECK(dispatched == std::vector<std::string>{"w1"});
+    limiter.Release(kReport);
+    CHECK(dispatched == std::vector<std::string>{"w1", "r2"});
+    auto stats = limiter.GetStats();
+    CHECK(stats.running == 2);
+    CHECK(stats.queued == 0);
+    CHECK(stats.wait_max >= std::chrono::nanoseconds::zero());
+    // both waiters, the admitted ones did not queue
+    CHECK(wait_metric.GetSnapshot().count == observed + 2);
+
+    limiter.Release(kReport);
+    limiter.Release(kWorld);
+    stats = limiter.GetStats();
+    CHECK(stats.running == 0);
+    CHECK(stats.admitted_total == 4);
+  }
+
+  SECTION("a busy program does not block the others in the queue") {
+    CHECK(limiter.TryAcquire(kReport, on_ready("r1")) == Admission::kAdmitted);
+    CHECK(limiter.TryAcquire(kHello, on_ready("h1")) == Admission::kAdmitted);
+    CHECK(limiter.TryAcquire(kReport, on_ready("r2")) == Admission::kQueued);
+    CHECK(limiter.TryAcquire(kHello, on_ready("h2")) == Admission::kQueued);
+
+    // r2 still waits for r1, h2 goes first
+    limiter.Release(kHello);
+    CHECK(dispatched == std::vector<std::string>{"h2"});
+    limiter.Release(kReport);
+    CHECK(dispatched == std::vector<std::string>{"h2", "r2"});
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/cgi_runner.h"
+
+#include <sys/wait.h>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/looper.h"
+
+namespace {
+using longlp::Byte;
+using longlp::Looper;
+using longlp::http::CGIRunner;
+using namespace std::chrono_literals;
+}    // namespace
+
+TEST_CASE("[http/cgi_runner]") {
+  Looper looper;
+  std::thread runner_thread([&looper]() { looper.StartLoop(); });
+
+  SECTION("output is captured without temporary file") {
+    CGIRunner runner{"/bin/echo", {"hello", "world"}};
+    auto output = runner.Run();
+    CHECK(std::string(output.begin(), output.end()) == "hello world\n");
+  }
+
+  SECTION("large output does not block the program") {
+    // more than a pipe buffer, the parent must drain before waiting
+    CGIRunner runner{"/usr/bin/seq", {"100000"}};
+    auto output = runner.Run();
+    CHECK(output.size() == 588895);
+  }
+
+  SECTION("output is collected from the looper until the program exits") {
+    CGIRunner runner{"/bin/echo", {"hello", "world"}};
+    std::string output;
+    std::promise<int> exit_status;
+    auto exited = exit_status.get_future();
+    REQUIRE(runner.RunAsync(
+      &looper,
+      [&output](const Byte* data, size_t size) {
+        output.append(data, data + size);
+      },
+      [&exit_status](int status) { exit_status.set_value(status); }));
+
+    REQUIRE(exited.wait_for(5s) == std::future_status::ready);
+    const auto status = exited.get();
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+    CHECK(output == "hello world\n");
+  }
+
+  SECTION("unknown program is reported synchronously") {
+    CGIRunner runner{"/nonexistent/cgi-bin/program", {}};
+    CHECK(!runner.RunAsync(&looper, [](const Byte*, size_t) {}, [](int) {}));
+  }
+
+  looper.Exit();
+  runner_thread.join();
+}
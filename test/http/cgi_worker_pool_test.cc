@@ -0,0 +1,202 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/cgi_worker_pool.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/looper.h"
+#include "http/cgi_runner.h"
+
+namespace {
+using longlp::DynamicByteArray;
+using longlp::Looper;
+using longlp::http::CGIRunner;
+using longlp::http::CGIWorkerPool;
+using namespace std::chrono_literals;
+
+// 'cat' echoes each request frame back, so it is a valid persistent worker
+// whose output is the '\0' terminated arguments
+constexpr std::string_view kEchoWorker = "/bin/cat";
+
+// a shell script at a unique temporary path, removed by the caller
+auto MakeProgram(std::string_view script) -> std::string {
+  std::string path = "/tmp/longlp_cgi_XXXXXX";
+  const int fd     = mkstemp(path.data());
+  REQUIRE(fd != -1);
+  // closed before running it, or exec fails with ETXTBSY
+  close(fd);
+  std::ofstream(path) << "#!/bin/sh\n" << script;
+  chmod(path.c_str(), S_IRWXU);
+  return path;
+}
+
+// an ordinary cgi program, its output read as a frame header announces
+// about 1.1 GB
+auto MakeNotFramingProgram() -> std::string {
+  return MakeProgram(
+    "printf 'Content-Type: text/plain\\r\\n\\r\\nhi'\n"
+    "/bin/cat > /dev/null\n");
+}
+
+// reads the requests but never answers them
+auto MakeSilentProgram() -> std::string {
+  return MakeProgram("/bin/cat > /dev/null\n");
+}
+
+// A pool whose workers are served by a looper running on its own thread, the
+// pool outlives the looper as in the server
+class PoolOnLooper {
+ public:
+  explicit PoolOnLooper(CGIWorkerPool::Options options) :
+    pool_(options),
+    looper_(),
+    thread_([this]() { looper_.StartLoop(); }) {}
+
+  ~PoolOnLooper() {
+    looper_.Exit();
+    thread_.join();
+  }
+
+  DISALLOW_COPY_AND_MOVE(PoolOnLooper);
+
+  // std::nullopt if no worker was free or the worker failed
+  auto Serve(const CGIRunner& runner) -> std::optional<DynamicByteArray> {
+    auto answered =
+      std::make_shared<std::promise<std::optional<DynamicByteArray>>>();
+    auto output = answered->get_future();
+    looper_.Post([this, &runner, answered]() {
+      const auto accepted = pool_.RunAsync(
+        runner,
+        &looper_,
+        [answered](std::optional<DynamicByteArray> result) {
+          answered->set_value(std::move(result));
+        });
+      if (!accepted) {
+        answered->set_value(std::nullopt);
+      }
+    });
+    REQUIRE(output.wait_for(5s) == std::future_status::ready);
+    return output.get();
+  }
+
+  auto GetPool() -> CGIWorkerPool& { return pool_; }
+
+  auto GetLooper() -> Looper& { return looper_; }
+
+ private:
+  CGIWorkerPool pool_;
+  Looper looper_;
+  std::thread thread_;
+};
+}    // namespace
+
+TEST_CASE("[http/cgi_worker_pool]") {
+  SECTION("requests are framed to a persistent worker") {
+    PoolOnLooper workers{CGIWorkerPool::Options{}};
+    CGIRunner runner{kEchoWorker, {"hello", "world"}};
+    for (auto i = 0; i < 3; ++i) {
+      auto output = workers.Serve(runner);
+      REQUIRE(output.has_value());
+      CHECK(
+        std::string(output->begin(), output->end()) ==
+        std::string("hello\0world\0", 12));
+    }
+    // the same worker served every request
+    CHECK(workers.GetPool().GetSpawnCount() == 1);
+  }
+
+  SECTION("workers are recycled after max requests") {
+    CGIWorkerPool::Options options{};
+    options.max_requests = 2;
+    PoolOnLooper workers{options};
+    CGIRunner runner{kEchoWorker, {"recycle"}};
+    for (auto i = 0; i < 5; ++i) {
+      CHECK(workers.Serve(runner).has_value());
+    }
+    CHECK(workers.GetPool().GetSpawnCount() == 3);
+  }
+
+  SECTION("concurrency is bounded by max workers without waiting") {
+    CGIWorkerPool::Options options{};
+    options.max_workers = 2;
+    PoolOnLooper workers{options};
+    constexpr size_t kRequestNum = 8;
+    std::vector<CGIRunner> runners;
+    for (size_t i = 0; i < kRequestNum; ++i) {
+      runners.emplace_back(kEchoWorker, std::vector{std::to_string(i)});
+    }
+    std::promise<size_t> accepted;
+    auto accepted_num = accepted.get_future();
+    std::vector<std::promise<std::string>> answered(kRequestNum);
+    // every request is sent from the looper before any answer is read
+    workers.GetLooper().Post([&]() {
+      size_t num = 0;
+      for (size_t i = 0; i < kRequestNum; ++i) {
+        const auto started = workers.GetPool().RunAsync(
+          runners[i],
+          &workers.GetLooper(),
+          [&answered, i](std::optional<DynamicByteArray> output) {
+            answered[i].set_value(
+              output.has_value() ? std::string(output->begin(), output->end())
+                                 : std::string{});
+          });
+        if (started) {
+          ++num;
+        }
+      }
+      accepted.set_value(num);
+    });
+    REQUIRE(accepted_num.wait_for(5s) == std::future_status::ready);
+    CHECK(accepted_num.get() == 2);
+    for (size_t i = 0; i < 2; ++i) {
+      auto output = answered[i].get_future();
+      REQUIRE(output.wait_for(5s) == std::future_status::ready);
+      CHECK(output.get() == std::to_string(i) + '\0');
+    }
+    CHECK(workers.GetPool().GetSpawnCount() == 2);
+  }
+
+  SECTION("workers answering oversized frames are recycled") {
+    const auto program = MakeNotFramingProgram();
+    PoolOnLooper workers{CGIWorkerPool::Options{}};
+    CGIRunner runner{program, {}};
+    CHECK(!workers.Serve(runner).has_value());
+    CHECK(!workers.Serve(runner).has_value());
+    CHECK(workers.GetPool().GetSpawnCount() == 2);
+    std::remove(program.c_str());
+  }
+
+  SECTION("workers not answering in time are recycled") {
+    CGIWorkerPool::Options options{};
+    options.timeout = 100ms;
+    const auto program = MakeSilentProgram();
+    PoolOnLooper workers{options};
+    CGIRunner runner{program, {}};
+    const auto started = std::chrono::steady_clock::now();
+    CHECK(!workers.Serve(runner).has_value());
+    CHECK(std::chrono::steady_clock::now() - started >= 100ms);
+    CHECK(workers.GetPool().GetSpawnCount() == 1);
+    std::remove(program.c_str());
+  }
+
+  SECTION("unknown program cannot be served") {
+    PoolOnLooper workers{CGIWorkerPool::Options{}};
+    CGIRunner runner{"/nonexistent/cgi-bin/program", {}};
+    CHECK(!workers.Serve(runner).has_value());
+    CHECK(workers.GetPool().GetSpawnCount() == 0);
+  }
+}
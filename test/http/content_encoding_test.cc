@@ -0,0 +1,153 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/content_encoding.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "core/cache.h"
+#include "core/thread_pool.h"
+#include "http/http_utils.h"
+
+namespace {
+using longlp::Cache;
+using longlp::DynamicByteArray;
+using longlp::ThreadPool;
+using longlp::http::Compress;
+using longlp::http::ContentEncoding;
+using longlp::http::DeleteFile;
+using longlp::http::HasEncodedVariants;
+using longlp::http::LoadCachedVariant;
+using longlp::http::LoadContent;
+using longlp::http::LoadEncodedVariant;
+using longlp::http::MakeVariantETag;
+using longlp::http::NegotiateContentEncoding;
+}    // namespace
+
+TEST_CASE("[http/content_encoding]") {
+  const std::string html_file  = "content_encoding_test.html";
+  const std::string image_file = "content_encoding_test.png";
+  {
+    std::ofstream html(html_file);
+    for (auto i = 0; i < 100; ++i) {
+      html << "<p>compress me, compress me, compress me</p>\n";
+    }
+    std::ofstream image(image_file);
+    image << "not really a png";
+  }
+
+  SECTION("negotiation honours q-values and available variants") {
+    CHECK(
+      NegotiateContentEncoding("", html_file) == ContentEncoding::kIdentity);
+    CHECK(
+      NegotiateContentEncoding("gzip, deflate", html_file) ==
+      ContentEncoding::kGzip);
+    CHECK(
+      NegotiateContentEncoding("gzip;q=0.5, deflate", html_file) ==
+      ContentEncoding::kDeflate);
+    CHECK(
+      NegotiateContentEncoding("gzip;q=0, identity", html_file) ==
+      ContentEncoding::kIdentity);
+    CHECK(NegotiateContentEncoding("*", html_file) == ContentEncoding::kGzip);
+    // no '.br' sidecar, brotli is not produced on the fly
+    CHECK(
+      NegotiateContentEncoding("br", html_file) == ContentEncoding::kIdentity);
+    // images are not compressible
+    CHECK(
+      NegotiateContentEncoding("gzip", image_file) ==
+      ContentEncoding::kIdentity);
+    CHECK(HasEncodedVariants(html_file));
+    CHECK(!HasEncodedVariants(image_file));
+  }
+
+  SECTION("precompressed sidecar is preferred") {
+    const auto sidecar = html_file + ".br";
+    {
+      std::ofstream brotli(sidecar);
+      brotli << "brotli bytes";
+    }
+    CHECK(
+      NegotiateContentEncoding("gzip, br", html_file) ==
+      ContentEncoding::kBrotli);
+
+    Cache cache(Cache::kDefaultCapacity);
+    DynamicByteArray content;
+    CHECK(
+      LoadEncodedVariant(html_file, ContentEncoding::kBrotli, cache, content));
+    CHECK(std::string(content.begin(), content.end()) == "brotli bytes");
+    CHECK(DeleteFile(sidecar));
+  }
+
+  SECTION("compressed variant is cached alongside the identity") {
+    Cache cache(Cache::kDefaultCapacity);
+    DynamicByteArray content;
+    CHECK(
+      LoadEncodedVariant(html_file, ContentEncoding::kGzip, cache, content));
+    // gzip magic number
+    REQUIRE(content.size() > 2);
+    CHECK(content[0] == 0x1f);
+    CHECK(content[1] == 0x8b);
+
+    DynamicByteArray cached;
+    CHECK(cache.TryLoad(html_file, cached));
+    CHECK(content.size() < cached.size());
+    cached.clear();
+    CHECK(cache.TryLoad(html_file + ".gz", cached));
+    CHECK(cached == content);
+  }
+
+  SECTION("variant produced off the reactor is then found in the cache") {
+    Cache cache(Cache::kDefaultCapacity);
+    const std::string etag = "\"abc-1\"";
+    DynamicByteArray cached;
+    // what a reactor checks before sending the work to the file pool
+    CHECK(!LoadCachedVariant(html_file, ContentEncoding::kGzip, cache, cached));
+    CHECK(cached.empty());
+
+    ThreadPool file_pool(1);
+    auto produced = file_pool.SubmitTask([&html_file, &cache, &etag]() {
+      DynamicByteArray content;
+      const auto encoding =
+        LoadContent(html_file, ContentEncoding::kGzip, cache, content, etag);
+      return std::make_pair(std::move(content), encoding);
+    });
+    const auto [content, encoding] = produced.get();
+    CHECK(encoding == ContentEncoding::kGzip);
+    CHECK(LoadCachedVariant(html_file, encoding, cache, cached, etag));
+    CHECK(cached == content);
+    // the file changed since
+    cached.clear();
+    CHECK(!LoadCachedVariant(html_file, encoding, cache, cached, "\"abc-2\""));
+
+    // no '.br' sidecar, the identity content is sent instead
+    DynamicByteArray identity;
+    CHECK(
+      LoadContent(html_file, ContentEncoding::kBrotli, cache, identity) ==
+      ContentEncoding::kIdentity);
+    CHECK(identity.size() == std::filesystem::file_size(html_file));
+  }
+
+  SECTION("compress and variant tag") {
+    DynamicByteArray source(1024, 'a');
+    DynamicByteArray deflated;
+    CHECK(Compress(source, ContentEncoding::kDeflate, deflated));
+    CHECK(!deflated.empty());
+    CHECK(deflated.size() < source.size());
+    CHECK(!Compress(source, ContentEncoding::kBrotli, deflated));
+
+    CHECK(
+      MakeVariantETag("\"abc-1\"", ContentEncoding::kGzip) ==
+      "\"abc-1-gzip\"");
+    CHECK(
+      MakeVariantETag("\"abc-1\"", ContentEncoding::kIdentity) == "\"abc-1\"");
+  }
+
+  CHECK(DeleteFile(html_file));
+  CHECK(DeleteFile(image_file));
+}
@@ -0,0 +1,99 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/plugin_registry.h"
+
+#include <filesystem>
+#include <string>
+#include <utility>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "http/header.h"
+#include "http/request.h"
+
+namespace {
+using longlp::DynamicByteArray;
+using longlp::http::PluginRegistry;
+using longlp::http::Request;
+
+// built by the echo_plugin target
+constexpr std::string_view kEchoPluginPath = LONGLP_TEST_ECHO_PLUGIN;
+
+// the serialized response and whether the connection should be closed
+auto Serve(const PluginRegistry& registry, const std::string& request_str)
+  -> std::pair<std::string, bool> {
+  Request request{request_str};
+  const auto url   = request.GetResourceUrl();
+  const auto route = PluginRegistry::ParseRoute(url);
+  REQUIRE(route.has_value());
+  const auto* plugin = registry.Find(route->first);
+  REQUIRE(plugin != nullptr);
+  DynamicByteArray response_buf;
+  const auto should_close =
+    PluginRegistry::Serve(*plugin, request, response_buf);
+  return {std::string(response_buf.begin(), response_buf.end()), should_close};
+}
+}    // namespace
+
+TEST_CASE("[http/plugin_registry]") {
+  SECTION("plugin routes are split into name and path") {
+    auto route = PluginRegistry::ParseRoute("/plugin/echo/a/b");
+    REQUIRE(route.has_value());
+    CHECK(route->first == "echo");
+    CHECK(route->second == "/a/b");
+
+    route = PluginRegistry::ParseRoute("/plugin/echo");
+    REQUIRE(route.has_value());
+    CHECK(route->first == "echo");
+    CHECK(route->second.empty());
+
+    CHECK(!PluginRegistry::ParseRoute("/plugin//a").has_value());
+    CHECK(!PluginRegistry::ParseRoute("/cgi-bin/echo").has_value());
+  }
+
+  SECTION("plugin is loaded once and serves requests in process") {
+    PluginRegistry registry;
+    REQUIRE(registry.Load(std::string(kEchoPluginPath)));
+    CHECK(registry.GetSize() == 1);
+    // name already taken
+    CHECK(!registry.Load(std::string(kEchoPluginPath)));
+    CHECK(registry.Find("unknown") == nullptr);
+
+    const auto [response, should_close] = Serve(
+      registry,
+      "GET /plugin/echo/hello HTTP/1.1\r\nConnection: Keep-Alive\r\n\r\n");
+    CHECK(!should_close);
+    CHECK(response.starts_with("HTTP/1.1 200 OK\r\n"));
+    CHECK(response.find("Content-Length:10\r\n") != std::string::npos);
+    CHECK(response.find("X-Plugin:echo\r\n") != std::string::npos);
+    CHECK(response.ends_with("\r\n\r\nGET /hello"));
+
+    // no content for HEAD, the length is kept
+    const auto head_response =
+      Serve(registry, "HEAD /plugin/echo/hello HTTP/1.1\r\n\r\n").first;
+    CHECK(head_response.find("Content-Length:11\r\n") != std::string::npos);
+    CHECK(head_response.ends_with("\r\n\r\n"));
+
+    // a failed plugin closes the connection, even a keep-alive one
+    for (const auto* path : {"/fail", "/framing", "/split"}) {
+      const auto [failed_response, failed_should_close] = Serve(
+        registry,
+        std::string("GET /plugin/echo") + path +
+          " HTTP/1.1\r\nConnection: Keep-Alive\r\n\r\n");
+      CHECK(failed_response.starts_with("HTTP/1.1 500 Internal Server Error"));
+      CHECK(failed_response.find("X-Injected") == std::string::npos);
+      CHECK(failed_should_close);
+    }
+  }
+
+  SECTION("directory loading only picks shared objects") {
+    PluginRegistry registry;
+    const auto directory =
+      std::filesystem::path(kEchoPluginPath).parent_path().string();
+    CHECK(registry.LoadDirectory(directory) == 1);
+    CHECK(registry.Find("echo") != nullptr);
+    CHECK(!registry.Load("/nonexistent/plugin.so"));
+  }
+}
@@ -0,0 +1,58 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+// A minimal handler plugin for the tests: echoes the method and the path
+// after the plugin name, '/fail' returns an invalid status, '/framing' and
+// '/split' headers the server must not send
+
+#include <string_view>
+
+#include "http/plugin_abi.h"
+
+namespace {
+auto Handle(
+  const longlp_plugin_request* request,
+  const longlp_plugin_response* response) -> int {
+  const std::string_view path{request->path.data, request->path.size};
+  if (path == "/fail") {
+    return 0;
+  }
+  if (path == "/framing" || path == "/split") {
+    constexpr std::string_view kFramingKey   = "content-length";
+    constexpr std::string_view kFramingValue = "0";
+    constexpr std::string_view kSplitKey     = "X-Plugin";
+    constexpr std::string_view kSplitValue   = "echo\r\nX-Injected: 1";
+    const auto key   = path == "/framing" ? kFramingKey : kSplitKey;
+    const auto value = path == "/framing" ? kFramingValue : kSplitValue;
+    response->add_header(
+      response->context,
+      {key.data(), key.size()},
+      {value.data(), value.size()});
+    return 200;
+  }
+  constexpr std::string_view kKey   = "X-Plugin";
+  constexpr std::string_view kValue = "echo";
+  response->add_header(
+    response->context,
+    {kKey.data(), kKey.size()},
+    {kValue.data(), kValue.size()});
+  response->write(
+    response->context,
+    request->method.data,
+    request->method.size);
+  response->write(response->context, " ", 1);
+  response->write(response->context, path.data(), path.size());
+  return 200;
+}
+
+constexpr longlp_plugin kEchoPlugin{
+  LONGLP_PLUGIN_ABI_VERSION,
+  "echo",
+  0U,
+  Handle};
+}    // namespace
+
+extern "C" auto longlp_plugin_entry() -> const longlp_plugin* {
+  return &kEchoPlugin;
+}
@@ -0,0 +1,64 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "http/request_arena.h"
+
+#include <memory_resource>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "http/request.h"
+
+namespace {
+using longlp::http::Request;
+using longlp::http::RequestArena;
+
+constexpr auto kRequest =
+  "GET /hello.html HTTP/1.1\r\n"
+  "Host: www.tutorialspoint.com\r\n"
+  "\r\n";
+
+auto Allocate(std::pmr::memory_resource* resource) -> void* {
+  return resource->allocate(sizeof(std::string), alignof(std::string));
+}
+}    // namespace
+
+TEST_CASE("[http/request_arena]") {
+  RequestArena arena{};
+
+  SECTION("the memory is reused once the scope ends") {
+    void* first = nullptr;
+    {
+      const RequestArena::Scope scope{arena};
+      first = Allocate(scope.GetResource());
+      const Request request{kRequest, scope.GetResource()};
+      CHECK(request.IsValid());
+    }
+    const RequestArena::Scope scope{arena};
+    CHECK(Allocate(scope.GetResource()) == first);
+  }
+
+  SECTION("a nested scope does not release the outer request") {
+    const RequestArena::Scope outer{arena};
+    const Request request{kRequest, outer.GetResource()};
+    void* inner_allocation = nullptr;
+    {
+      const RequestArena::Scope inner{arena};
+      inner_allocation = Allocate(inner.GetResource());
+    }
+    CHECK(Allocate(outer.GetResource()) != inner_allocation);
+    CHECK(request.GetResourceUrl() == "/hello.html");
+  }
+
+  SECTION("each thread has its own arena") {
+    auto* main_arena          = &RequestArena::ForThisThread();
+    RequestArena* other_arena = nullptr;
+    std::thread([&other_arena]() {
+      other_arena = &RequestArena::ForThisThread();
+    }).join();
+    CHECK(main_arena != other_arena);
+  }
+}
@@ -4,6 +4,9 @@
 
 #include "http/request.h"
 
+#include <memory_resource>
+#include <string>
+
 #include <catch2/catch_test_macros.hpp>
 
 #include "http/constants.h"
@@ -87,4 +90,66 @@ TEST_CASE("[http/request]") {
     Request request_6{request_6_str};
     CHECK(!request_6.ShouldClose());
   }
+
+  SECTION("conditional request validators") {
+    const std::string etag = "\"5f5e100-400\"";
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    const std::time_t last_modified = 784111777;
+
+    // no validators means always modified
+    Request plain_request{
+      "GET /hello.html HTTP/1.1\r\n"
+      "\r\n"};
+    CHECK(!plain_request.IsNotModified(etag, last_modified));
+
+    // matching entity tag, weak comparison and list form
+    Request etag_request{
+      "GET /hello.html HTTP/1.1\r\n"
+      "If-None-Match: \"xyz\", W/\"5f5e100-400\"\r\n"
+      "\r\n"};
+    CHECK(etag_request.IsNotModified(etag, last_modified));
+    CHECK(!etag_request.IsNotModified("\"abc\"", last_modified));
+
+    // If-None-Match takes precedence over If-Modified-Since
+    Request both_request{
+      "GET /hello.html HTTP/1.1\r\n"
+      "If-None-Match: \"xyz\"\r\n"
+      "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+      "\r\n"};
+    CHECK(!both_request.IsNotModified(etag, last_modified));
+
+    Request date_request{
+      "GET /hello.html HTTP/1.1\r\n"
+      "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+      "\r\n"};
+    CHECK(date_request.IsNotModified(etag, last_modified));
+    CHECK(!date_request.IsNotModified(etag, last_modified + 1));
+
+    // malformed date is ignored
+    Request bad_date_request{
+      "GET /hello.html HTTP/1.1\r\n"
+      "If-Modified-Since: yesterday\r\n"
+      "\r\n"};
+    CHECK(!bad_date_request.IsNotModified(etag, last_modified));
+  }
+
+  SECTION("a request allocates from its allocator and can be copied out") {
+    std::pmr::monotonic_buffer_resource arena{};
+    const std::string request_str =
+      "GET /hello.html HTTP/1.1\r\n"
+      "Host: www.tutorialspoint.com\r\n"
+      "Accept-Encoding: gzip\r\n"
+      "\r\n";
+    const Request request{request_str, &arena};
+    REQUIRE(request.IsValid());
+    CHECK(request.get_allocator().resource() == &arena);
+    CHECK(request.GetHeaders().get_allocator().resource() == &arena);
+
+    const Request copy{request, Request::allocator_type{}};
+    CHECK(copy.get_allocator().resource() == std::pmr::get_default_resource());
+    CHECK(copy.IsValid());
+    CHECK(copy.GetResourceUrl() == "/hello.html");
+    CHECK(copy.GetAcceptEncoding() == "gzip");
+    CHECK(copy.GetHeaders().size() == 2);
+  }
 }
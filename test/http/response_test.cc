@@ -4,14 +4,29 @@
 
 #include "http/response.h"
 
+#include <fstream>
+
 #include <catch2/catch_test_macros.hpp>
 #include "http/constants.h"
 #include "http/header.h"
+#include "http/http_utils.h"
 
 namespace {
+using longlp::DynamicByteArray;
+using longlp::http::DeleteFile;
+using longlp::http::FileInfo;
+using longlp::http::GetLastModifiedTime;
 using longlp::http::kHeaderContentLength;
+using longlp::http::kHeaderETag;
+using longlp::http::kHeaderLastModified;
+using longlp::http::kHeaderTransferEncoding;
 using longlp::http::kResponseStatusOK;
+using longlp::http::kTransferEncodingChunked;
+using longlp::http::MakeETag;
+using longlp::http::ParseHttpDate;
 using longlp::http::Response;
+using longlp::http::StatFile;
+using longlp::http::ToHttpDate;
 }    // namespace
 
 TEST_CASE("[http/response]") {
@@ -41,4 +56,94 @@ TEST_CASE("[http/response]") {
     CHECK(find);
     CHECK(value == new_val);
   }
+
+  SECTION("response carries validators for an existing resource") {
+    const std::string file_name = "response_test_validators.txt";
+    {
+      std::ofstream file(file_name);
+      file << "hello validators";
+    }
+
+    auto response = Response::Make200Response(true, file_name);
+    std::string etag;
+    std::string last_modified;
+    for (auto& h : response.GetHeaders()) {
+      if (h.GetKey() == kHeaderETag) {
+        etag = h.GetValue();
+      }
+      if (h.GetKey() == kHeaderLastModified) {
+        last_modified = h.GetValue();
+      }
+    }
+    CHECK(!etag.empty());
+    CHECK(etag == MakeETag(file_name));
+    CHECK(ParseHttpDate(last_modified) == GetLastModifiedTime(file_name));
+
+    // 304 keeps the validators but ends right after the header section
+    DynamicByteArray buffer;
+    Response::Make304Response(true, file_name).Serialize(buffer);
+    const std::string serialized{buffer.begin(), buffer.end()};
+    CHECK(serialized.starts_with("HTTP/1.1 304 Not Modified\r\n"));
+    CHECK(serialized.find(etag) != std::string::npos);
+    CHECK(serialized.ends_with("\r\n\r\n"));
+
+    CHECK(DeleteFile(file_name));
+  }
+
+  SECTION("response of a file already looked up does not look it up again") {
+    // no such file, the headers come from the given information only
+    const FileInfo file_info{1024, 784111777};
+    auto response =
+      Response::Make200Response(false, "not-stat-again.html", file_info);
+    std::string content_length;
+    std::string etag;
+    std::string last_modified;
+    for (auto& h : response.GetHeaders()) {
+      if (h.GetKey() == kHeaderContentLength) {
+        content_length = h.GetValue();
+      }
+      if (h.GetKey() == kHeaderETag) {
+        etag = h.GetValue();
+      }
+      if (h.GetKey() == kHeaderLastModified) {
+        last_modified = h.GetValue();
+      }
+    }
+    CHECK(content_length == "1024");
+    CHECK(etag == MakeETag(file_info));
+    CHECK(last_modified == ToHttpDate(file_info.last_modified));
+    CHECK(StatFile("not-stat-again.html") == std::nullopt);
+  }
+
+  SECTION("chunked response frames its content") {
+    auto response = Response::MakeChunkedResponse(false);
+    bool has_length = false;
+    bool chunked    = false;
+    for (auto& h : response.GetHeaders()) {
+      has_length = has_length || h.GetKey() == kHeaderContentLength;
+      chunked    = chunked || (h.GetKey() == kHeaderTransferEncoding &&
+                            h.GetValue() == kTransferEncodingChunked);
+    }
+    CHECK(!has_length);
+    CHECK(chunked);
+
+    DynamicByteArray buffer;
+    const std::string_view content = "hello chunked world";
+    const DynamicByteArray bytes{content.begin(), content.end()};
+    Response::AppendChunk(bytes.data(), bytes.size(), buffer);
+    // empty chunk is not emitted, it would end the content early
+    Response::AppendChunk(nullptr, 0, buffer);
+    Response::AppendLastChunk(buffer);
+    CHECK(
+      std::string(buffer.begin(), buffer.end()) ==
+      "13\r\nhello chunked world\r\n0\r\n\r\n");
+  }
+
+  SECTION("http-date round trip") {
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    const std::time_t time = 784111777;
+    CHECK(ToHttpDate(time) == "Sun, 06 Nov 1994 08:49:37 GMT");
+    CHECK(ParseHttpDate(ToHttpDate(time)) == time);
+    CHECK(!ParseHttpDate("Sunday, 06-Nov-94").has_value());
+  }
 }
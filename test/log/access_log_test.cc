@@ -0,0 +1,50 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/access_log.h"
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+using longlp::AccessLogEntry;
+using longlp::BoundedString;
+}    // namespace
+
+TEST_CASE("[log/access_log]") {
+  SECTION("bounded strings are truncated") {
+    BoundedString<4> str;
+    CHECK(str.View().empty());
+    str.Assign("GET");
+    CHECK(str.View() == "GET");
+    str.Assign("OPTIONS");
+    CHECK(str.View() == "OPTI");
+    str.Format("{}:{}", "10.0.0.1", 80);
+    CHECK(str.View() == "10.0");
+    str.Format("{}", 42);
+    CHECK(str.View() == "42");
+  }
+
+  SECTION("an entry is formatted as a single line") {
+    AccessLogEntry entry;
+    entry.client.Assign("127.0.0.1:51234");
+    entry.method.Assign("GET");
+    entry.url.Assign("/index.html");
+    entry.status     = 200;
+    entry.bytes_sent = 1024;
+    entry.parse      = longlp::microseconds{3};
+    entry.handle     = longlp::microseconds{40};
+    entry.send       = longlp::microseconds{12};
+    entry.reactor_id = 1;
+
+    std::string line = "previous\n";
+    longlp::AppendAccessLogLine(entry, "18-10-2023 10:00:00", line);
+    CHECK(
+      line ==
+      "previous\n"
+      "18-10-2023 10:00:00 127.0.0.1:51234 reactor=1 \"GET /index.html\" 200 "
+      "1024 parse=3us handle=40us send=12us\n");
+  }
+}
@@ -0,0 +1,96 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/binary_log.h"
+
+#include <sstream>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "log/logger.h"
+
+namespace {
+using longlp::LogLevel;
+using longlp::binary_log::Decoder;
+using longlp::binary_log::Encoder;
+using longlp::log_internal::CapturedMessage;
+
+constexpr int64_t kTimeNs = 1'700'000'000'123'456'789;
+
+void AppendLog(
+  Encoder& encoder,
+  std::string& out,
+  const longlp::log_internal::DeferredMessage& msg) {
+  encoder.AppendLogHead(
+    out,
+    kTimeNs,
+    LogLevel::kWarning,
+    msg.GetFormat(),
+    msg.GetArgCount());
+  msg.PackArgsTo(out);
+}
+}    // namespace
+
+TEST_CASE("[log/binary_log]") {
+  Encoder encoder;
+  std::string out;
+  Encoder::AppendMagic(out);
+
+  SECTION("records are decoded back into their messages") {
+    const CapturedMessage<std::string, int, double, bool, char> message{
+      "{} fd={} load={} ok={} {}",
+      "client",
+      -7,
+      0.5,
+      true,
+      'x'};
+    AppendLog(encoder, out, message);
+    // the format string is only defined once
+    const auto size_with_format = out.size();
+    AppendLog(encoder, out, message);
+    CHECK(out.size() - size_with_format < size_with_format);
+    Encoder::AppendPlainLog(out, kTimeNs, LogLevel::kInfo, R"(say "hi")");
+
+    std::istringstream in(out);
+    Decoder decoder{in};
+    REQUIRE(decoder.IsValid());
+    for (auto i = 0; i < 2; ++i) {
+      const auto record = decoder.Next();
+      REQUIRE(record.has_value());
+      CHECK(record->time_ns == kTimeNs);
+      CHECK(record->level == LogLevel::kWarning);
+      CHECK(record->format == "{} fd={} load={} ok={} {}");
+      CHECK(record->args.size() == 5);
+      CHECK(
+        longlp::binary_log::FormatMessage(*record) ==
+        "client fd=-7 load=0.5 ok=true x");
+      CHECK(longlp::binary_log::ToText(*record).ends_with(
+        "Warning:client fd=-7 load=0.5 ok=true x"));
+    }
+
+    const auto plain = decoder.Next();
+    REQUIRE(plain.has_value());
+    CHECK(plain->level == LogLevel::kInfo);
+    const auto json = longlp::binary_log::ToJson(*plain);
+    CHECK(json.starts_with(R"({"time_ns":1700000000123456789,)"));
+    CHECK(json.find(R"("level":"Info")") != std::string::npos);
+    CHECK(json.find(R"("args":["say \"hi\""])") != std::string::npos);
+    CHECK(json.ends_with(R"("message":"say \"hi\""})"));
+
+    CHECK(!decoder.Next().has_value());
+  }
+
+  SECTION("truncated records and foreign files are rejected") {
+    Encoder::AppendPlainLog(out, kTimeNs, LogLevel::kInfo, "cut");
+    out.pop_back();
+    std::istringstream truncated(out);
+    Decoder decoder{truncated};
+    REQUIRE(decoder.IsValid());
+    CHECK(!decoder.Next().has_value());
+
+    std::istringstream text("18-10-2023 10:00:00Info:detect request\n");
+    CHECK(!Decoder{text}.IsValid());
+  }
+}
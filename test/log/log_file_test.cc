@@ -0,0 +1,90 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/log_file.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+using longlp::LogFile;
+namespace fs = std::filesystem;
+
+auto ReadFile(const std::string& path) -> std::string {
+  std::ifstream file(path);
+  return {std::istreambuf_iterator<char>(file), {}};
+}
+
+auto CountFiles(const fs::path& directory) -> size_t {
+  return static_cast<size_t>(std::distance(
+    fs::directory_iterator(directory),
+    fs::directory_iterator{}));
+}
+}    // namespace
+
+TEST_CASE("[log/log_file]") {
+  const auto directory = fs::temp_directory_path() / "longlp_log_file_test";
+  fs::remove_all(directory);
+
+  LogFile::Options options{};
+  options.directory        = directory.string();
+  options.write_batch_size = 8;
+  options.flush_interval   = std::chrono::milliseconds(0);
+
+  SECTION("chunks are queued until the batch size") {
+    LogFile file{options, "test_log", ".log"};
+    REQUIRE(file.IsOpen());
+    CHECK(file.GetPath().ends_with(".0.log"));
+    file.Append("abc");
+    CHECK(file.GetSize() == 3);
+    CHECK(ReadFile(file.GetPath()).empty());
+    file.Append("defgh");
+    CHECK(ReadFile(file.GetPath()) == "abcdefgh");
+    file.Append("i");
+    file.FlushIfDue();
+    CHECK(ReadFile(file.GetPath()) == "abcdefghi");
+  }
+
+  SECTION("files are never reused") {
+    std::string first_path;
+    {
+      LogFile file{options, "test_log", ".log"};
+      first_path = file.GetPath();
+      file.Append("first");
+    }
+    // flushed on close
+    CHECK(ReadFile(first_path) == "first");
+
+    LogFile file{options, "test_log", ".log"};
+    CHECK(file.GetPath() != first_path);
+    CHECK(file.GetPath().ends_with(".1.log"));
+    CHECK(ReadFile(first_path) == "first");
+  }
+
+  SECTION("files are rotated by size and the oldest are removed") {
+    options.max_file_size = 16;
+    options.max_files     = 2;
+    LogFile file{options, "test_log", ".log"};
+    file.Append("0123456789");
+    CHECK(!file.ShouldRotate());
+    file.Append("0123456789");
+    REQUIRE(file.ShouldRotate());
+
+    const auto first_path = file.GetPath();
+    file.Rotate();
+    CHECK(file.GetSize() == 0);
+    CHECK(ReadFile(first_path).size() == 20);
+    CHECK(CountFiles(directory) == 2);
+
+    file.Rotate();
+    CHECK(CountFiles(directory) == 2);
+    CHECK(!fs::exists(first_path));
+  }
+
+  fs::remove_all(directory);
+}
@@ -0,0 +1,77 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/logger.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+using longlp::Logger;
+using longlp::LogLevel;
+using longlp::log_internal::ArgsCodec;
+using longlp::log_internal::CapturedArg;
+using longlp::log_internal::CapturedMessage;
+using longlp::log_internal::PackedArgs;
+}    // namespace
+
+TEST_CASE("[log/logger]") {
+  SECTION("views are captured by value") {
+    static_assert(std::is_same_v<CapturedArg<std::string_view>, std::string>);
+    static_assert(std::is_same_v<CapturedArg<const char (&)[4]>, std::string>);
+    static_assert(std::is_same_v<CapturedArg<const int&>, int>);
+
+    std::string path = "/index.html";
+    const CapturedMessage<std::string, int> message{
+      "{} not exist, fd={}",
+      std::string_view(path),
+      7};
+    // the message outlives the arguments
+    path.assign("/changed");
+    std::string out = "Info:";
+    message.FormatTo(out);
+    CHECK(out == "Info:/index.html not exist, fd=7");
+  }
+
+  SECTION("arguments are packed inline unless oversized") {
+    using Codec = ArgsCodec<const char*, int, std::string, double>;
+    std::string path = "/index.html";
+    PackedArgs packed;
+    Codec::Pack(packed, "GET", 7, path, 0.5);
+    const auto* inline_data = packed.GetData();
+    // moved into the ring buffer slot, the bytes follow
+    PackedArgs slot;
+    slot = std::move(packed);
+    CHECK(slot.GetData() != inline_data);
+    path.assign("/changed");
+    std::string out = "Info:";
+    Codec::kDecoder.format_to("{} fd={} {} {}", slot.GetData(), out);
+    CHECK(out == "Info:GET fd=7 /index.html 0.5");
+
+    // a string over the inline capacity is kept on the heap
+    const std::string long_path(PackedArgs::kInlineCapacity, 'a');
+    PackedArgs oversized;
+    Codec::Pack(oversized, "GET", 7, long_path, 0.5);
+    const auto* heap_data = oversized.GetData();
+    slot                  = std::move(oversized);
+    CHECK(slot.GetData() == heap_data);
+    out.clear();
+    Codec::kDecoder.format_to("{2}", slot.GetData(), out);
+    CHECK(out == long_path);
+    CHECK(Codec::kDecoder.arg_count == 4);
+  }
+
+  SECTION("runtime level is checked before formatting") {
+    Logger::SetMinLevel(LogLevel::kError);
+    CHECK(!Logger::IsEnabled(LogLevel::kInfo));
+    CHECK(!Logger::IsEnabled(LogLevel::kWarning));
+    CHECK(Logger::IsEnabled(LogLevel::kError));
+    CHECK(Logger::IsEnabled(LogLevel::kFatal));
+    Logger::SetMinLevel(LogLevel::kInfo);
+    CHECK(Logger::IsEnabled(LogLevel::kInfo));
+  }
+}
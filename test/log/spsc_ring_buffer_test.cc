@@ -0,0 +1,78 @@
+// Copyright 2023 Phi-Long Le. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "log/spsc_ring_buffer.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+using longlp::SPSCRingBuffer;
+}    // namespace
+
+TEST_CASE("[log/spsc_ring_buffer]") {
+  constexpr auto kCapacity = 4U;
+
+  SECTION("items come out in order until the buffer is empty") {
+    SPSCRingBuffer<std::string, kCapacity> ring;
+    CHECK(ring.GetCapacity() == kCapacity);
+    std::string item = "first";
+    REQUIRE(ring.TryPush(std::move(item)));
+    item = "second";
+    REQUIRE(ring.TryPush(std::move(item)));
+    CHECK(ring.GetSize() == 2);
+
+    std::string popped;
+    REQUIRE(ring.TryPop(popped));
+    CHECK(popped == "first");
+    REQUIRE(ring.TryPop(popped));
+    CHECK(popped == "second");
+    CHECK(!ring.TryPop(popped));
+    CHECK(ring.GetSize() == 0);
+  }
+
+  SECTION("a full buffer rejects the item and leaves it untouched") {
+    SPSCRingBuffer<std::string, kCapacity> ring;
+    for (auto i = 0U; i < kCapacity; ++i) {
+      REQUIRE(ring.TryPush(std::to_string(i)));
+    }
+    std::string item = "rejected";
+    CHECK(!ring.TryPush(std::move(item)));
+    CHECK(item == "rejected");
+
+    // room again once the consumer catches up, across the wrap around
+    std::string popped;
+    REQUIRE(ring.TryPop(popped));
+    CHECK(popped == "0");
+    CHECK(ring.TryPush(std::move(item)));
+    CHECK(ring.GetSize() == kCapacity);
+  }
+
+  SECTION("one producer and one consumer thread") {
+    constexpr auto kItems = 100000U;
+    auto ring             = std::make_unique<SPSCRingBuffer<size_t, 64>>();
+    std::thread producer([&ring] {
+      for (size_t i = 0; i < kItems; ++i) {
+        auto item = i;
+        while (!ring->TryPush(std::move(item))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+    size_t expected = 0;
+    size_t popped   = 0;
+    while (expected < kItems) {
+      if (ring->TryPop(popped)) {
+        REQUIRE(popped == expected);
+        ++expected;
+      }
+    }
+    producer.join();
+    CHECK(ring->GetSize() == 0);
+  }
+}